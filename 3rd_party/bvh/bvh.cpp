@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <iostream>
+#include <sstream>
 
 #include "bvh.hpp"
 #include "ray_intersection.hpp"
@@ -8,7 +10,84 @@
 namespace BVH
 {
 
-    AABBTree::AABBTree(std::vector<Triangle>& tri, float aabb_expansion) : tris(tri)
+    namespace
+    {
+        double surface_area(const AABB &box)
+        {
+            const Vector4 d = box.upper - box.lower;
+            return 2.0 * (double(d.x) * d.y + double(d.y) * d.z + double(d.z) * d.x);
+        }
+
+        // Zero for boxes that do not overlap
+        double volume(Vector4 lower, Vector4 upper)
+        {
+            const Vector4 d = upper - lower;
+            return std::max(double(d.x), 0.0) * std::max(double(d.y), 0.0) * std::max(double(d.z), 0.0);
+        }
+
+        void json_array(std::ostream &out, const std::vector<std::size_t> &values)
+        {
+            out << "[";
+            for (std::size_t i = 0; i < values.size(); ++i)
+            {
+                out << (i > 0 ? ", " : "") << values[i];
+            }
+            out << "]";
+        }
+    }
+
+    std::string TreeReport::json() const
+    {
+        std::ostringstream out;
+        out << "{\"triangles\": " << triangles << ", \"vertices\": " << vertices
+            << ", \"nodes\": " << nodes << ", \"leaves\": " << leaves << ", \"max_depth\": " << max_depth
+            << ", \"sah_cost\": " << sah_cost << ", \"mean_sibling_overlap\": " << mean_sibling_overlap
+            << ", \"mean_empty_space\": " << mean_empty_space << ", \"depth_histogram\": ";
+        json_array(out, depth_histogram);
+        out << ", \"leaf_size_histogram\": ";
+        json_array(out, leaf_size_histogram);
+        out << ", \"node_bytes\": " << node_bytes << ", \"unused_node_bytes\": " << unused_node_bytes
+            << ", \"triangle_bytes\": " << triangle_bytes << ", \"vertex_bytes\": " << vertex_bytes
+            << ", \"total_bytes\": " << total_bytes() << "}";
+        return out.str();
+    }
+
+    template <class Primitive>
+    BasicAABBTree<Primitive>::BasicAABBTree(std::vector<Triangle>& tri, float aabb_expansion)
+        requires std::same_as<Primitive, Triangle>
+        : tris(tri)
+    {
+        build(aabb_expansion);
+    }
+
+    template <class Primitive>
+    BasicAABBTree<Primitive>::BasicAABBTree(IndexedMesh& indexed_mesh, float aabb_expansion)
+        requires std::same_as<Primitive, IndexedTriangle>
+        : tris(indexed_mesh.triangles), mesh(&indexed_mesh)
+    {
+        build(aabb_expansion);
+    }
+
+    template <class Primitive>
+    BasicAABBTree<Primitive>::BasicAABBTree(std::vector<Triangle>& tri, float aabb_expansion,
+                                            const std::atomic<bool>& cancel_build)
+        requires std::same_as<Primitive, Triangle>
+        : tris(tri), cancel(&cancel_build)
+    {
+        build(aabb_expansion);
+    }
+
+    template <class Primitive>
+    BasicAABBTree<Primitive>::BasicAABBTree(IndexedMesh& indexed_mesh, float aabb_expansion,
+                                            const std::atomic<bool>& cancel_build)
+        requires std::same_as<Primitive, IndexedTriangle>
+        : tris(indexed_mesh.triangles), mesh(&indexed_mesh), cancel(&cancel_build)
+    {
+        build(aabb_expansion);
+    }
+
+    template <class Primitive>
+    void BasicAABBTree<Primitive>::build(float aabb_expansion)
     {
         preallocated_nodes.resize(2 * tris.size());
 
@@ -17,7 +96,9 @@ namespace BVH
         assert(count_leaf_triangles((Node *)root) == tris.size());
     }
 
-    Node *AABBTree::new_node(std::vector<Triangle>::iterator begin, std::vector<Triangle>::iterator end)
+    template <class Primitive>
+    typename BasicAABBTree<Primitive>::Node *
+    BasicAABBTree<Primitive>::new_node(Iterator begin, Iterator end)
     {
         assert(num_used_nodes < (2 * tris.size()));
         Node* node = &preallocated_nodes[num_used_nodes++];
@@ -26,20 +107,152 @@ namespace BVH
         return node;
     }
 
-    bool AABBTree::does_intersect_ray(Vector4 origin, Vector4 direction, float *t_out, Vector4 *pt_out, Vector4 *normal_out) const
+    template <class Primitive>
+    template <class Stats>
+    bool BasicAABBTree<Primitive>::intersect(Vector4 origin, Vector4 direction, float *t_out, Vector4 *pt_out, Vector4 *normal_out,
+                                             std::uint32_t *primitive_out, Stats &stats) const
     {
         Ray ray(origin, direction);
-        intersect_ray_bvh(ray, (Node *)root);
+        intersect_ray_bvh(ray, (Node *)root, mesh, tris.begin(), stats);
         *t_out = ray.get_t();
         *pt_out = ray.get_pt();
         *normal_out = ray.get_normal();
+        if (primitive_out)
+        {
+            *primitive_out = ray.get_primitive();
+        }
         return ray.get_t() < std::numeric_limits<float>::max();
     }
 
-    void AABBTree::print_stats() const
+    template <class Primitive>
+    template <class Stats>
+    bool BasicAABBTree<Primitive>::occluded(Vector4 origin, Vector4 direction, float t_max, Stats &stats) const
+    {
+        Ray ray(origin, direction);
+        ray.set_t(t_max);
+        return occlude_ray_bvh(ray, (Node *)root, mesh, stats);
+    }
+
+    template <class Primitive>
+    bool BasicAABBTree<Primitive>::does_intersect_ray(Vector4 origin, Vector4 direction, float *t_out, Vector4 *pt_out, Vector4 *normal_out,
+                                                      std::uint32_t *primitive_out) const
+    {
+        NoStats stats;
+        return intersect(origin, direction, t_out, pt_out, normal_out, primitive_out, stats);
+    }
+
+    template <class Primitive>
+    bool BasicAABBTree<Primitive>::is_occluded(Vector4 origin, Vector4 direction, float t_max) const
     {
-        std::cout << "Num. BVH triangles = " << tris.size() << std::endl;
-        std::cout << "Num. BVH leaf nodes = " << count_leaf_nodes(root) << std::endl;
+        NoStats stats;
+        return occluded(origin, direction, t_max, stats);
     }
 
+    template <class Primitive>
+    bool BasicAABBTree<Primitive>::does_intersect_ray(Vector4 origin, Vector4 direction, float *t_out, Vector4 *pt_out, Vector4 *normal_out,
+                                                      std::uint32_t *primitive_out, TraversalStats &stats) const
+    {
+        stats.queries++;
+        return intersect(origin, direction, t_out, pt_out, normal_out, primitive_out, stats);
+    }
+
+    template <class Primitive>
+    bool BasicAABBTree<Primitive>::is_occluded(Vector4 origin, Vector4 direction, float t_max, TraversalStats &stats) const
+    {
+        stats.queries++;
+        return occluded(origin, direction, t_max, stats);
+    }
+
+    template <class Primitive>
+    TreeReport BasicAABBTree<Primitive>::report() const
+    {
+        TreeReport report;
+        report.triangles = tris.size();
+        report.vertices = mesh ? mesh->vertices.size() : 3 * tris.size();
+        report.nodes = num_used_nodes;
+        report.node_bytes = num_used_nodes * sizeof(Node);
+        report.unused_node_bytes = (preallocated_nodes.capacity() - num_used_nodes) * sizeof(Node);
+        report.triangle_bytes = tris.capacity() * sizeof(Primitive);
+        report.vertex_bytes = mesh ? mesh->vertices.capacity() * sizeof(mesh->vertices[0]) : 0;
+        if (root == nullptr)
+        {
+            return report;
+        }
+
+        const double root_area = surface_area(root->aabb);
+        std::size_t interior = 0;
+        std::vector<std::pair<const Node *, std::size_t>> stack = {{root, 0}};
+        while (!stack.empty())
+        {
+            const auto [node, depth] = stack.back();
+            stack.pop_back();
+            // A flat model has no area only if it is a single point
+            const double area = root_area > 0.0 ? surface_area(node->aabb) / root_area : 1.0;
+            if (node->is_leaf())
+            {
+                const std::size_t size = std::distance(node->begin, node->end);
+                report.sah_cost += area * size;
+                report.leaves++;
+                report.max_depth = std::max(report.max_depth, depth);
+                if (report.depth_histogram.size() <= depth)
+                {
+                    report.depth_histogram.resize(depth + 1);
+                }
+                report.depth_histogram[depth]++;
+                std::size_t bucket = 0;
+                while ((std::size_t(2) << bucket) <= size)
+                {
+                    bucket++;
+                }
+                if (report.leaf_size_histogram.size() <= bucket)
+                {
+                    report.leaf_size_histogram.resize(bucket + 1);
+                }
+                report.leaf_size_histogram[bucket]++;
+                continue;
+            }
+
+            // Both child boxes are tested once the node is entered
+            report.sah_cost += 2.0 * area;
+            const AABB &left = node->left->aabb, &right = node->right->aabb;
+            const double parent = volume(node->aabb.lower, node->aabb.upper);
+            if (parent > 0.0)
+            {
+                const double overlap = volume(left.lower.max(right.lower), left.upper.min(right.upper));
+                const double covered = volume(left.lower, left.upper) + volume(right.lower, right.upper) - overlap;
+                report.mean_sibling_overlap += overlap / parent;
+                report.mean_empty_space += std::max(1.0 - covered / parent, 0.0);
+            }
+            interior++;
+            stack.push_back({node->right, depth + 1});
+            stack.push_back({node->left, depth + 1});
+        }
+        // The root's box is tested by every ray
+        report.sah_cost += 1.0;
+        if (interior > 0)
+        {
+            report.mean_sibling_overlap /= interior;
+            report.mean_empty_space /= interior;
+        }
+        return report;
+    }
+
+    template <class Primitive>
+    void BasicAABBTree<Primitive>::print_stats() const
+    {
+        const TreeReport stats = report();
+        std::cout << "Num. BVH triangles = " << stats.triangles << std::endl;
+        std::cout << "Num. BVH leaf nodes = " << stats.leaves << std::endl;
+        if (mesh)
+        {
+            std::cout << "Num. BVH vertices = " << stats.vertices << std::endl;
+        }
+        std::cout << "BVH depth = " << stats.max_depth << ", SAH cost = " << stats.sah_cost << std::endl;
+        std::cout << "BVH memory = " << stats.total_bytes() / (1 << 20) << " MB, of which "
+                  << stats.unused_node_bytes / (1 << 20) << " MB unused nodes" << std::endl;
+    }
+
+    template class BasicAABBTree<Triangle>;
+    template class BasicAABBTree<IndexedTriangle>;
+
 }
@@ -1,7 +1,12 @@
 #ifndef BVH_HPP_
 #define BVH_HPP_
 
+#include <array>
+#include <atomic>
+#include <concepts>
 #include <cstddef>
+#include <cstdint>
+#include <string>
 #include <vector>
 
 #include "non_copyable.hpp"
@@ -20,20 +25,112 @@ namespace BVH
         }
     };
 
+    // Triangle referencing three vertices of an IndexedMesh
+    using IndexedTriangle = std::array<std::uint32_t, 3>;
+
+    // Shared-vertex triangle mesh
+    struct IndexedMesh
+    {
+        std::vector<std::array<float, 3>> vertices;
+        std::vector<IndexedTriangle> triangles;
+
+        Vector4 vertex(std::uint32_t i) const
+        {
+            const auto &v = vertices[i];
+            return Vector4(v[0], v[1], v[2]);
+        }
+
+        Triangle triangle(const IndexedTriangle &tri) const
+        {
+            return {vertex(tri[0]), vertex(tri[1]), vertex(tri[2])};
+        }
+    };
+
+    // Vertex access shared by the soup and indexed trees
+    inline const Triangle &fetch_triangle(const Triangle &tri, const IndexedMesh *)
+    {
+        return tri;
+    }
+
+    inline Triangle fetch_triangle(const IndexedTriangle &tri, const IndexedMesh *mesh)
+    {
+        return mesh->triangle(tri);
+    }
+
+    // Traversal counter policy that counts nothing, the calls compile away
+    struct NoStats
+    {
+        void node() {}
+        void box() {}
+        void triangle() {}
+        void hit() {}
+    };
+
+    // Traversal counters: nodes entered, boxes and triangles tested and
+    // triangles hit, summed over queries
+    struct TraversalStats
+    {
+        std::uint64_t queries = 0, nodes = 0, boxes = 0, triangles = 0, hits = 0;
+
+        void node() { ++nodes; }
+        void box() { ++boxes; }
+        void triangle() { ++triangles; }
+        void hit() { ++hits; }
+
+        TraversalStats &operator+=(const TraversalStats &other)
+        {
+            queries += other.queries;
+            nodes += other.nodes;
+            boxes += other.boxes;
+            triangles += other.triangles;
+            hits += other.hits;
+            return *this;
+        }
+    };
+
     struct AABB
     {
         Vector4 upper, lower;
     };
 
-    struct Node
+    // Quality and memory of a built tree, see BasicAABBTree::report
+    struct TreeReport
+    {
+        // A soup has 3 vertices per triangle, stored in triangle_bytes
+        std::size_t triangles = 0, vertices = 0, nodes = 0, leaves = 0, max_depth = 0;
+
+        // Surface area heuristic: expected boxes and triangles tested by a
+        // random ray hitting the root, as counted by TraversalStats
+        double sah_cost = 0.0;
+        // Over interior nodes, the volume shared by the children and the
+        // volume covered by neither, both relative to the node's volume
+        double mean_sibling_overlap = 0.0;
+        double mean_empty_space = 0.0;
+
+        std::vector<std::size_t> depth_histogram;     // leaves per depth, the root at depth 0
+        std::vector<std::size_t> leaf_size_histogram; // leaves with [2^i, 2^(i+1)) triangles per i
+
+        // Bytes allocated, the node pool including the part left unused
+        std::size_t node_bytes = 0, unused_node_bytes = 0, triangle_bytes = 0, vertex_bytes = 0;
+
+        std::size_t total_bytes() const
+        {
+            return node_bytes + unused_node_bytes + triangle_bytes + vertex_bytes;
+        }
+
+        std::string json() const;
+    };
+
+    template <class Iterator>
+    struct BasicNode
     {
-        std::vector<Triangle>::iterator begin, end;
-        Node *left = nullptr, *right = nullptr;
+        Iterator begin, end;
+        BasicNode *left = nullptr, *right = nullptr;
         AABB aabb;
 
-        Node() = default;
+        BasicNode() = default;
 
-        Node(std::vector<Triangle>::iterator begin, std::vector<Triangle>::iterator end)
+        BasicNode(Iterator begin, Iterator end)
         {
             this->begin = begin;
             this->end = end;
@@ -47,27 +144,74 @@ namespace BVH
         }
     };
 
-    class AABBTree : public NonCopyable
+    template <class Primitive>
+    class BasicAABBTree : public NonCopyable
     {
+    public:
+        using Iterator = typename std::vector<Primitive>::iterator;
+        using Node = BasicNode<Iterator>;
 
     private:
-        std::vector<Triangle>& tris;
+        std::vector<Primitive>& tris;
+        const IndexedMesh *mesh = nullptr;
+        const std::atomic<bool> *cancel = nullptr;
         std::vector<Node> preallocated_nodes;
         std::size_t num_used_nodes = 0;
 
-        Node *new_node(std::vector<Triangle>::iterator begin, std::vector<Triangle>::iterator end);
+        void build(float aabb_expansion);
+        template <class Stats>
+        bool intersect(Vector4 origin, Vector4 direction, float *t_out, Vector4 *pt_out, Vector4 *normal_out,
+                       std::uint32_t *primitive_out, Stats &stats) const;
+        template <class Stats>
+        bool occluded(Vector4 origin, Vector4 direction, float t_max, Stats &stats) const;
+        Node *new_node(Iterator begin, Iterator end);
         void subdivide(Node *, float);
 
     public:
         Node* root = nullptr;
 
-        AABBTree(std::vector<Triangle>& tris, float aabb_expansion);
+        BasicAABBTree(std::vector<Triangle>& tris, float aabb_expansion)
+            requires std::same_as<Primitive, Triangle>;
+
+        // Reorders mesh.triangles, the vertex buffer is left untouched
+        BasicAABBTree(IndexedMesh& mesh, float aabb_expansion)
+            requires std::same_as<Primitive, IndexedTriangle>;
+
+        // As above, throwing std::runtime_error if cancel is set during the build
+        BasicAABBTree(std::vector<Triangle>& tris, float aabb_expansion, const std::atomic<bool>& cancel)
+            requires std::same_as<Primitive, Triangle>;
+        BasicAABBTree(IndexedMesh& mesh, float aabb_expansion, const std::atomic<bool>& cancel)
+            requires std::same_as<Primitive, IndexedTriangle>;
 
-        bool does_intersect_ray(Vector4 origin, Vector4 direction, float *t_out, Vector4 *pt_out, Vector4 *normal_out) const;
+        // primitive_out, if given, receives the index of the hit triangle in the reordered triangles
+        bool does_intersect_ray(Vector4 origin, Vector4 direction, float *t_out, Vector4 *pt_out, Vector4 *normal_out,
+                                std::uint32_t *primitive_out = nullptr) const;
+
+        // True if anything is hit along the ray before t_max, without finding the closest hit
+        bool is_occluded(Vector4 origin, Vector4 direction, float t_max) const;
+
+        // As above, also adding the query and its traversal counters to stats
+        bool does_intersect_ray(Vector4 origin, Vector4 direction, float *t_out, Vector4 *pt_out, Vector4 *normal_out,
+                                std::uint32_t *primitive_out, TraversalStats &stats) const;
+        bool is_occluded(Vector4 origin, Vector4 direction, float t_max, TraversalStats &stats) const;
+
+        // Triangle with a primitive index reported by does_intersect_ray
+        Triangle triangle(std::uint32_t primitive) const
+        {
+            return fetch_triangle(tris[primitive], mesh);
+        }
+
+        TreeReport report() const;
 
         void print_stats() const;
     };
 
+    using Node = BasicNode<std::vector<Triangle>::iterator>;
+    using IndexedNode = BasicNode<std::vector<IndexedTriangle>::iterator>;
+
+    using AABBTree = BasicAABBTree<Triangle>;
+    using IndexedAABBTree = BasicAABBTree<IndexedTriangle>;
+
 }
 
 #endif
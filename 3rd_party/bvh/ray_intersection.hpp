@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <limits>
 
 #include "bvh.hpp"
@@ -14,6 +15,7 @@ namespace BVH
     private:
         Vector4 m_origin, m_direction, m_reciprocal_direction, m_pt, m_normal;
         float m_t;
+        std::uint32_t m_primitive = 0;
 
     public:
         Ray(Vector4 origin, Vector4 direction)
@@ -68,10 +70,24 @@ namespace BVH
         {
             this->m_t = t;
         }
+
+        // Index of the closest triangle hit so far, set by the tree traversal
+        std::uint32_t get_primitive() const
+        {
+            return m_primitive;
+        }
+
+        void set_primitive(std::uint32_t primitive)
+        {
+            this->m_primitive = primitive;
+        }
     };
 
-    void intersect_ray_triangle(Ray &ray, const Triangle &tri)
+    // Stats is a traversal counter policy, such as NoStats or TraversalStats
+    template <class Stats>
+    void intersect_ray_triangle(Ray &ray, const Triangle &tri, Stats &stats)
     {
+        stats.triangle();
         // TODO: reduce code duplication,
         //       same code is repeated in segment/triangle intersection
         constexpr float COPLANAR_THRESHOLD = 0.00001;
@@ -100,6 +116,7 @@ namespace BVH
             is_point_above_plane(p, p2_n, tri.vertices[1]) &&
             is_point_above_plane(p, p3_n, tri.vertices[2]))
         {
+            stats.hit();
             if(t < ray.get_t()) {
                 ray.set_t(t);
                 ray.set_normal(normal);
@@ -108,7 +125,13 @@ namespace BVH
         }
     }
 
-    bool intersect_ray_aabb(const Ray &ray, const AABB &aabb)
+    inline void intersect_ray_triangle(Ray &ray, const Triangle &tri)
+    {
+        NoStats stats;
+        intersect_ray_triangle(ray, tri, stats);
+    }
+
+    inline bool intersect_ray_aabb(const Ray &ray, const AABB &aabb)
     {
         Vector4 t_upper = (aabb.upper - ray.get_origin()) * ray.get_reciprocal_direction();
         Vector4 t_lower = (aabb.lower - ray.get_origin()) * ray.get_reciprocal_direction();
@@ -122,30 +145,95 @@ namespace BVH
         return t_max > t_min;
     }
 
-    void intersect_ray_bvh(Ray &ray, Node *node)
+    // Box test limited to the part of the ray before its current t, for rays of finite length
+    inline bool intersect_ray_aabb_within(const Ray &ray, const AABB &aabb)
+    {
+        Vector4 t_upper = (aabb.upper - ray.get_origin()) * ray.get_reciprocal_direction();
+        Vector4 t_lower = (aabb.lower - ray.get_origin()) * ray.get_reciprocal_direction();
+        float t_min = t_upper.min(t_lower).max_elem3();
+        float t_max = t_upper.max(t_lower).min_elem3();
+        return t_max > t_min && t_min < ray.get_t() && t_max > 0;
+    }
+
+    // first is the start of the tree's primitives, hits are recorded as offsets from it
+    template <class Iterator, class Stats>
+    void intersect_ray_bvh(Ray &ray, BasicNode<Iterator> *node, const IndexedMesh *mesh, Iterator first, Stats &stats)
     {
         if (node == nullptr)
         {
             return;
         }
 
+        stats.box();
         if (!intersect_ray_aabb(ray, node->aabb))
         {
             return;
         }
+        stats.node();
 
         if (node->is_leaf())
         {
             for (auto it = node->begin; it != node->end; ++it)
             {
-                intersect_ray_triangle(ray, *it);
+                const float t = ray.get_t();
+                intersect_ray_triangle(ray, fetch_triangle(*it, mesh), stats);
+                if (ray.get_t() < t)
+                {
+                    ray.set_primitive(it - first);
+                }
             }
         }
         else
         {
-            intersect_ray_bvh(ray, node->left);
-            intersect_ray_bvh(ray, node->right);
+            intersect_ray_bvh(ray, node->left, mesh, first, stats);
+            intersect_ray_bvh(ray, node->right, mesh, first, stats);
+        }
+    }
+
+    template <class Iterator>
+    void intersect_ray_bvh(Ray &ray, BasicNode<Iterator> *node, const IndexedMesh *mesh, Iterator first)
+    {
+        NoStats stats;
+        intersect_ray_bvh(ray, node, mesh, first, stats);
+    }
+
+    // Any hit closer than the ray's t ends the traversal
+    template <class Iterator, class Stats>
+    bool occlude_ray_bvh(Ray &ray, BasicNode<Iterator> *node, const IndexedMesh *mesh, Stats &stats)
+    {
+        if (node == nullptr)
+        {
+            return false;
+        }
+
+        stats.box();
+        if (!intersect_ray_aabb_within(ray, node->aabb))
+        {
+            return false;
+        }
+        stats.node();
+
+        if (node->is_leaf())
+        {
+            const float t = ray.get_t();
+            for (auto it = node->begin; it != node->end; ++it)
+            {
+                intersect_ray_triangle(ray, fetch_triangle(*it, mesh), stats);
+                if (ray.get_t() < t)
+                {
+                    return true;
+                }
+            }
+            return false;
         }
+        return occlude_ray_bvh(ray, node->left, mesh, stats) || occlude_ray_bvh(ray, node->right, mesh, stats);
+    }
+
+    template <class Iterator>
+    bool occlude_ray_bvh(Ray &ray, BasicNode<Iterator> *node, const IndexedMesh *mesh)
+    {
+        NoStats stats;
+        return occlude_ray_bvh(ray, node, mesh, stats);
     }
 
 }
@@ -1,9 +1,18 @@
+#include <atomic>
 #include <chrono>
 #include <cmath>
+#include <condition_variable>
 #include <math.h>
 #include <cstdio>
 #include <fmt/format.h>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <mutex>
+#include <omp.h>
+#include <string>
+#include <thread>
 #include <vector>
 
 #include <SDL.h>
@@ -11,11 +20,18 @@
 
 #include "bvh.hpp"
 #include "camera.hpp"
+#include "FrameStats.hpp"
+#include "IndexMesh.hpp"
+#include "LoadPipeline.hpp"
+#include "OutOfCoreBVH.hpp"
+#include "Progressive.hpp"
+#include "Reprojection.hpp"
+#include "Shading.hpp"
+#include "Simplify.hpp"
+#include "Tiles.hpp"
 #include "raytrace.hpp"
 #include "vec4.hpp"
 
-#define CLAMP(x,min,max) ((x<min)?min:((x>max)?max:x))
-
 constexpr int WINDOW_WIDTH = 1024;
 constexpr int WINDOW_HEIGHT = 768;
 constexpr float ROTATION_SPEED = .001;
@@ -27,21 +43,158 @@ Vector4 light(100, -100, 100);
 Vector4 material(255, 245, 213, 127); // default material color (argb)
 double total_time_ns = 0.0;
 size_t num_frames = 0;
+int tile_size = 16;
+Tiles::Order tile_order = Tiles::Order::Hilbert;
+float ao_radius = 0.0f; // 0 is 5% of the model size
+// Adaptive anti-aliasing traces extra samples in the pixels on edges of the
+// G-buffer, at most aa_budget extra rays per pixel of the frame
+int aa_samples = 0; // per edge pixel, 0 disables
+float aa_budget = 0.25f;
+Shading::EdgeThresholds aa_edges;
+// Boxes and triangles tested by a primary ray that the cost heatmap shows in its hottest color
+float max_cost = 256.0f;
 
 struct Color
 {
     unsigned char a, b, g, r;
 };
 
-static void render(Color *pixels, const BVH::AABBTree &bvh, int width, int height, int render_method)
+// Render target. The pitch is the row length in pixels, which may exceed the
+// width when tracing straight into locked texture memory.
+struct Frame
+{
+    Color *pixels;
+    int width, height, pitch;
+};
+
+// How a pass samples the frame. A divisor above 1 traces every divisor-th pixel
+// and fills the block below and right of it. With accum set, the sample is
+// averaged with the earlier ones kept there, as locked texture memory is write only.
+// Full resolution passes are stored in the cache, if any, unless store is cleared.
+// With reproject set, the pass reuses the cached hits and only traces the pixels
+// they do not cover. A pass is abandoned when cancel is raised and then neither
+// shown nor cached.
+struct Sampling
+{
+    int divisor = 1;
+    float jitter_x = 0.0f, jitter_y = 0.0f;
+    float *accum = nullptr;
+    int sample = 0;
+    Reprojection::Cache *cache = nullptr;
+    bool reproject = false;
+    bool store = true;
+    const std::atomic<bool> *cancel = nullptr;
+};
+
+// Time spent on a render and the number of rays traced, primary and secondary.
+// The traversal counters are only collected by the cost heatmap.
+struct RenderStats
+{
+    double seconds;
+    std::uint64_t rays;
+    BVH::TraversalStats traversal;
+};
+
+// Mean traversal counters per query
+static std::string traversal_text(const BVH::TraversalStats &stats)
+{
+    const double n = std::max<std::uint64_t>(stats.queries, 1);
+    return fmt::format("{:.1f} nodes, {:.1f} boxes, {:.1f} triangles, {:.2f} hits per ray",
+                       stats.nodes / n, stats.boxes / n, stats.triangles / n, stats.hits / n);
+}
+
+// Secondary rays of a tile: rays_per_pixel rays from the hit point of each pixel
+struct SecondaryBatch
+{
+    std::vector<size_t> pixels;
+    std::vector<Vector4> origins;
+    std::vector<float> lengths;
+    std::vector<Vector4> directions;
+
+    void clear()
+    {
+        pixels.clear();
+        origins.clear();
+        lengths.clear();
+        directions.clear();
+    }
+};
+
+// Extra samples of a tile: samples_per_pixel stratified rays in each pixel on an edge
+struct EdgeBatch
+{
+    std::vector<size_t> pixels;
+    std::vector<Vector4> directions;
+    Shading::GBuffer samples;
+
+    void clear()
+    {
+        pixels.clear();
+        directions.clear();
+    }
+};
+
+// Random seed for a pixel and sample
+static std::uint32_t pixel_seed(size_t i, std::uint32_t sample_seed)
+{
+    std::uint32_t seed = uint32_t(i) ^ sample_seed;
+    seed = (seed ^ (seed >> 16)) * 0x85ebca6bu;
+    seed = (seed ^ (seed >> 13)) * 0xc2b2ae35u;
+    return seed ^ (seed >> 16);
+}
+
+// Diagonal of the model bounds
+template <class Primitive>
+static float model_size(const BVH::BasicAABBTree<Primitive> &bvh)
+{
+    return bvh.root ? (bvh.root->aabb.upper - bvh.root->aabb.lower).length3() : 0.0f;
+}
+
+static float model_size(const OutOfCoreBVH::PagedTree &bvh)
 {
-    float fov = cam.get_fov();
+    Vector4 lower, upper;
+    bvh.bounds(&lower, &upper);
+    return (upper - lower).length3();
+}
+
+// Tiles for the current resolution and tile settings, recomputed when they change
+static const std::vector<Tiles::Tile> &frame_tiles(int width, int height)
+{
+    static std::vector<Tiles::Tile> tiles;
+    static int cached[4] = {};
+    const int key[4] = {width, height, tile_size, int(tile_order)};
+    if (!std::equal(key, key + 4, cached))
+    {
+        tiles = Tiles::split(width, height, tile_size, tile_order);
+        std::copy(key, key + 4, cached);
+    }
+    return tiles;
+}
+
+// Traces the primary rays into the G-buffer, then the secondary rays of the
+// shadow and ambient occlusion methods, then shades it a row at a time
+template <class Tree>
+static RenderStats render(const Frame &frame, Shading::GBuffer &gbuffer, const Tree &bvh, const Camera &camera,
+                     int render_method, const Sampling &sampling = {})
+{
+    const int width = frame.width;
+    const int height = frame.height;
+    const int pitch = frame.pitch;
+    Color *pixels = frame.pixels;
+    const int divisor = sampling.divisor;
+    const float jitter_x = sampling.jitter_x;
+    const float jitter_y = sampling.jitter_y;
+    float *accum = sampling.accum;
+    const float weight = 1.0f / (sampling.sample + 1);
+    const bool first_sample = sampling.sample == 0;
+
+    float fov = camera.get_fov();
     float tan_half_fov = std::tan(fov / 2);
-    Vector4 cam_pos = cam.get_pos();
+    Vector4 cam_pos = camera.get_pos();
     Vector4 up;
     Vector4 right;
     Vector4 forward;
-    cam.calc_vectors(&up, &right, &forward);
+    camera.calc_vectors(&up, &right, &forward);
 
     float aspect_ratio;
     if (width > height)
@@ -53,98 +206,451 @@ static void render(Color *pixels, const BVH::AABBTree &bvh, int width, int heigh
         aspect_ratio = height / (float)width;
     }
 
-    auto t1 = std::chrono::high_resolution_clock::now();
-#pragma omp parallel for default(none) firstprivate(aspect_ratio, width, height, cam_pos, forward, right, tan_half_fov, up) shared(bvh, light, material, pixels, render_method)
-    for (int i = 0; i < width * height; i++)
+    Reprojection::View view;
+    view.eye = cam_pos;
+    view.forward = forward;
+    view.right = right;
+    view.up = up;
+    view.tan_half_fov = tan_half_fov;
+    view.aspect_ratio = aspect_ratio;
+    view.width = width;
+    view.height = height;
+    view.jitter_x = jitter_x;
+    view.jitter_y = jitter_y;
+
+    const int grid_width = (width + divisor - 1) / divisor;
+    const int grid_height = (height + divisor - 1) / divisor;
+    gbuffer.resize(size_t(grid_width) * grid_height);
+
+    const Shading::Method method = Shading::fromIndex(render_method);
+    Shading::Lighting lighting;
+    for (int c = 0; c < 3; c++)
     {
-        int pixel_x = i % width;
-        int pixel_y = i / width;
-        float pixel_x_normalized = pixel_x / (float)width;
-        float pixel_y_normalized = pixel_y / (float)height;
+        lighting.eye[c] = cam_pos[c];
+        lighting.light[c] = light[c];
+        lighting.material[c] = material[c + 1];
+    }
+    lighting.max_cost = max_cost;
+    const bool cost = method == Shading::Method::Cost;
+    BVH::TraversalStats traversal;
+    const bool secondary = Shading::needsVisibility(method);
+    // One shadow ray, or a stratified set of occlusion rays, fewer for previews
+    const int ao_strata = divisor > 1 ? 1 : 2;
+    const int rays_per_pixel = method == Shading::Method::AmbientOcclusion ? ao_strata * ao_strata : 1;
+    const float occlusion_length = ao_radius > 0.0f ? ao_radius : 0.05f * model_size(bvh);
+    const std::uint32_t sample_seed = (sampling.sample + 1) * 0x9e3779b9u;
+    uint64_t secondary_rays = 0;
+    // Adaptive anti-aliasing of full resolution passes, the sums of the extra
+    // samples are kept per pixel until the rows are shaded
+    const bool adaptive = divisor == 1 && aa_samples > 0 && !cost;
+    std::vector<std::uint8_t> edges;
+    std::vector<float> edge_rgb;
+    if (adaptive)
+    {
+        edges.resize(size_t(grid_width) * grid_height);
+        edge_rgb.resize(3 * edges.size());
+    }
+    uint64_t edge_count = 0, edge_rays = 0;
+    int edge_samples = 0;
 
-        pixel_x_normalized = 2 * pixel_x_normalized - 1;
-        pixel_x_normalized *= aspect_ratio;
-        pixel_y_normalized = 1 - 2 * pixel_y_normalized;
+    // Neighbouring rays in a row differ by a constant step
+    const Vector4 step = right * tan_half_fov * aspect_ratio * (2.0f * divisor / width);
+    const float direction_step[3] = {step.x, step.y, step.z};
 
-        Vector4 pixel_pos = cam_pos + forward + right * tan_half_fov * pixel_x_normalized + up * tan_half_fov * pixel_y_normalized;
+    const auto &tiles = frame_tiles(grid_width, grid_height);
+    const int num_tiles = tiles.size();
 
-        Vector4 ray_origin = cam_pos;
-        Vector4 ray_direction = (pixel_pos - cam_pos).normalized3();
+    auto t1 = std::chrono::high_resolution_clock::now();
+    Reprojection::Cache *cache = divisor == 1 ? sampling.cache : nullptr;
+    const std::atomic<bool> *cancel = sampling.cancel;
+    uint64_t primary_rays = gbuffer.size();
+    std::vector<std::uint8_t> needs_trace;
+    if (cache && sampling.reproject && !cost)
+    {
+        primary_rays = cache->reproject(view, gbuffer, needs_trace,
+                                        [&bvh](std::uint32_t primitive) { return bvh.triangle(primitive); });
+    }
 
-        float t = 0.0f;
-        Vector4 pt, normal;
-        if (bvh.does_intersect_ray(ray_origin, ray_direction, &t, &pt, &normal))
+#pragma omp parallel
+    {
+        BVH::TraversalStats thread_traversal;
+        // Small tiles along a space filling curve, handed out dynamically since
+        // their cost varies with how much of the model they cover
+#pragma omp for schedule(dynamic, 1)
+        for (int tile_index = 0; tile_index < num_tiles; tile_index++)
         {
-            // Map t from [0, inf[ to [0, 1[
-            // https://math.stackexchange.com/a/3200751/691043
-            float t_normalized = std::atan(t) / (M_PI / 2);
-            
-            // Method 1: Depth map render - show how far to geometry the camera is. White = close, gray = far away
-            if (render_method == 1) { 
-                unsigned char pixel_color = (t_normalized * t_normalized) * 255;
-                pixels[pixel_x + pixel_y * width] = {255, pixel_color, pixel_color, pixel_color};
-
+            if (cancel && cancel->load(std::memory_order_relaxed))
+                continue;
+            const Tiles::Tile &tile = tiles[tile_index];
+            for (int grid_y = tile.y0; grid_y < tile.y1; grid_y++)
+            {
+                for (int grid_x = tile.x0; grid_x < tile.x1; grid_x++)
+                {
+                    const size_t i = grid_x + size_t(grid_y) * grid_width;
+                    if (!needs_trace.empty() && !needs_trace[i])
+                        continue;
+                    const Vector4 ray_direction = view.direction(grid_x * divisor, grid_y * divisor).normalized3();
+                    float t = 0.0f;
+                    Vector4 pt, normal;
+                    std::uint32_t primitive = 0;
+                    bool hit;
+                    if (cost)
+                    {
+                        BVH::TraversalStats ray_traversal;
+                        hit = bvh.does_intersect_ray(cam_pos, ray_direction, &t, &pt, &normal, &primitive,
+                                                     ray_traversal);
+                        gbuffer.cost[i] = float(ray_traversal.boxes + ray_traversal.triangles);
+                        thread_traversal += ray_traversal;
+                    }
+                    else
+                    {
+                        hit = bvh.does_intersect_ray(cam_pos, ray_direction, &t, &pt, &normal, &primitive);
+                    }
+                    if (!hit)
+                    {
+                        t = std::numeric_limits<float>::infinity();
+                        normal = Vector4(0.0f);
+                    }
+                    gbuffer.t[i] = t;
+                    gbuffer.normal_x[i] = normal.x;
+                    gbuffer.normal_y[i] = normal.y;
+                    gbuffer.normal_z[i] = normal.z;
+                    gbuffer.primitive[i] = primitive;
+                }
             }
-            // Method 2: Normal map render - interpret normal vector as an rgb-vector. All blue = [0,0,1] is normal pointing straight up
-            else if (render_method == 2) {
-                pixels[pixel_x + pixel_y * width] = { 255,
-                                                      (unsigned char)((normal.z + 1) * 128),
-                                                      (unsigned char)((normal.y + 1) * 128),
-                                                      (unsigned char)((normal.x + 1) * 128) };
+        }
+        if (cost)
+        {
+#pragma omp critical
+            traversal += thread_traversal;
+        }
 
+        if (secondary)
+        {
+            SecondaryBatch batch;
+            float sx[4], sy[4], sz[4];
+#pragma omp for schedule(dynamic, 1) reduction(+ : secondary_rays)
+            for (int tile_index = 0; tile_index < num_tiles; tile_index++)
+            {
+                if (cancel && cancel->load(std::memory_order_relaxed))
+                    continue;
+                // Generate the rays of the whole tile, then trace them together
+                const Tiles::Tile &tile = tiles[tile_index];
+                batch.clear();
+                for (int grid_y = tile.y0; grid_y < tile.y1; grid_y++)
+                {
+                    for (int grid_x = tile.x0; grid_x < tile.x1; grid_x++)
+                    {
+                        const size_t i = grid_x + size_t(grid_y) * grid_width;
+                        const float t = gbuffer.t[i];
+                        gbuffer.visibility[i] = 1.0f;
+                        if (!(t < std::numeric_limits<float>::max()))
+                            continue;
+
+                        // Start slightly off the surface, on the side facing the camera
+                        const Vector4 ray_direction = view.direction(grid_x * divisor, grid_y * divisor).normalized3();
+                        Vector4 normal(gbuffer.normal_x[i], gbuffer.normal_y[i], gbuffer.normal_z[i]);
+                        if (normal.dot3(ray_direction) > 0)
+                            normal = normal * -1.0f;
+                        const Vector4 origin = cam_pos + ray_direction * t + normal * (1e-4f * (1.0f + t));
+
+                        if (method == Shading::Method::Shadow)
+                        {
+                            const Vector4 to_light = light - origin;
+                            const float distance = to_light.length3();
+                            if (normal.dot3(to_light) <= 0)
+                            {
+                                // Facing away from the light, shadowed without a ray
+                                gbuffer.visibility[i] = 0.0f;
+                                continue;
+                            }
+                            batch.lengths.push_back(distance);
+                            batch.directions.push_back(to_light / distance);
+                        }
+                        else
+                        {
+                            const float n[3] = {normal.x, normal.y, normal.z};
+                            Shading::cosineDirections(n, ao_strata, pixel_seed(i, sample_seed), sx, sy, sz);
+                            batch.lengths.push_back(occlusion_length);
+                            for (int k = 0; k < rays_per_pixel; k++)
+                                batch.directions.push_back(Vector4(sx[k], sy[k], sz[k]));
+                        }
+                        batch.pixels.push_back(i);
+                        batch.origins.push_back(origin);
+                    }
+                }
+
+                for (size_t p = 0; p < batch.pixels.size(); p++)
+                {
+                    int open = 0;
+                    for (int k = 0; k < rays_per_pixel; k++)
+                        open += !bvh.is_occluded(batch.origins[p], batch.directions[p * rays_per_pixel + k],
+                                                 batch.lengths[p]);
+                    gbuffer.visibility[batch.pixels[p]] = open / float(rays_per_pixel);
+                }
+                secondary_rays += batch.directions.size();
             }
-            // Default: Phong shading https://en.wikipedia.org/wiki/Phong_reflection_model 
-            else {
-
-                Vector4 ambient_color(255, 255, 0, 0); // (abgr)
-                Vector4 specular_color(255, 255, 255, 255); // (abgr)
-                Vector4 light_vector = (light - pt).normalized3();
-                Vector4 reflection_vector = (light_vector - 2 * (light_vector.dot3(normal)) * normal).normalized3();
-                float specular = reflection_vector.dot3(ray_direction.normalized3());
-                float diffuse = light_vector.dot3(normal);
-                
-                Vector4 pixel_color = 0.25 * ambient_color;                               // Ambient
-                if(diffuse > 0)
-                    pixel_color = pixel_color + 0.8 * material * diffuse;                 // Diffuse
-                if(specular > 0)
-                    pixel_color = pixel_color + 0.5 * pow(specular, 1.5) * specular_color;// Specular
-                
-                pixels[pixel_x + pixel_y * width] = { 255,
-                                                      (unsigned char)(CLAMP(pixel_color[3],0,255)),
-                                                      (unsigned char)(CLAMP(pixel_color[2],0,255)),
-                                                      (unsigned char)(CLAMP(pixel_color[1],0,255))};
-            }
+        }
+
+        if (adaptive)
+        {
+#pragma omp for schedule(static) reduction(+ : edge_count)
+            for (int grid_y = 0; grid_y < grid_height; grid_y++)
+                edge_count += Shading::findEdges(gbuffer, grid_width, grid_height, grid_y, aa_edges,
+                                                 &edges[grid_y * size_t(grid_width)]);
 
+            // As many strata per pixel as the budget allows, and only a random
+            // subset of the edges if it does not even allow one sample each
+            const double budget = aa_budget * double(gbuffer.size());
+            int strata = std::max(1, int(std::sqrt(float(aa_samples))));
+            while (strata > 1 && double(edge_count) * strata * strata > budget)
+                strata--;
+            const double keep = edge_count > 0 ? std::min(1.0, budget / edge_count) : 1.0;
+            const std::uint32_t keep_below = std::uint32_t(keep * 4294967295.0);
+            const int samples_per_pixel = strata * strata;
+            const std::uint32_t edge_seed = sample_seed ^ 0x632be5abu;
+            const float zero_step[3] = {0.0f, 0.0f, 0.0f};
+#pragma omp single nowait
+            edge_samples = samples_per_pixel;
+
+            EdgeBatch batch;
+#pragma omp for schedule(dynamic, 1) reduction(+ : edge_rays)
+            for (int tile_index = 0; tile_index < num_tiles; tile_index++)
+            {
+                if (cancel && cancel->load(std::memory_order_relaxed))
+                    continue;
+                const Tiles::Tile &tile = tiles[tile_index];
+                batch.clear();
+                for (int grid_y = tile.y0; grid_y < tile.y1; grid_y++)
+                {
+                    for (int grid_x = tile.x0; grid_x < tile.x1; grid_x++)
+                    {
+                        const size_t i = grid_x + size_t(grid_y) * grid_width;
+                        if (!edges[i])
+                            continue;
+                        std::uint32_t state = pixel_seed(i, edge_seed);
+                        if (state > keep_below)
+                        {
+                            edges[i] = 0;
+                            continue;
+                        }
+                        // One jittered sample in each cell of a strata x strata grid over the pixel
+                        state |= 1; // xorshift32 must not start at 0
+                        auto next = [&state]
+                        {
+                            state ^= state << 13;
+                            state ^= state >> 17;
+                            state ^= state << 5;
+                            return (state >> 8) * (1.0f / 16777216.0f);
+                        };
+                        batch.pixels.push_back(i);
+                        for (int v = 0; v < strata; v++)
+                            for (int u = 0; u < strata; u++)
+                            {
+                                const float x = grid_x + (u + next()) / strata;
+                                const float y = grid_y + (v + next()) / strata;
+                                batch.directions.push_back(view.directionAt(x, y));
+                            }
+                    }
+                }
+
+                // Trace all samples of the tile, then shade them one by one. They
+                // share the visibility of their pixel, no secondary rays are traced.
+                Shading::GBuffer &hits = batch.samples;
+                hits.resize(batch.directions.size());
+                for (size_t k = 0; k < batch.directions.size(); k++)
+                {
+                    float t = 0.0f;
+                    Vector4 pt, normal;
+                    std::uint32_t primitive = 0;
+                    if (!bvh.does_intersect_ray(cam_pos, batch.directions[k].normalized3(), &t, &pt, &normal,
+                                                &primitive))
+                    {
+                        t = std::numeric_limits<float>::infinity();
+                        normal = Vector4(0.0f);
+                    }
+                    hits.t[k] = t;
+                    hits.normal_x[k] = normal.x;
+                    hits.normal_y[k] = normal.y;
+                    hits.normal_z[k] = normal.z;
+                    hits.primitive[k] = primitive;
+                    hits.visibility[k] = gbuffer.visibility[batch.pixels[k / samples_per_pixel]];
+                }
+                for (size_t p = 0; p < batch.pixels.size(); p++)
+                {
+                    float *sum = &edge_rgb[3 * batch.pixels[p]];
+                    sum[0] = sum[1] = sum[2] = 0.0f;
+                    for (int s = 0; s < samples_per_pixel; s++)
+                    {
+                        const size_t k = p * samples_per_pixel + s;
+                        const float direction[3] = {batch.directions[k].x, batch.directions[k].y,
+                                                    batch.directions[k].z};
+                        float r, g, b;
+                        Shading::shade(method, hits, k, 1, lighting, direction, zero_step, &r, &g, &b);
+                        sum[0] += r;
+                        sum[1] += g;
+                        sum[2] += b;
+                    }
+                }
+                edge_rays += batch.directions.size();
+            }
         }
-        else // background image: All black
+
+        std::vector<float> rgb(3 * size_t(grid_width));
+#pragma omp for schedule(static)
+        for (int grid_y = 0; grid_y < grid_height; grid_y++)
         {
-            pixels[pixel_x + pixel_y * width] = {255, 0, 0, 0};
+            const Vector4 direction = view.direction(0, grid_y * divisor);
+            const float first_direction[3] = {direction.x, direction.y, direction.z};
+            float *r = rgb.data(), *g = r + grid_width, *b = g + grid_width;
+            Shading::shade(method, gbuffer, grid_y * size_t(grid_width), grid_width, lighting,
+                           first_direction, direction_step, r, g, b);
+            if (adaptive)
+            {
+                // Average the edge pixels with their extra samples
+                const float edge_weight = 1.0f / (edge_samples + 1);
+                for (int grid_x = 0; grid_x < grid_width; grid_x++)
+                {
+                    const size_t i = grid_x + size_t(grid_y) * grid_width;
+                    if (!edges[i])
+                        continue;
+                    r[grid_x] = (r[grid_x] + edge_rgb[3 * i]) * edge_weight;
+                    g[grid_x] = (g[grid_x] + edge_rgb[3 * i + 1]) * edge_weight;
+                    b[grid_x] = (b[grid_x] + edge_rgb[3 * i + 2]) * edge_weight;
+                }
+            }
+
+            const int pixel_y = grid_y * divisor;
+            for (int grid_x = 0; grid_x < grid_width; grid_x++)
+            {
+                const int pixel_x = grid_x * divisor;
+                Color color = {255, (unsigned char)b[grid_x], (unsigned char)g[grid_x], (unsigned char)r[grid_x]};
+                if (accum)
+                {
+                    float *sum = &accum[3 * (size_t(pixel_x) + size_t(pixel_y) * width)];
+                    const float sample[3] = {r[grid_x], g[grid_x], b[grid_x]};
+                    for (int c = 0; c < 3; c++)
+                        sum[c] = first_sample ? sample[c] : sum[c] + sample[c];
+                    color = {255,
+                             (unsigned char)(sum[2] * weight + 0.5f),
+                             (unsigned char)(sum[1] * weight + 0.5f),
+                             (unsigned char)(sum[0] * weight + 0.5f)};
+                }
+                for (int y = pixel_y; y < pixel_y + divisor && y < height; y++)
+                    for (int x = pixel_x; x < pixel_x + divisor && x < width; x++)
+                        pixels[x + size_t(y) * pitch] = color;
+            }
         }
     }
+    if (cache && sampling.store && !(cancel && cancel->load()))
+        cache->store(view, gbuffer);
     auto t2 = std::chrono::high_resolution_clock::now();
-    auto frame_time_ns = (t2 - t1).count();
-    total_time_ns += frame_time_ns;
-    num_frames++;
-    std::cout << "Rendering took: " << frame_time_ns / 1'000'000 << " milli seconds" << std::endl;
+    return {std::chrono::duration<double>(t2 - t1).count(), primary_rays + secondary_rays + edge_rays, traversal};
 }
 
-int main(int argc, char *argv[])
+// Traces one progressive pass into the frame, planned by Progressive::plan with
+// sampling.reproject telling whether cached hits are available. Samples are
+// accumulated in sampling.accum, which holds 3 floats per pixel. Previews,
+// including the one reprojected from the cache, are neither accumulated nor
+// cached, so hits that reprojection got wrong do not outlive them.
+template <class Tree>
+static RenderStats render_pass(const Frame &frame, Shading::GBuffer &gbuffer, const Tree &bvh,
+                               const Camera &camera, int pass, int render_method, Sampling sampling)
 {
-    std::cout << "Raytrace start" << std::endl;
-    if (argc < 2)
+    const Progressive::Pass plan = Progressive::plan(pass, sampling.reproject);
+    sampling.divisor = plan.divisor;
+    sampling.jitter_x = plan.jitter_x;
+    sampling.jitter_y = plan.jitter_y;
+    sampling.reproject = plan.reproject;
+    if (plan.preview())
     {
-        puts("Expected arguments: mesh.[stl|tri]");
-        return 1;
+        sampling.accum = nullptr;
+        sampling.store = false;
+    }
+    else
+    {
+        sampling.sample = plan.sample;
+    }
+    return render(frame, gbuffer, bvh, camera, render_method, sampling);
+}
+
+// Runs one job at a time on a long lived thread, so the next frame is traced
+// while the main thread handles events and presents the current one. Reusing
+// the thread also keeps its OpenMP team alive between frames.
+class FrameWorker
+{
+public:
+    FrameWorker() : thread([this] { loop(); }) {}
+
+    ~FrameWorker()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        wake.notify_all();
+        thread.join();
+    }
+
+    void start(std::function<void()> f)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = std::move(f);
+            busy = true;
+        }
+        wake.notify_all();
     }
-    
-    const char *filepath = argv[1];
-    float scale = (argc > 2) ? std::stof(argv[2]) : 0.01;
 
-    std::vector<BVH::Triangle> tris = load_bvh_tris_from_mesh_file(filepath, scale);
-    std::cout << "Loaded " << tris.size() << " triangles from " << filepath << std::endl;
-    BVH::AABBTree bvh(tris, 0.001f);
-    bvh.print_stats();
+    // Waits up to timeout for the current job, returns true if the worker is idle
+    bool wait_for(std::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        return done.wait_for(lock, timeout, [this] { return !busy; });
+    }
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return !busy; });
+    }
 
+private:
+    void loop()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true)
+        {
+            wake.wait(lock, [this] { return stop || job; });
+            if (!job)
+                return;
+            auto f = std::move(job);
+            job = nullptr;
+            lock.unlock();
+            f();
+            lock.lock();
+            busy = false;
+            done.notify_all();
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    std::function<void()> job;
+    bool busy = false, stop = false;
+    std::thread thread;
+};
+
+// with_tree(f) calls f with the current tree and returns a pointer identifying it,
+// or null if none is available yet.
+// with_tree(f, pixels_per_unit, eye) may instead call f with a simplified tree
+// that looks the same at that resolution from eye.
+// status() describes the loading progress.
+// Trees are only touched by one thread at a time: the worker while it traces,
+// otherwise the main thread.
+template <class WithTree, class Status>
+static void run(WithTree &&with_tree, Status &&status)
+{
     SDL_Event event;
     SDL_Renderer *renderer;
     SDL_Window *window;
@@ -156,11 +662,19 @@ int main(int argc, char *argv[])
     bool is_running = true;
     int render_method = 0;
     int32_t dx, dy;
-    auto *pixels = static_cast<Color *>(malloc(WINDOW_WIDTH * WINDOW_HEIGHT * 4));
+    std::vector<float> accum(3 * size_t(WINDOW_WIDTH) * WINDOW_HEIGHT);
+    Shading::GBuffer gbuffer;
 
-    SDL_Texture *buffer = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888,
-                                            SDL_TEXTUREACCESS_STREAMING,
-                                            WINDOW_WIDTH, WINDOW_HEIGHT);
+    // The front texture is presented while the worker traces the next pass
+    // straight into the locked back texture. Renderers that cannot lock get
+    // a buffer per texture, uploaded once the pass is done.
+    SDL_Texture *textures[2];
+    std::vector<Color> fallback[2];
+    for (auto &texture : textures)
+        texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING,
+                                    WINDOW_WIDTH, WINDOW_HEIGHT);
+    int front = 0;
+    bool has_frame = false;
 
     TTF_Init();
     TTF_Font* font = TTF_OpenFont("c:/Windows/Fonts/calibrib.ttf", 16);
@@ -172,10 +686,37 @@ int main(int argc, char *argv[])
     SDL_Texture* msg = nullptr;
 
     bool relative = true;
+    std::string title;
+    const void *shown_tree = nullptr;
+    int pass = 0;
+    bool present = false;
+
+    // Pass in flight on the worker, -1 if idle. Passes started before the last
+    // change of the view are traced to the end but never shown.
+    FrameWorker worker;
+    int job_pass = -1;
+    bool back_locked = false;
+    RenderStats job_stats = {};
+    uint64_t view = 0, job_view = 0;
+
+    // Hits of the last accumulated pass. After a camera move a full resolution
+    // preview reprojected from them replaces the coarse previews, then samples are
+    // accumulated as after any other change. A pass in flight when the view
+    // changes is cancelled.
+    Reprojection::Cache cache;
+    bool cache_ready = false;
+    bool reproject_next = false;
+    std::atomic<bool> cancel{false};
 
     while (true)
     {
-        while (SDL_PollEvent(&event) != 0)
+        // Sleep until something happens once the image is fully refined,
+        // waking up now and then to check for a new tree from the loader
+        const bool refined = pass >= Progressive::PASSES || !shown_tree;
+        int have_event = refined && job_pass < 0 ? SDL_WaitEventTimeout(&event, shown_tree ? 100 : 10)
+                                                 : SDL_PollEvent(&event);
+        bool changed = false;
+        for (; have_event != 0; have_event = SDL_PollEvent(&event))
         {
             Vector4 up;
             Vector4 right;
@@ -188,6 +729,10 @@ int main(int argc, char *argv[])
             case SDL_QUIT:
                 is_running = updateCam = false;
                 break;
+            case SDL_WINDOWEVENT:
+                updateCam = false;
+                present = true;
+                break;
             case SDL_MOUSEMOTION:
                 dx = event.motion.xrel;
                 dy = event.motion.yrel;
@@ -227,11 +772,15 @@ int main(int argc, char *argv[])
                 {
                     render_method = event.key.keysym.sym - SDLK_0;
                 }
+                break;
             default:
+                // Nothing that affects the image
+                updateCam = false;
                 break;
             }
 
             if (updateCam) {
+                changed = true;
                 if (msg)
                     SDL_DestroyTexture(msg);
                 SDL_Color White{255, 255, 255, 255};
@@ -252,23 +801,480 @@ int main(int argc, char *argv[])
         if (!is_running)
             break;
 
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-        SDL_RenderClear(renderer);
-        render(pixels, bvh, WINDOW_WIDTH, WINDOW_HEIGHT, render_method);
-        SDL_UpdateTexture(buffer, nullptr, pixels, WINDOW_WIDTH * 4);
-        SDL_RenderCopy(renderer, buffer, nullptr, nullptr);
-        if (msg)
-            SDL_RenderCopy(renderer, msg, nullptr, &msg_rect);
-        SDL_RenderPresent(renderer);
+        const std::string new_title = fmt::format("Raytrace - {}", status());
+        if (new_title != title)
+        {
+            title = new_title;
+            SDL_SetWindowTitle(window, title.c_str());
+        }
+
+        if (changed)
+        {
+            view++;
+            pass = Progressive::firstPass(cache_ready);
+            reproject_next = cache_ready;
+            if (job_pass >= 0)
+                cancel = true;
+        }
+
+        // Collect a finished pass, waiting briefly so events are still handled promptly
+        if (job_pass >= 0 && worker.wait_for(std::chrono::milliseconds(changed ? 0 : 1)))
+        {
+            const int back = 1 - front;
+            if (back_locked)
+                SDL_UnlockTexture(textures[back]);
+            else
+                SDL_UpdateTexture(textures[back], nullptr, fallback[back].data(), WINDOW_WIDTH * 4);
+            if (job_pass >= 2 && !cancel)
+                cache_ready = true;
+            if (job_view == view)
+            {
+                front = back;
+                has_frame = true;
+                present = true;
+                pass = job_pass + 1;
+                const double frame_time_ns = job_stats.seconds * 1e9;
+                if (job_pass >= 2)
+                {
+                    total_time_ns += frame_time_ns;
+                    num_frames++;
+                }
+                std::cout << "Rendering took: " << int64_t(frame_time_ns) / 1'000'000 << " milli seconds" << std::endl;
+                if (job_stats.traversal.queries > 0)
+                    std::cout << "Traversal: " << traversal_text(job_stats.traversal) << std::endl;
+            }
+            job_pass = -1;
+        }
+
+        if (job_pass < 0)
+        {
+            const void *tree = with_tree([](const auto &) {});
+            if (tree != shown_tree)
+            {
+                shown_tree = tree;
+                view++;
+                pass = 0;
+                cache.clear();
+                cache_ready = false;
+                reproject_next = false;
+            }
+        }
+
+        // Trace only while the image is still being refined
+        if (job_pass < 0 && shown_tree && pass < Progressive::PASSES)
+        {
+            const int back = 1 - front;
+            void *locked_pixels = nullptr;
+            int locked_pitch = 0;
+            back_locked = SDL_LockTexture(textures[back], nullptr, &locked_pixels, &locked_pitch) == 0;
+            Frame frame{static_cast<Color *>(locked_pixels), WINDOW_WIDTH, WINDOW_HEIGHT,
+                        locked_pitch / int(sizeof(Color))};
+            if (!back_locked)
+            {
+                fallback[back].resize(size_t(WINDOW_WIDTH) * WINDOW_HEIGHT);
+                frame = {fallback[back].data(), WINDOW_WIDTH, WINDOW_HEIGHT, WINDOW_WIDTH};
+            }
+
+            job_pass = pass;
+            job_view = view;
+            cancel = false;
+            Sampling sampling;
+            sampling.accum = accum.data();
+            sampling.cache = &cache;
+            sampling.reproject = reproject_next;
+            sampling.cancel = &cancel;
+            reproject_next = false;
+            worker.start([&with_tree, &job_stats, &gbuffer, frame, sampling, camera = cam, method = render_method, p = pass]
+            {
+                // Previews are not cached, so they may trace a level of detail, except the
+                // reprojected one as the cached primitives index the full tree
+                const Progressive::Pass plan = Progressive::plan(p, sampling.reproject);
+                const float pixels_per_unit = plan.preview() && !plan.reproject ? float(frame.height) / plan.divisor / (2.0f * std::tan(camera.get_fov() / 2)) : 0.0f;
+                with_tree([&](const auto &bvh)
+                {
+                    job_stats = render_pass(frame, gbuffer, bvh, camera, p, method, sampling);
+                }, pixels_per_unit, camera.get_pos());
+            });
+        }
+
+        if (present || changed)
+        {
+            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+            SDL_RenderClear(renderer);
+            if (has_frame)
+                SDL_RenderCopy(renderer, textures[front], nullptr, nullptr);
+            if (msg)
+                SDL_RenderCopy(renderer, msg, nullptr, &msg_rect);
+            SDL_RenderPresent(renderer);
+            present = false;
+        }
+    }
+
+    // The worker may still be writing into the back texture
+    if (job_pass >= 0)
+    {
+        worker.wait();
+        if (back_locked)
+            SDL_UnlockTexture(textures[1 - front]);
     }
+    for (auto &texture : textures)
+        SDL_DestroyTexture(texture);
     if (msg)
         SDL_DestroyTexture(msg);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
-    free(pixels);
 
-    std::cout << "Avreage milliseconds per frame = " << (total_time_ns / num_frames) / 1'000'000 << std::endl;
+    if (num_frames > 0)
+        std::cout << "Avreage milliseconds per frame = " << (total_time_ns / num_frames) / 1'000'000 << std::endl;
+}
+
+struct BenchmarkOptions
+{
+    bool headless = false;
+    int frames = 100;
+    int warmup = 2;
+    int width = WINDOW_WIDTH;
+    int height = WINDOW_HEIGHT;
+    int threads = 0; // OpenMP default
+    int render_method = 0;
+    bool reproject = false; // trace only what the previous frame's hits do not cover
+    std::string camera_path = "orbit";
+    std::string json;   // stdout if empty
+    std::string images; // directory for PPM frames, none if empty
+};
+
+// Camera for frame i of n on a fixed path around the bounds of the mesh
+static Camera path_camera(const std::string &path, int i, int n, Vector4 lower, Vector4 upper)
+{
+    const Vector4 center = (lower + upper) * 0.5f;
+    const float radius = std::max((upper - lower).length3(), 1e-6f);
+    const float s = n > 1 ? i / float(n - 1) : 0.0f;
+    if (path == "orbit")
+    {
+        const float angle = 2 * M_PI * i / n;
+        const Vector4 pos = center + Vector4(std::cos(angle), std::sin(angle), 0.25f) * radius;
+        return Camera(pos, center);
+    }
+    else if (path == "flythrough")
+    {
+        const Vector4 pos = center + Vector4(0.0f, 2.0f * s - 1.0f, 0.05f) * radius;
+        return Camera(pos, pos + Vector4(0.0f, 1.0f, 0.0f));
+    }
+    else if (path == "static")
+    {
+        return Camera({0, -2, 0}, {0, 0, 0});
+    }
+    throw std::runtime_error("Unknown camera path " + path);
+}
+
+static void write_ppm(const std::string &filename, const Color *pixels, int width, int height)
+{
+    std::ofstream file(filename, std::ios::binary);
+    file << "P6\n" << width << " " << height << "\n255\n";
+    std::vector<unsigned char> rgb(3 * size_t(width) * height);
+    for (size_t i = 0; i < size_t(width) * height; i++)
+    {
+        rgb[3 * i] = pixels[i].r;
+        rgb[3 * i + 1] = pixels[i].g;
+        rgb[3 * i + 2] = pixels[i].b;
+    }
+    file.write(reinterpret_cast<const char *>(rgb.data()), rgb.size());
+    if (!file)
+        throw std::runtime_error("Error writing " + filename);
+}
+
+static std::string json_string(const std::string &str)
+{
+    std::string result = "\"";
+    for (char c : str)
+    {
+        if (c == '"' || c == '\\')
+            result += '\\';
+        result += c;
+    }
+    return result + "\"";
+}
+
+// Traces frames along a camera path without a window and reports the timings as JSON
+template <class Tree>
+static void benchmark(const Tree &bvh, Vector4 lower, Vector4 upper, const BenchmarkOptions &options,
+                      std::vector<std::pair<std::string, std::string>> info)
+{
+    std::vector<Color> pixels(size_t(options.width) * options.height);
+    Shading::GBuffer gbuffer;
+    Reprojection::Cache cache;
+    FrameStats stats;
+    BVH::TraversalStats traversal;
+    for (int i = -options.warmup; i < options.frames; i++)
+    {
+        const Camera camera = path_camera(options.camera_path, std::max(i, 0), options.frames, lower, upper);
+        const Frame frame{pixels.data(), options.width, options.height, options.width};
+        Sampling sampling;
+        if (options.reproject)
+        {
+            sampling.cache = &cache;
+            sampling.reproject = !cache.empty();
+        }
+        const RenderStats rendered = render(frame, gbuffer, bvh, camera, options.render_method, sampling);
+        if (i < 0)
+            continue;
+        stats.add(rendered.seconds, rendered.rays);
+        traversal += rendered.traversal;
+        if (!options.images.empty())
+            write_ppm(fmt::format("{}/frame_{:04d}.ppm", options.images, i), pixels.data(),
+                      options.width, options.height);
+    }
+
+    info.push_back({"width", std::to_string(options.width)});
+    info.push_back({"height", std::to_string(options.height)});
+    info.push_back({"threads", std::to_string(omp_get_max_threads())});
+    info.push_back({"camera_path", json_string(options.camera_path)});
+    info.push_back({"render_method", std::to_string(options.render_method)});
+    info.push_back({"reproject", options.reproject ? "true" : "false"});
+    info.push_back({"warmup_frames", std::to_string(options.warmup)});
+    info.push_back({"aa_samples", std::to_string(aa_samples)});
+    info.push_back({"aa_budget", fmt::format("{}", aa_budget)});
+    info.push_back({"tile_size", std::to_string(tile_size)});
+    info.push_back({"tile_order", json_string(tile_order == Tiles::Order::Hilbert  ? "hilbert"
+                                              : tile_order == Tiles::Order::Morton ? "morton"
+                                                                                   : "scanline")});
+    if (traversal.queries > 0)
+    {
+        const double n = traversal.queries;
+        info.push_back({"max_cost", fmt::format("{}", max_cost)});
+        info.push_back({"traversal", fmt::format("{{\"queries\": {}, \"nodes_per_ray\": {:.3f}, \"boxes_per_ray\": {:.3f}, "
+                                                 "\"triangles_per_ray\": {:.3f}, \"hits_per_ray\": {:.3f}}}",
+                                                 traversal.queries, traversal.nodes / n, traversal.boxes / n,
+                                                 traversal.triangles / n, traversal.hits / n)});
+    }
+    const std::string json = stats.json(info);
+    if (options.json.empty())
+    {
+        std::cout << json;
+    }
+    else
+    {
+        std::ofstream file(options.json);
+        file << json;
+        if (!file)
+            throw std::runtime_error("Error writing " + options.json);
+    }
+}
+
+static void print_usage()
+{
+    puts("Expected arguments: mesh.[stl|tri|ply|obj|wmsh|wbvh] [scale] [weld tolerance] [options]");
+    puts("Headless benchmark options:");
+    puts("  --headless            trace without a window and print JSON timings");
+    puts("  --frames N            number of measured frames (default 100)");
+    puts("  --warmup N            unmeasured frames first (default 2)");
+    puts("  --size WxH            resolution (default 1024x768)");
+    puts("  --threads N           OpenMP threads");
+    puts("  --path orbit|flythrough|static  camera path (default orbit)");
+    puts("  --method N            render method, as the number keys: 0 Phong, 1 depth,");
+    puts("                        2 normals, 3 triangles, 4 shadows, 5 ambient occlusion,");
+    puts("                        6 traversal cost heatmap, with per ray counters in the JSON");
+    puts("  --ao-radius R         ambient occlusion ray length (default 5% of the model size)");
+    puts("  --reproject           reuse the previous frame's hits, tracing only the rest");
+    puts("  --json file           write the JSON to a file instead of stdout");
+    puts("  --images dir          write each frame as PPM");
+    puts("Rendering options:");
+    puts("  --tile N              tile size in pixels (default 16)");
+    puts("  --order scanline|morton|hilbert  tile order (default hilbert)");
+    puts("  --aa N                extra samples in pixels on edges, rounded down to a square (default 0, off)");
+    puts("  --aa-budget F         at most F extra samples per pixel of the frame (default 0.25)");
+    puts("  --max-cost N          boxes and triangles per ray shown hottest by method 6 (default 256)");
+    puts("  --lod N               trace previews on up to N simplified levels of detail, cached next to the mesh");
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<std::string> positional;
+    BenchmarkOptions bench;
+    int lod_levels = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        if (arg.rfind("--", 0) != 0)
+        {
+            positional.push_back(arg);
+            continue;
+        }
+        if (arg == "--headless")
+        {
+            bench.headless = true;
+            continue;
+        }
+        if (arg == "--reproject")
+        {
+            bench.reproject = true;
+            continue;
+        }
+        if (i + 1 >= argc)
+        {
+            print_usage();
+            return 1;
+        }
+        const std::string value = argv[++i];
+        if (arg == "--frames")
+            bench.frames = std::stoi(value);
+        else if (arg == "--warmup")
+            bench.warmup = std::stoi(value);
+        else if (arg == "--size" && sscanf(value.c_str(), "%dx%d", &bench.width, &bench.height) == 2)
+            ;
+        else if (arg == "--threads")
+            bench.threads = std::stoi(value);
+        else if (arg == "--path")
+            bench.camera_path = value;
+        else if (arg == "--method")
+            bench.render_method = std::stoi(value);
+        else if (arg == "--json")
+            bench.json = value;
+        else if (arg == "--images")
+            bench.images = value;
+        else if (arg == "--ao-radius" && std::stof(value) > 0)
+            ao_radius = std::stof(value);
+        else if (arg == "--aa" && std::stoi(value) >= 0)
+            aa_samples = std::stoi(value);
+        else if (arg == "--aa-budget" && std::stof(value) >= 0)
+            aa_budget = std::stof(value);
+        else if (arg == "--max-cost" && std::stof(value) > 0)
+            max_cost = std::stof(value);
+        else if (arg == "--lod" && std::stoi(value) >= 0)
+            lod_levels = std::stoi(value);
+        else if (arg == "--tile" && std::stoi(value) > 0)
+            tile_size = std::stoi(value);
+        else if (arg == "--order" && (value == "scanline" || value == "morton" || value == "hilbert"))
+            tile_order = Tiles::parseOrder(value);
+        else
+        {
+            print_usage();
+            return 1;
+        }
+    }
+
+    const bool known_path = bench.camera_path == "orbit" || bench.camera_path == "flythrough" ||
+                            bench.camera_path == "static";
+    if (positional.empty() || !known_path || bench.frames < 1 || bench.width < 1 || bench.height < 1)
+    {
+        print_usage();
+        return 1;
+    }
+    if (bench.threads > 0)
+        omp_set_num_threads(bench.threads);
+    // Keep stdout clean for the JSON
+    std::ostream &log = bench.headless ? std::cerr : std::cout;
+    log << "Raytrace start" << std::endl;
+
+    const std::string filepath = positional[0];
+    float scale = (positional.size() > 1) ? std::stof(positional[1]) : 0.01;
+    // A non-negative weld tolerance traces the shared-vertex form of the mesh
+    float weld_tolerance = (positional.size() > 2) ? std::stof(positional[2]) : -1.0f;
+
+    std::vector<std::pair<std::string, std::string>> info = {{"mesh", json_string(filepath)}};
+
+    if (ends_with(filepath, ".wbvh"))
+    {
+        // Prebuilt out-of-core tree, paged in on demand. Scale is baked in at build time.
+        OutOfCoreBVH::PagedTree bvh(filepath);
+        if (bench.headless)
+        {
+            Vector4 lower, upper;
+            bvh.bounds(&lower, &upper);
+            info.push_back({"triangles", std::to_string(bvh.num_triangles())});
+            benchmark(bvh, lower, upper, bench, info);
+            return 0;
+        }
+        bvh.print_stats();
+        run([&](auto &&f, float = 0.0f, Vector4 = Vector4(0.0f)) { f(bvh); return static_cast<const void *>(&bvh); },
+            [] { return std::string("Paged tree"); });
+        return 0;
+    }
+
+    // Load and build in the background, the window opens right away and
+    // renders a coarse tree until the full one is ready
+    LoadPipeline::Options options;
+    options.weld_tolerance = weld_tolerance;
+    options.lod_levels = lod_levels;
+    if (lod_levels > 0)
+        options.lod_cache = filepath + ".lod";
+    const std::string path = filepath;
+    LoadPipeline pipeline([path, scale, weld_tolerance](const std::atomic<bool> &)
+    {
+        LoadPipeline::Mesh mesh;
+        // .ply, .obj and .wmsh files keep their own vertex sharing
+        if (weld_tolerance >= 0.0f && !ends_with(path, ".stl") && !ends_with(path, ".tri"))
+            mesh.indexed = load_indexed_mesh_from_mesh_file(path, scale, weld_tolerance);
+        else
+            mesh.tris = load_bvh_tris_from_mesh_file(path, scale);
+        return mesh;
+    }, options);
+
+    if (bench.headless)
+    {
+        try
+        {
+            const auto scene = pipeline.wait();
+            for (const auto &timing : pipeline.timings())
+                info.push_back({timing.name + "_seconds", fmt::format("{:.6f}", timing.seconds)});
+            scene->visit([&](const auto &bvh)
+            {
+                info.push_back({"triangles", std::to_string(scene->indexed_tree ? scene->mesh.triangles.size()
+                                                                                : scene->tris.size())});
+                info.push_back({"tree", bvh.report().json()});
+                benchmark(bvh, bvh.root->aabb.lower, bvh.root->aabb.upper, bench, info);
+            });
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    bool reported = false;
+    run([&](auto &&f, float pixels_per_unit = 0.0f, Vector4 eye = Vector4(0.0f))
+        {
+            const auto scene = pipeline.latest();
+            if (!scene)
+                return static_cast<const void *>(nullptr);
+            if (!scene->coarse && !reported)
+            {
+                std::cout << pipeline.status() << std::endl;
+                scene->visit([](const auto &bvh) { bvh.print_stats(); });
+                reported = true;
+            }
+            // Previews trace the coarsest level of detail that is still accurate to a pixel
+            std::size_t level = 0;
+            if (pixels_per_unit > 0.0f && !scene->lods.empty())
+            {
+                const auto &box = scene->lod_trees.front()->root->aabb;
+                const float point[3] = {eye.x, eye.y, eye.z};
+                const float lower[3] = {box.lower.x, box.lower.y, box.lower.z};
+                const float upper[3] = {box.upper.x, box.upper.y, box.upper.z};
+                level = Simplify::select(scene->lods, Simplify::boxDistance(point, lower, upper), pixels_per_unit);
+            }
+            if (level > 0)
+                f(*scene->lod_trees[level - 1]);
+            else
+                scene->visit(f);
+            return static_cast<const void *>(scene.get());
+        },
+        [&] { return pipeline.status(); });
+
+    // Closing the window does not wait for a build nobody will see
+    pipeline.cancel();
+    try
+    {
+        pipeline.wait();
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
 
     return 0;
 }
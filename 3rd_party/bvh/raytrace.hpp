@@ -1,53 +1,66 @@
 #pragma once
 
-#include <cstdio>
 #include <stdexcept>
 #include <string>
 #include <vector>
 
 #include "bvh.hpp"
+#include "IndexMesh.hpp"
+#include "MeshFile.hpp"
+#include "ReadOBJ.hpp"
+#include "ReadPLY.hpp"
 #include "ReadSTL.hpp"
+#include "ReadTri.hpp"
 
-std::vector<BVH::Triangle> bvh_tris_from_tri_file(const char *filepath, float scale)
+// Scale all vertices, one SIMD multiply per vertex
+void scale_bvh_tris(std::vector<BVH::Triangle> &tris, float scale)
 {
-    std::vector<BVH::Triangle> tris;
-    FILE *file = fopen(filepath, "r");
-    if (file == NULL)
+    const Vector4 factor(scale);
+    const long num_tris = tris.size();
+#pragma omp parallel for schedule(static)
+    for (long i = 0; i < num_tris; i++)
     {
-        throw std::runtime_error("Failed to open file");
+        for (auto &vertex : tris[i].vertices)
+        {
+            vertex = vertex * factor;
+        }
     }
-    float a, b, c, d, e, f, g, h, i;
-    while (fscanf(file, "%f %f %f %f %f %f %f %f %f\n",
-                  &a, &b, &c, &d, &e, &f, &g, &h, &i) == 9)
+}
+
+void scale_mesh(BVH::IndexedMesh &mesh, float scale)
+{
+    const long num_vertices = mesh.vertices.size();
+#pragma omp parallel for simd schedule(static)
+    for (long i = 0; i < num_vertices; i++)
     {
-        Vector4 v1(a, b, c);
-        Vector4 v2(d, e, f);
-        Vector4 v3(g, h, i);
-        v1 = v1 * scale;
-        v2 = v2 * scale;
-        v3 = v3 * scale;
-        tris.push_back({v1, v2, v3});
+        for (int j = 0; j < 3; j++)
+        {
+            mesh.vertices[i][j] *= scale;
+        }
     }
-    fclose(file);
+}
+
+std::vector<BVH::Triangle> bvh_tris_from_tri_file(const char *filepath, float scale)
+{
+    std::vector<BVH::Triangle> tris = TriReader::read(filepath, true);
+    scale_bvh_tris(tris, scale);
     return tris;
 }
 
 std::vector<BVH::Triangle> bvh_tris_from_stl_file(const char *filepath, float scale)
 {
     auto [tris, _] = STLReader::read(filepath, true);
-    for (auto& tri : tris) {
-        for (int i = 0; i < 3; i++)
-        {
-            for (int j = 0; j < 3; j++)
-            {
-                tri.vertices[i][j] *= scale;
-            }
-        }
-    }
-
+    scale_bvh_tris(tris, scale);
     return tris;
 }
 
+// Scaling is done on the shared vertices before expanding to triangles
+std::vector<BVH::Triangle> bvh_tris_from_indexed_mesh(BVH::IndexedMesh mesh, float scale)
+{
+    scale_mesh(mesh, scale);
+    return MeshIndexer::expand(mesh);
+}
+
 bool ends_with(const std::string &str, const std::string &suffix)
 {
     if (str.length() < suffix.length())
@@ -68,7 +81,7 @@ bool ends_with(const std::string &str, const std::string &suffix)
     return true;
 }
 
-// Supports .stl and .tri files
+// Supports .stl, .tri, .ply, .obj and .wmsh files
 std::vector<BVH::Triangle> load_bvh_tris_from_mesh_file(const std::string &filepath, float scale)
 {
     if (ends_with(filepath, ".stl"))
@@ -79,8 +92,49 @@ std::vector<BVH::Triangle> load_bvh_tris_from_mesh_file(const std::string &filep
     {
         return bvh_tris_from_tri_file(filepath.c_str(), scale);
     }
+    else if (ends_with(filepath, ".ply"))
+    {
+        return bvh_tris_from_indexed_mesh(PLYReader::read(filepath), scale);
+    }
+    else if (ends_with(filepath, ".obj"))
+    {
+        return bvh_tris_from_indexed_mesh(OBJReader::read(filepath), scale);
+    }
+    else if (ends_with(filepath, ".wmsh"))
+    {
+        auto [tris, _] = MeshFile::readTriangles(filepath);
+        scale_bvh_tris(tris, scale);
+        return tris;
+    }
     else
     {
         throw std::runtime_error("Unrecognized file extension");
     }
 }
+
+// .ply, .obj and .wmsh files keep their own vertex sharing, triangle soups are welded
+BVH::IndexedMesh load_indexed_mesh_from_mesh_file(const std::string &filepath, float scale, float weld_tolerance)
+{
+    BVH::IndexedMesh mesh;
+    if (ends_with(filepath, ".ply"))
+    {
+        mesh = PLYReader::read(filepath);
+        scale_mesh(mesh, scale);
+    }
+    else if (ends_with(filepath, ".obj"))
+    {
+        mesh = OBJReader::read(filepath);
+        scale_mesh(mesh, scale);
+    }
+    else if (ends_with(filepath, ".wmsh"))
+    {
+        mesh = MeshFile::read(filepath);
+        scale_mesh(mesh, scale);
+    }
+    else
+    {
+        mesh = MeshIndexer::weld(load_bvh_tris_from_mesh_file(filepath, scale), weld_tolerance);
+    }
+
+    return mesh;
+}
@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <cassert>
 #include <limits>
+#include <stdexcept>
 #include <vector>
 
 #include "bvh.hpp"
@@ -11,17 +12,23 @@
 namespace BVH
 {
 
-    void AABBTree::subdivide(Node *parent, float aabb_expansion)
+    template <class Primitive>
+    void BasicAABBTree<Primitive>::subdivide(Node *parent, float aabb_expansion)
     {
         auto begin = parent->begin;
         auto end = parent->end;
 
         assert(begin < end);
 
+        if (cancel && cancel->load(std::memory_order_relaxed))
+        {
+            throw std::runtime_error("Tree build cancelled");
+        }
+
         Vector4 &upper = parent->aabb.upper;
         Vector4 &lower = parent->aabb.lower;
 
-        lower = upper = begin->vertices[0];
+        lower = upper = fetch_triangle(*begin, mesh).vertices[0];
 
         // Calculate variance to determine split axis based on axis with the largest variance,
         // this produces more balanced trees and overcomes an issue that happens with meshes that contain
@@ -33,13 +40,14 @@ namespace BVH
         assert(num_tris > 0);
         for (auto it = begin; it != end; ++it)
         {
-            for (auto vertex : it->vertices)
+            const Triangle &tri = fetch_triangle(*it, mesh);
+            for (auto vertex : tri.vertices)
             {
                 upper = upper.max(vertex);
                 lower = lower.min(vertex);
             }
 
-            Vector4 triangle_center = it->calc_centroid();
+            Vector4 triangle_center = tri.calc_centroid();
             mean = mean + triangle_center / num_tris;
             mean_of_squares = mean_of_squares + (triangle_center * triangle_center) / num_tris;
         }
@@ -65,8 +73,8 @@ namespace BVH
 
         float split_pos = mean[split_axis];
 
-        auto middle = std::partition(begin, end, [split_axis, split_pos](const Triangle &t)
-                                     { return t.calc_centroid()[split_axis] < split_pos; });
+        auto middle = std::partition(begin, end, [this, split_axis, split_pos](const Primitive &t)
+                                     { return fetch_triangle(t, mesh).calc_centroid()[split_axis] < split_pos; });
 
         if ((middle == begin) || (middle == end))
         {
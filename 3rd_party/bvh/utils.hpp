@@ -5,7 +5,8 @@
 namespace BVH
 {
 
-    int count_nodes(Node *node)
+    template <class NodeT>
+    int count_nodes(const NodeT *node)
     {
         if (node == nullptr)
             return 0;
@@ -14,7 +15,8 @@ namespace BVH
     }
 
     // https://stackoverflow.com/a/9181223/8094047
-    void free_tree(Node *node)
+    template <class NodeT>
+    void free_tree(NodeT *node)
     {
         if (node == nullptr)
             return;
@@ -25,7 +27,8 @@ namespace BVH
         delete node;
     }
 
-    int count_leaf_triangles(Node *node)
+    template <class NodeT>
+    int count_leaf_triangles(const NodeT *node)
     {
         if (node == nullptr)
         {
@@ -41,7 +44,8 @@ namespace BVH
         }
     }
 
-    int count_leaf_nodes(Node *node)
+    template <class NodeT>
+    int count_leaf_nodes(const NodeT *node)
     {
         if (node == nullptr)
         {
@@ -57,7 +61,7 @@ namespace BVH
         }
     }
 
-    bool is_point_above_plane(const Vector4 &point, const Vector4 &plane_normal, const Vector4 &plane_point)
+    inline bool is_point_above_plane(const Vector4 &point, const Vector4 &plane_normal, const Vector4 &plane_point)
     {
         return plane_normal.dot3(point - plane_point) > 0;
     }
@@ -0,0 +1,42 @@
+#include "OutOfCoreBVH.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <input.[stl|tri]> <output.wbvh> [-m memory MB] [-s scale] [-t temp dir]"
+                  << std::endl;
+        std::cerr << "  -m  memory budget for subtree builds in MB (default 1024)" << std::endl;
+        std::cerr << "  -s  scale applied to the vertices (default 1)" << std::endl;
+        std::cerr << "  -t  directory for temporary spill files" << std::endl;
+        return 1;
+    }
+
+    OutOfCoreBVH::BuildOptions options;
+    for (int i = 3; i < argc; ++i) {
+        if (!strcmp(argv[i], "-m") && i + 1 < argc)
+            options.memory_budget = std::stoull(argv[++i]) << 20;
+        else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+            options.scale = std::stof(argv[++i]);
+        else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+            options.temp_dir = argv[++i];
+        else {
+            std::cerr << "Unknown option " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    auto t1 = std::chrono::steady_clock::now();
+    OutOfCoreBVH::build(argv[1], argv[2], options);
+    auto t2 = std::chrono::steady_clock::now();
+    std::cout << "Built " << argv[2] << " in "
+              << std::chrono::duration<double>(t2 - t1).count() << " s" << std::endl;
+
+    OutOfCoreBVH::PagedTree(argv[2]).print_stats();
+    return 0;
+}
@@ -0,0 +1,65 @@
+#include "bvh.hpp"
+#include "MeshFile.hpp"
+#include "raytrace.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <input.[stl|tri|ply|obj|wmsh]> <output.wmsh> [-b 16|21] [-w weld tolerance] [-n]"
+                  << std::endl;
+        std::cerr << "  -b  bits per quantized coordinate (default 21)" << std::endl;
+        std::cerr << "  -w  weld tolerance for triangle soups (default 0)" << std::endl;
+        std::cerr << "  -n  store per-triangle normals" << std::endl;
+        return 1;
+    }
+
+    int bits = 21;
+    float weld_tolerance = 0.0f;
+    bool with_normals = false;
+    for (int i = 3; i < argc; ++i) {
+        if (!strcmp(argv[i], "-b") && i + 1 < argc)
+            bits = std::stoi(argv[++i]);
+        else if (!strcmp(argv[i], "-w") && i + 1 < argc)
+            weld_tolerance = std::stof(argv[++i]);
+        else if (!strcmp(argv[i], "-n"))
+            with_normals = true;
+        else {
+            std::cerr << "Unknown option " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    auto t1 = std::chrono::steady_clock::now();
+    const BVH::IndexedMesh mesh = load_indexed_mesh_from_mesh_file(argv[1], 1.0f, weld_tolerance);
+    auto t2 = std::chrono::steady_clock::now();
+    std::cout << "Loaded " << mesh.vertices.size() << " vertices and "
+              << mesh.triangles.size() << " triangles in "
+              << std::chrono::duration<double>(t2 - t1).count() << " s" << std::endl;
+
+    std::vector<std::array<float,3>> normals;
+    if (with_normals) {
+        normals.resize(mesh.triangles.size());
+        const long nt = mesh.triangles.size();
+#pragma omp parallel for
+        for (long i = 0; i < nt; ++i) {
+            const BVH::Triangle tri = mesh.triangle(mesh.triangles[i]);
+            const Vector4 n = (tri.vertices[1] - tri.vertices[0]).cross3(tri.vertices[2] - tri.vertices[0]);
+            const float len = n.length3();
+            normals[i] = len > 0.0f ? std::array{n.x / len, n.y / len, n.z / len}
+                                    : std::array{0.0f, 0.0f, 0.0f};
+        }
+    }
+
+    MeshFile::write(argv[2], mesh, normals, bits);
+    auto t3 = std::chrono::steady_clock::now();
+    std::cout << "Wrote " << argv[2] << " in "
+              << std::chrono::duration<double>(t3 - t2).count() << " s" << std::endl;
+
+    return 0;
+}
@@ -1,7 +1,15 @@
 #include "bvh.hpp"
+#include "Culling.hpp"
+#include "FrameProfile.hpp"
+#include "IndexMesh.hpp"
+#include "LoadPipeline.hpp"
+#include "MeshFile.hpp"
+#include "Picking.hpp"
 #include "ReadSTL.hpp"
+#include "Simplify.hpp"
 
 #include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
 #define GL_GLEXT_PROTOTYPES
 #include <SDL2/SDL_opengl.h>
 #include <SDL2/SDL_opengl_glext.h>
@@ -10,20 +18,40 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 static constexpr int WINDOW_WIDTH = 1600;
 static constexpr int WINDOW_HEIGHT = 900;
 constexpr float ROTATION_SPEED = .1;
 constexpr float MOVEMENT_SPEED = 10;
+// Deepest tree level selectable with the number keys
+constexpr int MAX_LEVEL = 9;
+// Triangles of the largest node drawn without culling its children
+constexpr std::size_t CHUNK_TRIANGLES = 4096;
+// GPU timer results are read this many frames late, so reading never stalls
+constexpr int QUERY_FRAMES = 3;
+// Width of the profiler overlay bar for a 60 Hz frame, in normalized device coordinates
+constexpr float OVERLAY_BUDGET_MS = 1000.0f / 60.0f;
+constexpr float OVERLAY_BUDGET_WIDTH = 0.5f;
 
 using namespace std::string_literals;
 
+// Instanced tree boxes: a unit cube stretched between the corners of each box
 const std::string vShader =
 R"(#version 330 core
 layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aLower;
+layout (location = 2) in vec3 aUpper;
 
 uniform mat4 projection;
 uniform mat4 view;
@@ -32,7 +60,7 @@ out float a;
 
 void main()
 {
-   gl_Position = projection * view * vec4(aPos, 1.0);
+   gl_Position = projection * view * vec4(mix(aLower, aUpper, aPos), 1.0);
    a = alpha;
 }
 )"s;
@@ -47,6 +75,53 @@ void main()
 }
 )"s;
 
+// Profiler overlay: flat rectangles in normalized device coordinates
+const std::string vShaderOverlay =
+R"(#version 330 core
+layout (location = 0) in vec2 aPos;
+
+void main()
+{
+   gl_Position = vec4(aPos, 0.0, 1.0);
+}
+)"s;
+
+const std::string fShaderOverlay =
+R"(#version 330 core
+uniform vec4 color;
+out vec4 FragColor;
+void main()
+{
+   FragColor = color;
+}
+)"s;
+
+// Profiler overlay text: a textured quad, the position in normalized device
+// coordinates and the texture coordinates in one vec4 per vertex
+const std::string vShaderText =
+R"(#version 330 core
+layout (location = 0) in vec4 aPosTex;
+out vec2 TexCoord;
+
+void main()
+{
+   gl_Position = vec4(aPosTex.xy, 0.0, 1.0);
+   TexCoord = aPosTex.zw;
+}
+)"s;
+
+const std::string fShaderText =
+R"(#version 330 core
+in vec2 TexCoord;
+uniform sampler2D text;
+out vec4 FragColor;
+void main()
+{
+   FragColor = texture(text, TexCoord);
+}
+)"s;
+
+// Model positions may be quantized, and y and z are swapped to make z up
 const std::string vShaderM =
 R"(#version 330 core
 layout (location = 0) in vec3 aPos;
@@ -54,15 +129,18 @@ layout (location = 1) in vec3 aNormal;
 
 uniform mat4 projection;
 uniform mat4 view;
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
 
 out vec3 Normal;
 out vec3 FragPos;
 
 void main()
 {
-    gl_Position = projection * view * vec4(aPos, 1.0);
-    Normal = vec3(view * vec4(aNormal, 1.0));
-    FragPos = aPos;
+    vec3 pos = (positionOffset + positionScale * aPos).xzy;
+    gl_Position = projection * view * vec4(pos, 1.0);
+    Normal = vec3(view * vec4(aNormal.xzy, 1.0));
+    FragPos = pos;
 }
 )"s;
 
@@ -93,11 +171,70 @@ void main()
 }
 )"s;
 
+// Shared-vertex model: positions only, flat normals from screen-space derivatives
+const std::string vShaderI =
+R"(#version 330 core
+layout (location = 0) in vec3 aPos;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
+out vec3 FragPos;
+
+void main()
+{
+    vec3 pos = (positionOffset + positionScale * aPos).xzy;
+    gl_Position = projection * view * vec4(pos, 1.0);
+    FragPos = pos;
+}
+)"s;
+
+const std::string fShaderI =
+R"(#version 330 core
+in vec3 FragPos;
+out vec4 FragColor;
+
+uniform vec3 lightPos;
+uniform vec3 lightColor;
+uniform vec3 objectColor;
+
+void main()
+{
+   // ambient
+   float ambientStrength = 0.1;
+   vec3 ambient = ambientStrength * lightColor;
+
+   // diffuse
+   vec3 norm = normalize(cross(dFdx(FragPos), dFdy(FragPos)));
+   vec3 lightDir = normalize(lightPos - FragPos);
+   float diff = abs(dot(norm, lightDir));
+   vec3 diffuse = diff * lightColor;
+
+   vec3 result = (ambient + diffuse) * objectColor;
+   FragColor = vec4(result, 1.0);
+}
+)"s;
+
 namespace {
 
+// Layout of the commands read by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand
+{
+    std::uint32_t count;
+    std::uint32_t instanceCount;
+    std::uint32_t firstIndex;
+    std::int32_t baseVertex;
+    std::uint32_t baseInstance;
+};
+
+// Reads .stl or .wmsh files. Stored normals are dropped, the model is drawn
+// with normals computed from the geometry.
 auto bvh_tris_from_stl_file(std::string_view filepath, float scale)
 {
-    auto [tris, normals] = STLReader::read(filepath, true);
+    auto tris = std::get<0>(filepath.ends_with(".wmsh") ? MeshFile::readTriangles(filepath)
+                                                        : STLReader::read(filepath, true));
     for (auto& tri : tris) {
         for (int i = 0; i < 3; i++)
         {
@@ -108,7 +245,7 @@ auto bvh_tris_from_stl_file(std::string_view filepath, float scale)
         }
     }
 
-    return std::make_tuple(tris, normals);
+    return tris;
 }
 }
 
@@ -155,129 +292,123 @@ unsigned int makeProgram(std::string_view vShader, std::string_view fShader)
     return spId;
 }
 
-void addAABB_lines(std::vector<float>& vertices, const BVH::Node* node,
-                   int depth, int part)
+// Edges and faces of the unit cube, drawn once per box
+const float unitCubeLines[] = {
+    0, 0, 0,  1, 0, 0,   1, 0, 0,  1, 0, 1,   1, 0, 1,  0, 0, 1,   0, 0, 1,  0, 0, 0,
+    0, 0, 0,  0, 1, 0,   1, 0, 0,  1, 1, 0,   1, 0, 1,  1, 1, 1,   0, 0, 1,  0, 1, 1,
+    0, 1, 0,  1, 1, 0,   1, 1, 0,  1, 1, 1,   1, 1, 1,  0, 1, 1,   0, 1, 1,  0, 1, 0,
+};
+
+// Segment from the lower to the upper corner, for the measured distance
+const float unitDiagonal[] = {0, 0, 0, 1, 1, 1};
+
+const float unitCubeFaces[] = {
+    0, 0, 0,  1, 0, 0,  1, 1, 0,   0, 0, 0,  1, 1, 0,  0, 1, 0,
+    0, 0, 1,  1, 0, 1,  1, 1, 1,   0, 0, 1,  1, 1, 1,  0, 1, 1,
+    0, 0, 1,  0, 1, 1,  0, 1, 0,   0, 0, 1,  0, 0, 0,  0, 1, 0,
+    1, 0, 0,  1, 1, 0,  1, 1, 1,   1, 0, 0,  1, 0, 1,  1, 1, 1,
+    0, 0, 0,  1, 0, 0,  1, 0, 1,   0, 0, 0,  0, 0, 1,  1, 0, 1,
+    0, 1, 0,  1, 1, 0,  1, 1, 1,   0, 1, 0,  0, 1, 1,  1, 1, 1,
+};
+
+// Boxes of the tree nodes down to MAX_LEVEL in breadth first order, as lower
+// and upper corners with y and z swapped like the model. Within a level the
+// boxes under the left child of the root come before those under the right.
+struct BoxLevels
 {
-    if (depth > 0) {
-        if ((part == 0 || part == 1) && node->left)
-            addAABB_lines(vertices, node->left, depth-1, 0);
-        if ((part == 0 || part == 2) && node->right)
-            addAABB_lines(vertices, node->right, depth-1, 0);
-        return;
-    }
+    std::vector<float> corners;       // 6 floats per box
+    std::vector<std::size_t> begin;   // first box of each level, then the total
+    std::vector<std::size_t> split;   // first box of each level under the right child
 
-    const auto& x1 = node->aabb.lower.x;
-    const auto& y1 = node->aabb.lower.z;
-    const auto& z1 = node->aabb.lower.y;
-    const auto& x2 = node->aabb.upper.x;
-    const auto& y2 = node->aabb.upper.z;
-    const auto& z2 = node->aabb.upper.y;
-
-    auto addLine = [&vertices](const glm::vec3& v1,
-                               const glm::vec3& v2)
+    // First box and number of boxes shown for a level and part, 0 both sides,
+    // 1 left and 2 right
+    std::pair<std::size_t, std::size_t> range(int level, int part) const
     {
-      vertices.push_back(v1.x);
-      vertices.push_back(v1.y);
-      vertices.push_back(v1.z);
-      vertices.push_back(v2.x);
-      vertices.push_back(v2.y);
-      vertices.push_back(v2.z);
-    };
-
-    addLine({x1, y1, z1}, {x2, y1, z1});
-    addLine({x2, y1, z1}, {x2, y1, z2});
-    addLine({x2, y1, z2}, {x1, y1, z2});
-    addLine({x1, y1, z2}, {x1, y1, z1});
-    addLine({x1, y1, z1}, {x1, y2, z1});
-    addLine({x2, y1, z1}, {x2, y2, z1});
-    addLine({x2, y1, z2}, {x2, y2, z2});
-    addLine({x1, y1, z2}, {x1, y2, z2});
-    addLine({x1, y2, z1}, {x2, y2, z1});
-    addLine({x2, y2, z1}, {x2, y2, z2});
-    addLine({x2, y2, z2}, {x1, y2, z2});
-    addLine({x1, y2, z2}, {x1, y2, z1});
-}
-
-void addAABB_tri(std::vector<float>& vertices, const BVH::Node* node,
-                 int depth, int part)
-{
-    if (depth > 0) {
-        if ((part == 0 || part == 1) && node->left)
-            addAABB_tri(vertices, node->left, depth-1, 0);
-        if ((part == 0 || part == 2) && node->right)
-            addAABB_tri(vertices, node->right, depth-1, 0);
-        return;
+        if (level + 1 >= int(begin.size()))
+            return {0, 0};
+        std::size_t first = begin[level], last = begin[level + 1];
+        if (level > 0 && part == 1)
+            last = split[level];
+        else if (level > 0 && part == 2)
+            first = split[level];
+        return {first, last - first};
     }
+};
 
-    const auto& x1 = node->aabb.lower.x;
-    const auto& y1 = node->aabb.lower.z;
-    const auto& z1 = node->aabb.lower.y;
-    const auto& x2 = node->aabb.upper.x;
-    const auto& y2 = node->aabb.upper.z;
-    const auto& z2 = node->aabb.upper.y;
-
-    auto addTri = [&vertices](const glm::vec3& v1,
-                              const glm::vec3& v2,
-                              const glm::vec3& v3)
-    {
-      vertices.push_back(v1.x);
-      vertices.push_back(v1.y);
-      vertices.push_back(v1.z);
-      vertices.push_back(v2.x);
-      vertices.push_back(v2.y);
-      vertices.push_back(v2.z);
-      vertices.push_back(v3.x);
-      vertices.push_back(v3.y);
-      vertices.push_back(v3.z);
-    };
-
-    addTri({x1, y1, z1}, {x2, y1, z1}, {x2, y2, z1});
-    addTri({x1, y1, z1}, {x2, y2, z1}, {x1, y2, z1});
-
-    addTri({x1, y1, z2}, {x2, y1, z2}, {x2, y2, z2});
-    addTri({x1, y1, z2}, {x2, y2, z2}, {x1, y2, z2});
-
-    addTri({x1, y1, z2}, {x1, y2, z2}, {x1, y2, z1});
-    addTri({x1, y1, z2}, {x1, y1, z1}, {x1, y2, z1});
-
-    addTri({x2, y1, z1}, {x2, y2, z1}, {x2, y2, z2});
-    addTri({x2, y1, z1}, {x2, y1, z2}, {x2, y2, z2});
-
-    addTri({x1, y1, z1}, {x2, y1, z1}, {x2, y1, z2});
-    addTri({x1, y1, z1}, {x1, y1, z2}, {x2, y1, z2});
-
-    addTri({x1, y2, z1}, {x2, y2, z1}, {x2, y2, z2});
-    addTri({x1, y2, z1}, {x1, y2, z2}, {x2, y2, z2});
-}
-
-void addModel(std::vector<float>& vertices, const std::vector<BVH::Triangle>& tris,
-              const std::vector<std::array<float,3>>& normals)
+template<class Node>
+BoxLevels collectBoxes(const Node* root)
 {
-    vertices.reserve(tris.size() * 3 * 6);
-    auto it = normals.begin();
-    for (const auto& tri : tris) {
-        const auto& n = *it;
-        for (const auto& v : tri.vertices) {
-          vertices.push_back(v.x);
-          vertices.push_back(v.z);
-          vertices.push_back(v.y);
-          vertices.push_back(n[0]);
-          vertices.push_back(n[2]);
-          vertices.push_back(n[1]);
+    BoxLevels levels;
+    // Nodes of the current level and the child of the root they are under
+    std::vector<std::pair<const Node*, int>> current, next;
+    if (root)
+        current.push_back({root, 0});
+    for (int level = 0; level <= MAX_LEVEL && !current.empty(); ++level) {
+        levels.begin.push_back(levels.corners.size() / 6);
+        levels.split.push_back(levels.begin.back());
+        next.clear();
+        for (const auto& [node, side] : current) {
+            const auto& lower = node->aabb.lower;
+            const auto& upper = node->aabb.upper;
+            levels.corners.insert(levels.corners.end(),
+                                  {lower.x, lower.z, lower.y, upper.x, upper.z, upper.y});
+            if (side == 1)
+                ++levels.split.back();
+            if (node->left)
+                next.push_back({node->left, side == 0 ? 1 : side});
+            if (node->right)
+                next.push_back({node->right, side == 0 ? 2 : side});
         }
-        ++it;
+        std::swap(current, next);
     }
+    levels.begin.push_back(levels.corners.size() / 6);
+    return levels;
 }
 
 int main(int argc, char** argv)
 {
-    if (argc < 2) {
-        std::cerr << "Need one parameter, .stl file to load" << std::endl;
+    std::vector<std::string> args;
+    bool quantize = false;
+    int lod_levels = 0;
+    std::string profile_path;
+    std::string font_path = "c:/Windows/Fonts/calibrib.ttf";
+    for (int i = 1; i < argc; ++i) {
+        if (argv[i] == "--quantize"s)
+            quantize = true;
+        else if (argv[i] == "--lod"s && i + 1 < argc)
+            lod_levels = std::stoi(argv[++i]);
+        else if (argv[i] == "--profile"s && i + 1 < argc)
+            profile_path = argv[++i];
+        else if (argv[i] == "--font"s && i + 1 < argc)
+            font_path = argv[++i];
+        else
+            args.push_back(argv[i]);
+    }
+    if (args.empty()) {
+        std::cerr << "Need one parameter, .stl or .wmsh file to load" << std::endl;
+        std::cerr << "Optional second parameter, weld tolerance for an indexed tree" << std::endl;
+        std::cerr << "Option --quantize, store the model positions as 16 bit integers" << std::endl;
+        std::cerr << "Option --lod N, draw up to N simplified levels of detail, cached next to the file" << std::endl;
+        std::cerr << "Option --profile file.csv, write the frame profile of every frame" << std::endl;
+        std::cerr << "Option --font file.ttf, font of the profiler overlay text" << std::endl;
+        return 1;
     }
-    auto [tris, normals] = bvh_tris_from_stl_file(argv[1], 1.0);
-    std::cout << "Loaded " << tris.size() << " triangles from " << argv[1] << std::endl;
-    BVH::AABBTree bvh(tris, 0.001f);
-    bvh.print_stats();
+    // Load and build in the background so the window opens right away. A
+    // coarse tree over a subsample of the triangles is shown until the full
+    // tree is ready. With a weld tolerance both the tree and the uploaded
+    // model use the indexed form.
+    LoadPipeline::Options options;
+    if (args.size() > 1)
+        options.weld_tolerance = std::stof(args[1]);
+    const std::string path = args[0];
+    options.lod_levels = lod_levels;
+    if (lod_levels > 0)
+        options.lod_cache = path + ".lod";
+    LoadPipeline pipeline([path](const std::atomic<bool>&)
+    {
+        return LoadPipeline::Mesh{bvh_tris_from_stl_file(path, 1.0), {}, {}};
+    }, options);
+    std::shared_ptr<const LoadPipeline::Scene> scene;
 
     SDL_Init(SDL_INIT_VIDEO);
     SDL_GL_LoadLibrary(nullptr);
@@ -301,42 +432,127 @@ int main(int argc, char** argv)
 
     unsigned int spId = makeProgram(vShader, fShader);
     unsigned int spIdM = makeProgram(vShaderM, fShaderM);
-
-    std::vector<float> verticesL;
-    std::vector<float> verticesV;
-    std::vector<float> verticesM;
-    addAABB_lines(verticesL, bvh.root, 0, false);
-    addAABB_tri(verticesV, bvh.root, 0, false);
-    addModel(verticesM, tris, normals);
-
-    unsigned int VBO[3], VAO[3];
-    glGenVertexArrays(3, VAO);
-    glGenBuffers(3, VBO);
+    unsigned int spIdMI = makeProgram(vShaderI, fShaderI);
+    unsigned int spIdO = makeProgram(vShaderOverlay, fShaderOverlay);
+    unsigned int spIdT = makeProgram(vShaderText, fShaderText);
+
+    // CPU sections are timed directly, GPU passes with timer queries. Each
+    // frame's queries and CPU times wait in a slot until the results are read.
+    enum Section { EVENTS, REBUILD, MODEL, LINES, BOXES, NUM_SECTIONS };
+    FrameProfile profile({"events", "rebuild", "model", "lines", "boxes"});
+    if (!profile_path.empty())
+        profile.trace(profile_path);
+    const std::array<std::array<float,4>,NUM_SECTIONS> sectionColors = {{
+        {0.6f, 0.6f, 0.6f, 0.8f}, {0.9f, 0.8f, 0.2f, 0.8f}, {0.2f, 0.8f, 0.3f, 0.8f},
+        {0.3f, 0.5f, 1.0f, 0.8f}, {0.9f, 0.3f, 0.3f, 0.8f}}};
+    std::cout << "Profiler overlay (P): events grey, rebuild yellow, model green, lines blue, boxes red" << std::endl;
+    struct ProfileSlot
+    {
+        bool pending = false;
+        std::array<double,NUM_SECTIONS> cpu{};
+        std::array<bool,NUM_SECTIONS> queried{};
+        std::array<unsigned int,NUM_SECTIONS> queries{};
+    };
+    std::array<ProfileSlot,QUERY_FRAMES> slots;
+    for (auto& slot : slots)
+        glGenQueries(NUM_SECTIONS, slot.queries.data());
+    std::uint64_t frameIndex = 0;
+
+    // The section averages are written above the bar, rendered with SDL_ttf
+    // into a texture whenever they are updated
+    TTF_Init();
+    TTF_Font* font = TTF_OpenFont(font_path.c_str(), 16);
+    if (!font)
+        std::cerr << "Could not open font " << font_path << ", the profiler overlay has no text" << std::endl;
+    unsigned int textTexture;
+    glGenTextures(1, &textTexture);
+    glBindTexture(GL_TEXTURE_2D, textTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    int textWidth = 0, textHeight = 0;
+
+    BoxLevels boxes;
+    std::size_t numIndicesM = 0;
+    // The model triangles are in the order of the tree, so the nodes in view
+    // map to index ranges drawn with one indirect call
+    std::vector<Culling::Range> ranges;
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::size_t drawnTriangles = 0;
+    std::array<float,3> modelOffset{}, modelScale{1.0f, 1.0f, 1.0f};
+    // The levels of detail share one buffer, level i + 1 starting at
+    // lodFirstIndex[i] and lodBaseVertex[i]
+    std::vector<std::uint32_t> lodFirstIndex;
+    std::vector<std::int32_t> lodBaseVertex;
+    std::size_t lodLevel = 0;
+
+    unsigned int VBO[8], VAO[8], EBO, lodEBO, boxVBO, normalVBO, indirectBuffer;
+    glGenVertexArrays(8, VAO);
+    glGenBuffers(8, VBO);
+    glGenBuffers(1, &EBO);
+    glGenBuffers(1, &lodEBO);
+    glGenBuffers(1, &boxVBO);
+    glGenBuffers(1, &normalVBO);
+    glGenBuffers(1, &indirectBuffer);
 
     // bind the Vertex Array Object first, then bind and set vertex buffer(s), and then configure vertex attributes(s).
+    // The box outlines and faces are unit cubes instanced with the box corners
+    // as per instance attributes.
     glBindVertexArray(VAO[0]);
     glBindBuffer(GL_ARRAY_BUFFER, VBO[0]);
-    glBufferData(GL_ARRAY_BUFFER, verticesL.size()*sizeof(float),
-                 verticesL.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(unitCubeLines), unitCubeLines, GL_STATIC_DRAW);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
 
     glBindVertexArray(VAO[1]);
     glBindBuffer(GL_ARRAY_BUFFER, VBO[1]);
-    glBufferData(GL_ARRAY_BUFFER, verticesV.size()*sizeof(float),
-                 verticesV.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(unitCubeFaces), unitCubeFaces, GL_STATIC_DRAW);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
 
-    glBindVertexArray(VAO[2]);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO[2]);
-    glBufferData(GL_ARRAY_BUFFER, verticesM.size()*sizeof(float),
-                 verticesM.data(), GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6*sizeof(float), (void*)0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6*sizeof(float), (void*)(3*sizeof(float)));
+    for (unsigned int vao : {VAO[0], VAO[1]}) {
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, boxVBO);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6*sizeof(float), (void*)0);
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 6*sizeof(float), (void*)(3*sizeof(float)));
+        glVertexAttribDivisor(1, 1);
+        glVertexAttribDivisor(2, 1);
+        glEnableVertexArrayAttrib(vao, 1);
+        glEnableVertexArrayAttrib(vao, 2);
+    }
 
     glEnableVertexArrayAttrib(VAO[0], 0);
     glEnableVertexArrayAttrib(VAO[1], 0);
     glEnableVertexArrayAttrib(VAO[2], 0);
-    glEnableVertexArrayAttrib(VAO[2], 1);
+    glEnableVertexArrayAttrib(VAO[3], 0);
+
+    glBindVertexArray(VAO[4]);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO[4]);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    glEnableVertexArrayAttrib(VAO[4], 0);
+
+    // Picked points are small cubes and the measured distance a line, drawn
+    // like the boxes with their corners in VBO[5]
+    glBindVertexArray(VAO[5]);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO[1]);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    glBindVertexArray(VAO[6]);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO[6]);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(unitDiagonal), unitDiagonal, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    for (unsigned int vao : {VAO[5], VAO[6]}) {
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO[5]);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6*sizeof(float), (void*)0);
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 6*sizeof(float), (void*)(3*sizeof(float)));
+        glVertexAttribDivisor(1, 1);
+        glVertexAttribDivisor(2, 1);
+        glEnableVertexArrayAttrib(vao, 0);
+        glEnableVertexArrayAttrib(vao, 1);
+        glEnableVertexArrayAttrib(vao, 2);
+    }
+
+    glBindVertexArray(VAO[7]);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO[7]);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    glEnableVertexArrayAttrib(VAO[7], 0);
 
     // note that this is allowed, the call to glVertexAttribPointer registered VBO as the vertex attribute's bound vertex buffer object so afterwards we can safely unbind
     glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -353,16 +569,23 @@ int main(int argc, char** argv)
     glm::mat4 projection = glm::perspective(glm::radians(45.f),
                                             float(WINDOW_WIDTH) / float(WINDOW_HEIGHT),
                                             0.1f, 100000.f);
+    // Pixels covered by a unit length at unit distance, for picking the level of detail
+    const float pixelsPerUnit = WINDOW_HEIGHT / (2.0f * std::tan(glm::radians(22.5f)));
+    // Model coordinates have z up, the view has y up
+    const glm::mat4 swapYZ(glm::vec4(1, 0, 0, 0), glm::vec4(0, 0, 1, 0),
+                           glm::vec4(0, 1, 0, 0), glm::vec4(0, 0, 0, 1));
 
     glUseProgram(spId);
     glUniformMatrix4fv(glGetUniformLocation(spId, "projection"), 1, GL_FALSE,
                        glm::value_ptr(projection));
-    glUseProgram(spIdM);
-    glUniformMatrix4fv(glGetUniformLocation(spIdM, "projection"), 1, GL_FALSE,
-                       glm::value_ptr(projection));
-    glUniform3f(glGetUniformLocation(spIdM, "lightPos"), 0.f, 15.f, -1.f);
-    glUniform3f(glGetUniformLocation(spIdM, "lightColor"), 0.675f, 0.512, 0.09f);
-    glUniform3f(glGetUniformLocation(spIdM, "objectColor"), 1.f, 1.f, 1.f);
+    for (unsigned int id : {spIdM, spIdMI}) {
+        glUseProgram(id);
+        glUniformMatrix4fv(glGetUniformLocation(id, "projection"), 1, GL_FALSE,
+                           glm::value_ptr(projection));
+        glUniform3f(glGetUniformLocation(id, "lightPos"), 0.f, 15.f, -1.f);
+        glUniform3f(glGetUniformLocation(id, "lightColor"), 0.675f, 0.512, 0.09f);
+        glUniform3f(glGetUniformLocation(id, "objectColor"), 1.f, 1.f, 1.f);
+    }
 
     SDL_Event event;
     bool is_running = true;
@@ -376,7 +599,228 @@ int main(int argc, char** argv)
     bool tri = false;
     bool relative = true;
     bool model = true;
+    bool cull = true;
+    bool lod = true;
+    bool overlay = true;
+    bool indexed = false;
+    std::string title;
+
+    // All levels are uploaded once per scene, selecting a level or part only
+    // changes the range of instances drawn
+    auto uploadBoxes = [&]()
+    {
+        scene->visit([&](const auto& tree) { boxes = collectBoxes(tree.root); });
+        glBindBuffer(GL_ARRAY_BUFFER, boxVBO);
+        glBufferData(GL_ARRAY_BUFFER, boxes.corners.size()*sizeof(float),
+                     boxes.corners.data(), GL_STATIC_DRAW);
+    };
+
+    // Called on the render thread whenever the pipeline publishes a scene.
+    // The model is drawn as a shared-vertex mesh: soups with packed face
+    // normals, welded meshes without normals, shaded from screen-space
+    // derivatives instead.
+    auto uploadScene = [&]()
+    {
+        const MeshIndexer::PackedMesh packed = scene->indexed_tree
+            ? MeshIndexer::pack(scene->mesh, quantize)
+            : MeshIndexer::pack(scene->tris, quantize);
+        indexed = packed.normals.empty();
+        numIndicesM = packed.indices.size();
+        update_view = true;
+        if (!scene->coarse)
+            std::cout << "Model: " << packed.numVertices() << " vertices, "
+                      << packed.bytes() / (1024.0 * 1024.0) << " MB" << std::endl;
+
+        glBindVertexArray(VAO[2]);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO[2]);
+        if (quantize) {
+            glBufferData(GL_ARRAY_BUFFER, packed.quantized.size()*sizeof(std::uint16_t),
+                         packed.quantized.data(), GL_STATIC_DRAW);
+            glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_FALSE, 4*sizeof(std::uint16_t), (void*)0);
+        } else {
+            glBufferData(GL_ARRAY_BUFFER, packed.positions.size()*sizeof(float),
+                         packed.positions.data(), GL_STATIC_DRAW);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3*sizeof(float), (void*)0);
+        }
+        if (indexed) {
+            glDisableVertexArrayAttrib(VAO[2], 1);
+        } else {
+            glBindBuffer(GL_ARRAY_BUFFER, normalVBO);
+            glBufferData(GL_ARRAY_BUFFER, packed.normals.size()*sizeof(std::uint32_t),
+                         packed.normals.data(), GL_STATIC_DRAW);
+            glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, 0, (void*)0);
+            glEnableVertexArrayAttrib(VAO[2], 1);
+        }
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, packed.indices.size()*sizeof(std::uint32_t),
+                     packed.indices.data(), GL_STATIC_DRAW);
+        glBindVertexArray(0);
+
+        modelOffset = packed.offset;
+        modelScale = packed.scale;
+        glUseProgram(spIdM);
+        glUniform3fv(glGetUniformLocation(spIdM, "positionOffset"), 1, modelOffset.data());
+        glUniform3fv(glGetUniformLocation(spIdM, "positionScale"), 1, modelScale.data());
+
+        // The levels of detail are drawn like welded meshes, unquantized
+        lodFirstIndex.clear();
+        lodBaseVertex.clear();
+        std::vector<float> lodPositions;
+        std::vector<std::uint32_t> lodIndices;
+        for (const auto& level : scene->lods) {
+            const MeshIndexer::PackedMesh packedLevel = MeshIndexer::pack(level.mesh, false);
+            lodFirstIndex.push_back(lodIndices.size());
+            lodBaseVertex.push_back(lodPositions.size() / 3);
+            lodPositions.insert(lodPositions.end(), packedLevel.positions.begin(), packedLevel.positions.end());
+            lodIndices.insert(lodIndices.end(), packedLevel.indices.begin(), packedLevel.indices.end());
+        }
+        if (!scene->lods.empty()) {
+            glBindVertexArray(VAO[3]);
+            glBindBuffer(GL_ARRAY_BUFFER, VBO[3]);
+            glBufferData(GL_ARRAY_BUFFER, lodPositions.size()*sizeof(float),
+                         lodPositions.data(), GL_STATIC_DRAW);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3*sizeof(float), (void*)0);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lodEBO);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, lodIndices.size()*sizeof(std::uint32_t),
+                         lodIndices.data(), GL_STATIC_DRAW);
+            glBindVertexArray(0);
+        }
+
+        uploadBoxes();
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    };
+
+    using Clock = std::chrono::steady_clock;
+    auto milliseconds = [](Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    };
+
+    // Picked points in model coordinates, the last one's triangle is highlighted
+    std::vector<Picking::Hit> picks;
+    std::string pickText;
+    auto uploadPicks = [&]()
+    {
+        if (picks.empty())
+            return;
+        // Marker cubes sized to the model, then the segment between the last two picks
+        float size = 0.0f;
+        scene->visit([&](const auto& tree)
+        {
+            size = 0.005f * (tree.root->aabb.upper - tree.root->aabb.lower).length3();
+        });
+        std::vector<float> corners;
+        for (const auto& pick : picks) {
+            const Vector4& p = pick.point;
+            corners.insert(corners.end(), {p.x - size, p.z - size, p.y - size, p.x + size, p.z + size, p.y + size});
+        }
+        if (picks.size() > 1) {
+            const Vector4& p0 = picks[picks.size() - 2].point;
+            const Vector4& p1 = picks.back().point;
+            corners.insert(corners.end(), {p0.x, p0.z, p0.y, p1.x, p1.z, p1.y});
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, VBO[5]);
+        glBufferData(GL_ARRAY_BUFFER, corners.size()*sizeof(float), corners.data(), GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    };
+
+    // Trace a ray through a window pixel in model coordinates
+    auto pickAt = [&](int px, int py)
+    {
+        const auto start = Clock::now();
+        const glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
+        const glm::mat4 inverse = glm::inverse(projection * view * swapYZ);
+        float x, y;
+        Picking::windowToDevice(px, py, WINDOW_WIDTH, WINDOW_HEIGHT, &x, &y);
+        const Picking::Ray ray = Picking::unproject(glm::value_ptr(inverse), x, y);
+        const auto hit = scene->visit([&](const auto& tree) { return Picking::pick(tree, ray); });
+        const double ms = milliseconds(start);
+        if (!hit) {
+            std::cout << "Pick: nothing hit, " << ms << " ms" << std::endl;
+            return;
+        }
+        picks.push_back(*hit);
+        const Vector4& p = hit->point;
+        pickText = "picked (" + std::to_string(p.x) + ", " + std::to_string(p.y) + ", " + std::to_string(p.z) +
+                   ") triangle " + std::to_string(hit->primitive);
+        std::cout << "Pick: (" << p.x << ", " << p.y << ", " << p.z << "), triangle " << hit->primitive
+                  << ", " << ms << " ms" << std::endl;
+        if (picks.size() > 1) {
+            const float distance = (p - picks[picks.size() - 2].point).length3();
+            pickText += ", distance " + std::to_string(distance);
+            std::cout << "Distance to previous pick: " << distance << std::endl;
+        }
+        uploadPicks();
+    };
+
     while (is_running) {
+        // Read the timings of the frame that last used this slot
+        ProfileSlot& slot = slots[frameIndex++ % QUERY_FRAMES];
+        if (slot.pending) {
+            std::vector<double> times(slot.cpu.begin(), slot.cpu.end());
+            for (int section = 0; section < NUM_SECTIONS; ++section)
+                if (slot.queried[section]) {
+                    GLuint64 ns = 0;
+                    glGetQueryObjectui64v(slot.queries[section], GL_QUERY_RESULT, &ns);
+                    times[section] = ns * 1e-6;
+                }
+            profile.add(times);
+        }
+        slot.pending = true;
+        slot.cpu.fill(0.0);
+        slot.queried.fill(false);
+        auto timeGPU = [&slot](Section section, auto&& draw) {
+            glBeginQuery(GL_TIME_ELAPSED, slot.queries[section]);
+            draw();
+            glEndQuery(GL_TIME_ELAPSED);
+            slot.queried[section] = true;
+        };
+
+        auto start = Clock::now();
+        if (auto latest = pipeline.latest(); latest != scene) {
+            scene = latest;
+            uploadScene();
+            // Triangle indices refer to the order of the previous tree
+            picks.clear();
+            pickText.clear();
+            if (!scene->coarse) {
+                std::cout << pipeline.status() << std::endl;
+                scene->visit([](const auto& tree) { tree.print_stats(); });
+            }
+        }
+        slot.cpu[REBUILD] += milliseconds(start);
+        if (pipeline.stage() == LoadPipeline::Stage::Failed)
+            break;
+        std::string status = "Render - " + pipeline.status();
+        if (scene)
+            status += " - " + std::to_string(drawnTriangles) + " of " +
+                      std::to_string(numIndicesM / 3) + " triangles drawn";
+        if (lodLevel > 0)
+            status += " - level of detail " + std::to_string(lodLevel);
+        // The averages change every frame, the overlay text only twice a second
+        if (frameIndex % 30 == 1) {
+            const std::string profileText = profile.summary();
+            SDL_Surface* surface = font ? TTF_RenderText_Blended(font, profileText.c_str(), SDL_Color{255, 255, 255, 255})
+                                        : nullptr;
+            if (surface) {
+                // 32-bit ARGB pixels, which are BGRA bytes in memory
+                glBindTexture(GL_TEXTURE_2D, textTexture);
+                glPixelStorei(GL_UNPACK_ROW_LENGTH, surface->pitch / 4);
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, surface->w, surface->h, 0, GL_BGRA, GL_UNSIGNED_BYTE,
+                             surface->pixels);
+                glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+                textWidth = surface->w;
+                textHeight = surface->h;
+                SDL_FreeSurface(surface);
+            }
+        }
+        if (!pickText.empty())
+            status += " - " + pickText;
+        if (status != title) {
+            title = status;
+            SDL_SetWindowTitle(window, title.c_str());
+        }
+
+        start = Clock::now();
         while (SDL_PollEvent(&event) != 0)
         {
             switch (event.type)
@@ -398,9 +842,21 @@ int main(int argc, char** argv)
             case SDL_QUIT:
                 is_running = false;
                 break;
+            // Left click picks under the cursor, or the window center while
+            // the mouse looks around. Right click clears the picks.
+            case SDL_MOUSEBUTTONDOWN:
+                if (scene && event.button.button == SDL_BUTTON_LEFT) {
+                    if (relative)
+                        pickAt(WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2);
+                    else
+                        pickAt(event.button.x, event.button.y);
+                } else if (event.button.button == SDL_BUTTON_RIGHT) {
+                    picks.clear();
+                    pickText.clear();
+                }
+                break;
             case SDL_KEYDOWN:
             {
-                bool update_data = false;
                 float cameraSpeed = 100 * delta / 1000.f;
                 // quit application on ESC
                 if (event.key.keysym.sym == SDLK_ESCAPE)
@@ -428,32 +884,41 @@ int main(int argc, char** argv)
                 else if (event.key.keysym.sym == SDLK_l)
                 {
                     part = 1;
-                    update_data = true;
                 }
                 else if (event.key.keysym.sym == SDLK_r)
                 {
                     part = 2;
-                    update_data = true;
                 }
                 else if (event.key.keysym.sym == SDLK_b)
                 {
                     part = 0;
-                    update_data = true;
                 }
                 else if (event.key.keysym.sym == SDLK_t)
                 {
                     tri = !tri;
-                    update_data = true;
                 }
                 else if (event.key.keysym.sym == SDLK_y)
                 {
                     lines = !lines;
-                    update_data = true;
                 }
                 else if (event.key.keysym.sym == SDLK_m)
                 {
                     model = !model;
                 }
+                else if (event.key.keysym.sym == SDLK_c)
+                {
+                    cull = !cull;
+                    update_view = true;
+                }
+                else if (event.key.keysym.sym == SDLK_o)
+                {
+                    lod = !lod;
+                    update_view = true;
+                }
+                else if (event.key.keysym.sym == SDLK_p)
+                {
+                    overlay = !overlay;
+                }
                 // additional control inputs
                 else if (event.key.keysym.sym == SDLK_g) // release mouse cursor on G
                 {
@@ -463,20 +928,6 @@ int main(int argc, char** argv)
                 else if (event.key.keysym.sym >= SDLK_0 && event.key.keysym.sym <= SDLK_9)
                 {
                     level = event.key.keysym.sym - SDLK_0;
-                    update_data = true;
-                }
-                if (update_data)
-                {
-                    verticesL.clear();
-                    verticesV.clear();
-                    addAABB_lines(verticesL, bvh.root, level, part);
-                    glBindBuffer(GL_ARRAY_BUFFER, VBO[0]);
-                    glBufferData(GL_ARRAY_BUFFER, verticesL.size()*sizeof(float),
-                                 verticesL.data(), GL_STATIC_DRAW);
-                    addAABB_tri(verticesV, bvh.root, level, part);
-                    glBindBuffer(GL_ARRAY_BUFFER, VBO[1]);
-                    glBufferData(GL_ARRAY_BUFFER, verticesV.size()*sizeof(float),
-                                 verticesV.data(), GL_STATIC_DRAW);
                 }
                 break;
             }
@@ -485,35 +936,173 @@ int main(int argc, char** argv)
             }
         }
 
+        slot.cpu[EVENTS] = milliseconds(start);
+
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        start = Clock::now();
         if (update_view) {
             glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
             glUseProgram(spId);
             glUniformMatrix4fv(glGetUniformLocation(spId, "view"), 1, GL_FALSE, &view[0][0]);
-            glUseProgram(spIdM);
-            glUniformMatrix4fv(glGetUniformLocation(spIdM, "view"), 1, GL_FALSE, &view[0][0]);
+            for (unsigned int id : {spIdM, spIdMI}) {
+                glUseProgram(id);
+                glUniformMatrix4fv(glGetUniformLocation(id, "view"), 1, GL_FALSE, &view[0][0]);
+            }
+
+            // The coarsest level of detail whose error stays below a pixel
+            // at the distance of the model bounds, in model coordinates
+            // where y and z are not swapped yet
+            lodLevel = 0;
+            if (scene && lod && !scene->lods.empty()) {
+                const float eye[3] = {cameraPos.x, cameraPos.z, cameraPos.y};
+                const auto& box = scene->lod_trees.front()->root->aabb;
+                const float lower[3] = {box.lower.x, box.lower.y, box.lower.z};
+                const float upper[3] = {box.upper.x, box.upper.y, box.upper.z};
+                lodLevel = Simplify::select(scene->lods, Simplify::boxDistance(eye, lower, upper), pixelsPerUnit);
+            }
+
+            // Cull in model coordinates too. The levels of detail are in the
+            // order of their own trees.
+            ranges.clear();
+            if (scene && cull) {
+                const glm::mat4 clip = projection * view * swapYZ;
+                const auto frustum = Culling::Frustum::fromMatrix(glm::value_ptr(clip));
+                if (lodLevel > 0)
+                    Culling::visibleRanges(scene->lod_trees[lodLevel - 1]->root, frustum, CHUNK_TRIANGLES, ranges);
+                else
+                    scene->visit([&](const auto& tree)
+                    {
+                        Culling::visibleRanges(tree.root, frustum, CHUNK_TRIANGLES, ranges);
+                    });
+            } else if (lodLevel > 0) {
+                ranges.push_back({0, std::uint32_t(scene->lods[lodLevel - 1].mesh.triangles.size())});
+            } else if (scene) {
+                ranges.push_back({0, std::uint32_t(numIndicesM / 3)});
+            }
+            commands.clear();
+            drawnTriangles = 0;
+            const std::uint32_t firstIndex = lodLevel > 0 ? lodFirstIndex[lodLevel - 1] : 0;
+            const std::int32_t baseVertex = lodLevel > 0 ? lodBaseVertex[lodLevel - 1] : 0;
+            for (const auto& range : ranges) {
+                commands.push_back({3 * range.count, 1, firstIndex + 3 * range.first, baseVertex, 0});
+                drawnTriangles += range.count;
+            }
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size()*sizeof(DrawElementsIndirectCommand),
+                         commands.data(), GL_STREAM_DRAW);
             update_view = false;
         }
-
-        if (model) {
-            glUseProgram(spIdM);
-            glBindVertexArray(VAO[2]);
-            glDrawArrays(GL_TRIANGLES, 0, verticesM.size() / 6);
+        slot.cpu[REBUILD] += milliseconds(start);
+
+        if (model && scene) {
+            // The welded model and the levels of detail share a program
+            const bool simplified = lodLevel > 0;
+            glUseProgram(indexed || simplified ? spIdMI : spIdM);
+            if (indexed || simplified) {
+                const std::array<float,3> zero{}, one{1.0f, 1.0f, 1.0f};
+                glUniform3fv(glGetUniformLocation(spIdMI, "positionOffset"), 1,
+                             simplified ? zero.data() : modelOffset.data());
+                glUniform3fv(glGetUniformLocation(spIdMI, "positionScale"), 1,
+                             simplified ? one.data() : modelScale.data());
+            }
+            glBindVertexArray(simplified ? VAO[3] : VAO[2]);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+            timeGPU(MODEL, [&] {
+                glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, commands.size(), 0);
+            });
         }
 
-        if (lines) {
+        const auto [firstBox, numBoxes] = boxes.range(level, part);
+        if (lines && numBoxes > 0) {
             glUseProgram(spId);
             glBindVertexArray(VAO[0]);
             glUniform1f(glGetUniformLocation(spId, "alpha"), 1.f);
-            glDrawArrays(GL_LINES, 0, verticesL.size() / 3);
+            timeGPU(LINES, [&] {
+                glDrawArraysInstancedBaseInstance(GL_LINES, 0, 24, numBoxes, firstBox);
+            });
         }
 
-        if (tri) {
+        if (tri && numBoxes > 0) {
             glUseProgram(spId);
             glBindVertexArray(VAO[1]);
             glUniform1f(glGetUniformLocation(spId, "alpha"), 0.5f);
-            glDrawArrays(GL_TRIANGLES, 0, verticesV.size() / 3);
+            timeGPU(BOXES, [&] {
+                glDrawArraysInstancedBaseInstance(GL_TRIANGLES, 0, 36, numBoxes, firstBox);
+            });
+        }
+
+        // The picked triangle is drawn again from the model buffers, and the
+        // markers on top of everything
+        if (!picks.empty()) {
+            glDisable(GL_DEPTH_TEST);
+            const unsigned int program = indexed ? spIdMI : spIdM;
+            glUseProgram(program);
+            glUniform3fv(glGetUniformLocation(program, "positionOffset"), 1, modelOffset.data());
+            glUniform3fv(glGetUniformLocation(program, "positionScale"), 1, modelScale.data());
+            glUniform3f(glGetUniformLocation(program, "objectColor"), 1.f, 0.1f, 0.1f);
+            glBindVertexArray(VAO[2]);
+            glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT,
+                           (void*)(3 * std::size_t(picks.back().primitive) * sizeof(std::uint32_t)));
+            glUniform3f(glGetUniformLocation(program, "objectColor"), 1.f, 1.f, 1.f);
+
+            glUseProgram(spId);
+            glUniform1f(glGetUniformLocation(spId, "alpha"), 1.f);
+            glBindVertexArray(VAO[5]);
+            glDrawArraysInstanced(GL_TRIANGLES, 0, 36, picks.size());
+            if (picks.size() > 1) {
+                glBindVertexArray(VAO[6]);
+                glDrawArraysInstancedBaseInstance(GL_LINES, 0, 2, 1, picks.size());
+            }
+            glEnable(GL_DEPTH_TEST);
+        }
+
+        // The averaged sections as a stacked bar in the bottom left corner,
+        // with a white mark at the 60 Hz budget and their names and times above
+        if (overlay && profile.size() > 0) {
+            std::vector<float> rects;
+            auto addRect = [&rects](float x0, float y0, float x1, float y1) {
+                rects.insert(rects.end(), {x0, y0, x1, y0, x1, y1, x0, y0, x1, y1, x0, y1});
+            };
+            const float x0 = -0.98f, y0 = -0.98f, y1 = -0.94f;
+            float x = x0;
+            for (int section = 0; section < NUM_SECTIONS; ++section) {
+                const float width = profile.average(section) / OVERLAY_BUDGET_MS * OVERLAY_BUDGET_WIDTH;
+                addRect(x, y0, std::min(x + width, 0.98f), y1);
+                x = std::min(x + width, 0.98f);
+            }
+            const float budget = x0 + OVERLAY_BUDGET_WIDTH;
+            addRect(budget - 0.002f, y0 - 0.01f, budget + 0.002f, y1 + 0.01f);
+
+            glDisable(GL_DEPTH_TEST);
+            glUseProgram(spIdO);
+            glBindVertexArray(VAO[4]);
+            glBindBuffer(GL_ARRAY_BUFFER, VBO[4]);
+            glBufferData(GL_ARRAY_BUFFER, rects.size()*sizeof(float), rects.data(), GL_STREAM_DRAW);
+            const int colorLocation = glGetUniformLocation(spIdO, "color");
+            for (int section = 0; section < NUM_SECTIONS; ++section) {
+                glUniform4fv(colorLocation, 1, sectionColors[section].data());
+                glDrawArrays(GL_TRIANGLES, 6 * section, 6);
+            }
+            glUniform4f(colorLocation, 1.f, 1.f, 1.f, 1.f);
+            glDrawArrays(GL_TRIANGLES, 6 * NUM_SECTIONS, 6);
+
+            if (textWidth > 0) {
+                // One texel per pixel, the first row of the texture at the top
+                const float tx0 = x0, ty0 = y1 + 0.02f;
+                const float tx1 = tx0 + 2.0f * textWidth / WINDOW_WIDTH, ty1 = ty0 + 2.0f * textHeight / WINDOW_HEIGHT;
+                const float quad[] = {tx0, ty0, 0.f, 1.f, tx1, ty0, 1.f, 1.f, tx1, ty1, 1.f, 0.f,
+                                      tx0, ty0, 0.f, 1.f, tx1, ty1, 1.f, 0.f, tx0, ty1, 0.f, 0.f};
+                glUseProgram(spIdT);
+                glBindVertexArray(VAO[7]);
+                glBindBuffer(GL_ARRAY_BUFFER, VBO[7]);
+                glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STREAM_DRAW);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, textTexture);
+                glDrawArrays(GL_TRIANGLES, 0, 6);
+            }
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            glEnable(GL_DEPTH_TEST);
         }
         SDL_GL_SwapWindow(window);
         auto ticks2 = SDL_GetTicks64();
@@ -521,8 +1110,19 @@ int main(int argc, char** argv)
         ticks = ticks2;
     }
 
+    if (font)
+        TTF_CloseFont(font);
     SDL_GL_DeleteContext(ctx);
     SDL_DestroyWindow(window);
 
+    // Closing the window does not wait for a build nobody will see
+    pipeline.cancel();
+    try {
+        pipeline.wait();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
     return 0;
 }
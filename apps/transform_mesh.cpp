@@ -0,0 +1,179 @@
+#include "bvh.hpp"
+#include "MappedFile.hpp"
+#include "MeshTransform.hpp"
+#include "ReadSTL.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using MeshTransform::Affine;
+
+namespace {
+
+void usage(const char* name)
+{
+    std::cerr << "Usage: " << name << " <input.stl> <output.stl|-i> [operations]" << std::endl;
+    std::cerr << "Operations are applied in order:" << std::endl;
+    std::cerr << "  -c              center on the mean vertex" << std::endl;
+    std::cerr << "  -n              center and scale into [-1, 1]" << std::endl;
+    std::cerr << "  -s f            scale uniformly" << std::endl;
+    std::cerr << "  -S x y z        scale per axis" << std::endl;
+    std::cerr << "  -t x y z        translate" << std::endl;
+    std::cerr << "  -x xy|yz|xz     swap two axes" << std::endl;
+    std::cerr << "  -m m00 .. m23   affine transform, 12 values in row major order" << std::endl;
+    std::cerr << "With -i a binary STL input is transformed in place." << std::endl;
+}
+
+int axis(char c)
+{
+    if (c < 'x' || c > 'z')
+        throw std::runtime_error(std::string("Unknown axis ") + c);
+    return c - 'x';
+}
+
+bool isBinarySTL(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    char header[84];
+    if (!file.read(header, sizeof(header)))
+        return false;
+    std::uint32_t count;
+    std::memcpy(&count, header + 80, sizeof(count));
+    return 84 + MeshTransform::STL_RECORD_SIZE * std::uint64_t(count) == std::filesystem::file_size(path);
+}
+
+void writeBinarySTL(const std::string& path, const std::vector<BVH::Triangle>& tris)
+{
+    std::ofstream file(path, std::ios::binary);
+    const char header[80] = "transform_mesh";
+    file.write(header, sizeof(header));
+    const std::uint32_t count = tris.size();
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    std::vector<char> records(MeshTransform::STL_RECORD_SIZE * tris.size());
+    for (std::size_t i = 0; i < tris.size(); ++i) {
+        const auto& v = tris[i].vertices;
+        const Vector4 n = (v[1] - v[0]).cross3(v[2] - v[0]).normalized3();
+        const float values[12] = {n.x, n.y, n.z, v[0].x, v[0].y, v[0].z,
+                                  v[1].x, v[1].y, v[1].z, v[2].x, v[2].y, v[2].z};
+        std::memcpy(records.data() + MeshTransform::STL_RECORD_SIZE * i, values, sizeof(values));
+    }
+    file.write(records.data(), records.size());
+    if (!file)
+        throw std::runtime_error("Error writing " + path);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 4) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    const std::string input = argv[1];
+    const bool in_place = !strcmp(argv[2], "-i");
+    const std::string output = in_place ? input : argv[2];
+
+    // Operations needing vertex statistics measure the mesh transformed by
+    // everything before them, the rest only compose into one transform
+    std::vector<std::function<Affine(const Affine&)>> operations;
+    auto floats = [&](int& i, int n)
+    {
+        if (i + n >= argc)
+            throw std::runtime_error(std::string("Missing values for ") + argv[i]);
+        std::vector<float> result;
+        for (int j = 0; j < n; ++j)
+            result.push_back(std::stof(argv[++i]));
+        return result;
+    };
+
+    std::function<MeshTransform::Stats(const Affine&)> measure;
+    try {
+        for (int i = 3; i < argc; ++i) {
+            Affine op;
+            if (!strcmp(argv[i], "-c")) {
+                operations.push_back([&measure](const Affine& current)
+                {
+                    return current.then(MeshTransform::center(measure(current)));
+                });
+                continue;
+            } else if (!strcmp(argv[i], "-n")) {
+                operations.push_back([&measure](const Affine& current)
+                {
+                    const auto stats = measure(current);
+                    std::cout << "center: " << stats.mean[0] << " " << stats.mean[1]
+                              << " " << stats.mean[2] << std::endl;
+                    std::cout << "scale: " << stats.radius() << std::endl;
+                    return current.then(MeshTransform::normalize(stats));
+                });
+                continue;
+            } else if (!strcmp(argv[i], "-s")) {
+                const float s = floats(i, 1)[0];
+                op = Affine::scaling(s, s, s);
+            } else if (!strcmp(argv[i], "-S")) {
+                const auto s = floats(i, 3);
+                op = Affine::scaling(s[0], s[1], s[2]);
+            } else if (!strcmp(argv[i], "-t")) {
+                const auto t = floats(i, 3);
+                op = Affine::translation(t[0], t[1], t[2]);
+            } else if (!strcmp(argv[i], "-x") && i + 1 < argc && strlen(argv[i + 1]) == 2) {
+                ++i;
+                op = Affine::swap(axis(argv[i][0]), axis(argv[i][1]));
+            } else if (!strcmp(argv[i], "-m")) {
+                const auto m = floats(i, 12);
+                std::copy(m.begin(), m.end(), op.m.begin());
+            } else {
+                std::cerr << "Unknown option " << argv[i] << std::endl;
+                usage(argv[0]);
+                return 1;
+            }
+            operations.push_back([op](const Affine& current) { return current.then(op); });
+        }
+
+        auto t1 = std::chrono::steady_clock::now();
+        if (isBinarySTL(input)) {
+            // Transform the records of the memory mapped file, output is a copy of the input
+            if (!in_place)
+                std::filesystem::copy_file(input, output, std::filesystem::copy_options::overwrite_existing);
+            MappedFile file = MappedFile::writable(output);
+            char* records = file.data() + 84;
+            const std::size_t count = (file.view().size() - 84) / MeshTransform::STL_RECORD_SIZE;
+            measure = [&](const Affine& current) { return MeshTransform::measure(records, count, current); };
+
+            Affine transform;
+            for (const auto& operation : operations)
+                transform = operation(transform);
+            MeshTransform::apply(records, count, transform);
+            file.sync();
+            std::cout << "Transformed " << count << " triangles";
+        } else {
+            if (in_place)
+                throw std::runtime_error("In place transforms need a binary STL file");
+            auto [tris, normals] = STLReader::read(input);
+            measure = [&](const Affine& current) { return MeshTransform::measure(tris, current); };
+
+            Affine transform;
+            for (const auto& operation : operations)
+                transform = operation(transform);
+            MeshTransform::apply(tris, transform);
+            writeBinarySTL(output, tris);
+            std::cout << "Transformed " << tris.size() << " triangles";
+        }
+        auto t2 = std::chrono::steady_clock::now();
+        std::cout << " in " << std::chrono::duration<double>(t2 - t1).count() << " s" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,78 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "bvh.hpp"
+
+#include "IndexMesh.hpp"
+#include "Scenes.hpp"
+
+#include <omp.h>
+
+namespace {
+
+// The trees reorder their triangles, so each build gets a fresh copy
+void buildSoup(benchmark::State& state, const std::string& name)
+{
+    omp_set_num_threads(Scenes::maxThreads());
+    const auto& tris = Scenes::triangles(name);
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto copy = tris;
+        state.ResumeTiming();
+        BVH::AABBTree tree(copy, 0.001f);
+        benchmark::DoNotOptimize(tree.root);
+    }
+    state.SetItemsProcessed(state.iterations() * tris.size());
+    state.counters["triangles"] = tris.size();
+}
+
+void weld(benchmark::State& state, const std::string& name)
+{
+    omp_set_num_threads(state.range(0));
+    const auto& tris = Scenes::triangles(name);
+    for (auto _ : state) {
+        BVH::IndexedMesh mesh = MeshIndexer::weld(tris);
+        benchmark::DoNotOptimize(mesh.vertices.data());
+    }
+    state.SetItemsProcessed(state.iterations() * tris.size());
+    state.counters["triangles"] = tris.size();
+}
+
+void buildIndexed(benchmark::State& state, const std::string& name)
+{
+    omp_set_num_threads(Scenes::maxThreads());
+    const BVH::IndexedMesh mesh = MeshIndexer::weld(Scenes::triangles(name));
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto copy = mesh;
+        state.ResumeTiming();
+        BVH::IndexedAABBTree tree(copy, 0.001f);
+        benchmark::DoNotOptimize(tree.root);
+    }
+    state.SetItemsProcessed(state.iterations() * mesh.triangles.size());
+    state.counters["triangles"] = mesh.triangles.size();
+}
+
+const bool registered = []
+{
+    for (const auto& name : Scenes::names()) {
+        benchmark::RegisterBenchmark(("BuildSoup/" + name).c_str(),
+                                     [name](benchmark::State& state) { buildSoup(state, name); })
+            ->UseRealTime()->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark(("Weld/" + name).c_str(),
+                                     [name](benchmark::State& state) { weld(state, name); })
+            ->Apply(Scenes::threadCounts)->UseRealTime()->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark(("BuildIndexed/" + name).c_str(),
+                                     [name](benchmark::State& state) { buildIndexed(state, name); })
+            ->UseRealTime()->Unit(benchmark::kMillisecond);
+    }
+    return true;
+}();
+
+}
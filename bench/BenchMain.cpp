@@ -0,0 +1,26 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "Scenes.hpp"
+
+#include <string>
+
+// Run with --benchmark_out=file.json --benchmark_out_format=json to keep the
+// results for trend tracking. Meshes are loaded by the benchmarks that use
+// them, which report their size in the triangles counter.
+int main(int argc, char** argv)
+{
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    benchmark::AddCustomContext("omp_max_threads", std::to_string(Scenes::maxThreads()));
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
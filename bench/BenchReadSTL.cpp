@@ -0,0 +1,63 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "bvh.hpp"
+
+#include "Meshes.hpp"
+#include "ReadSTL.hpp"
+#include "Scenes.hpp"
+
+#include <omp.h>
+
+#include <filesystem>
+
+namespace {
+
+// Shipped binary models, read from the file
+void readFile(benchmark::State& state, const std::string& name)
+{
+    omp_set_num_threads(Scenes::maxThreads());
+    const std::string path = Scenes::path(name);
+    std::size_t triangles = 0;
+    for (auto _ : state) {
+        auto [tris, normals] = STLReader::read(path);
+        benchmark::DoNotOptimize(tris.data());
+        triangles = tris.size();
+    }
+    state.SetBytesProcessed(state.iterations() * std::filesystem::file_size(path));
+    state.counters["triangles"] = triangles;
+}
+
+// Synthetic ASCII text, parsed in parallel chunks
+void readASCII(benchmark::State& state)
+{
+    omp_set_num_threads(state.range(0));
+    const auto sphere = Meshes::sphere(64);
+    const std::string text = Scenes::asciiSTL(sphere);
+    for (auto _ : state) {
+        auto [tris, normals] = STLReader::readASCII(text, false);
+        benchmark::DoNotOptimize(tris.data());
+    }
+    state.SetBytesProcessed(state.iterations() * text.size());
+    state.counters["triangles"] = sphere.size();
+}
+
+const bool registered = []
+{
+    for (const auto& name : Scenes::names())
+        if (!Scenes::path(name).empty())
+            benchmark::RegisterBenchmark(("ReadSTL/" + name).c_str(),
+                                         [name](benchmark::State& state) { readFile(state, name); })
+                ->UseRealTime()->Unit(benchmark::kMicrosecond);
+    benchmark::RegisterBenchmark("ReadSTLASCII/sphere", readASCII)->Apply(Scenes::threadCounts)->UseRealTime()
+        ->Unit(benchmark::kMillisecond);
+    return true;
+}();
+
+}
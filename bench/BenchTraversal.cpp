@@ -0,0 +1,168 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "bvh.hpp"
+
+#include "Scenes.hpp"
+
+#include <omp.h>
+
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <random>
+#include <utility>
+
+namespace {
+
+// Primary rays from a camera are coherent, random rays through the bounds from
+// outside are not. Shadow rays go from the primary hits to a light and end there.
+enum class Distribution { Primary, Random, Shadow };
+
+constexpr int RESOLUTION = 256;
+
+struct Rays
+{
+    std::vector<Vector4> origins, directions;
+    std::vector<float> lengths;
+
+    void add(Vector4 origin, Vector4 direction, float length = std::numeric_limits<float>::max())
+    {
+        origins.push_back(origin);
+        directions.push_back(direction);
+        lengths.push_back(length);
+    }
+};
+
+// The tree reorders its own copy of the triangles
+struct Scene
+{
+    explicit Scene(std::vector<BVH::Triangle> triangles)
+        : tris(std::move(triangles)), tree(std::make_unique<BVH::AABBTree>(tris, 0.001f)),
+          center((tree->root->aabb.lower + tree->root->aabb.upper) * 0.5f),
+          size((tree->root->aabb.upper - tree->root->aabb.lower).length3())
+    {
+    }
+
+    std::vector<BVH::Triangle> tris;
+    std::unique_ptr<BVH::AABBTree> tree;
+    Vector4 center;
+    float size;
+};
+
+const Scene& scene(const std::string& name)
+{
+    static std::map<std::string, Scene> scenes;
+    auto it = scenes.find(name);
+    if (it == scenes.end())
+        it = scenes.emplace(name, Scene(Scenes::triangles(name))).first;
+    return it->second;
+}
+
+// Looking along y at the model, the view is 0.6 times the bounds diagonal wide at the center
+Rays primaryRays(const Scene& s)
+{
+    Rays rays;
+    const Vector4 eye = s.center - Vector4(0.0f, s.size, 0.0f);
+    for (int y = 0; y < RESOLUTION; ++y)
+        for (int x = 0; x < RESOLUTION; ++x) {
+            const float u = 0.3f * (2.0f * (x + 0.5f) / RESOLUTION - 1.0f);
+            const float v = 0.3f * (2.0f * (y + 0.5f) / RESOLUTION - 1.0f);
+            rays.add(eye, Vector4(u, 1.0f, v).normalized3());
+        }
+    return rays;
+}
+
+Rays makeRays(const Scene& s, Distribution distribution)
+{
+    if (distribution == Distribution::Primary)
+        return primaryRays(s);
+
+    Rays rays;
+    if (distribution == Distribution::Random) {
+        std::mt19937 random(12345);
+        std::normal_distribution<float> normal;
+        std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+        const BVH::AABB& box = s.tree->root->aabb;
+        for (int i = 0; i < RESOLUTION * RESOLUTION; ++i) {
+            const Vector4 origin = s.center + Vector4(normal(random), normal(random), normal(random)).normalized3() * s.size;
+            const Vector4 target = box.lower + (box.upper - box.lower) * Vector4(uniform(random), uniform(random), uniform(random));
+            rays.add(origin, (target - origin).normalized3());
+        }
+        return rays;
+    }
+
+    const Rays primary = primaryRays(s);
+    const Vector4 light = s.center + Vector4(1.0f, -1.0f, 1.0f) * s.size;
+    for (std::size_t i = 0; i < primary.origins.size(); ++i) {
+        float t;
+        Vector4 pt, normal;
+        if (!s.tree->does_intersect_ray(primary.origins[i], primary.directions[i], &t, &pt, &normal))
+            continue;
+        if (normal.dot3(primary.directions[i]) > 0)
+            normal = normal * -1.0f;
+        const Vector4 origin = pt + normal * (1e-4f * s.size);
+        const Vector4 to_light = light - origin;
+        const float distance = to_light.length3();
+        rays.add(origin, to_light / distance, distance);
+    }
+    return rays;
+}
+
+// Closest hits or occlusion of all rays per iteration, traced in parallel like raytrace
+template <bool Closest>
+void trace(benchmark::State& state, const std::string& name, Distribution distribution)
+{
+    const Scene& s = scene(name);
+    const Rays rays = makeRays(s, distribution);
+    const std::int64_t n = rays.origins.size();
+    omp_set_num_threads(state.range(0));
+    std::int64_t hits = 0;
+    for (auto _ : state) {
+        hits = 0;
+#pragma omp parallel for schedule(dynamic, 64) reduction(+ : hits)
+        for (std::int64_t i = 0; i < n; ++i) {
+            if constexpr (Closest) {
+                float t;
+                Vector4 pt, normal;
+                hits += s.tree->does_intersect_ray(rays.origins[i], rays.directions[i], &t, &pt, &normal);
+            } else {
+                hits += s.tree->is_occluded(rays.origins[i], rays.directions[i], rays.lengths[i]);
+            }
+        }
+        benchmark::DoNotOptimize(hits);
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+    state.counters["triangles"] = s.tris.size();
+    state.counters["rays"] = n;
+    state.counters["hit_rate"] = n > 0 ? double(hits) / n : 0.0;
+}
+
+const bool registered = []
+{
+    const std::pair<const char*, Distribution> distributions[] = {
+        {"primary", Distribution::Primary}, {"random", Distribution::Random}, {"shadow", Distribution::Shadow}};
+    for (const auto& name : Scenes::names())
+        for (const auto& entry : distributions) {
+            const Distribution distribution = entry.second;
+            const auto suffix = "/" + name + "/" + entry.first;
+            benchmark::RegisterBenchmark(("ClosestHit" + suffix).c_str(),
+                                         [name, distribution](benchmark::State& state)
+                                         { trace<true>(state, name, distribution); })
+                ->Apply(Scenes::threadCounts)->UseRealTime()->Unit(benchmark::kMillisecond);
+            benchmark::RegisterBenchmark(("Occluded" + suffix).c_str(),
+                                         [name, distribution](benchmark::State& state)
+                                         { trace<false>(state, name, distribution); })
+                ->Apply(Scenes::threadCounts)->UseRealTime()->Unit(benchmark::kMillisecond);
+        }
+    return true;
+}();
+
+}
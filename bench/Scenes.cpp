@@ -0,0 +1,75 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "Scenes.hpp"
+
+#include "Meshes.hpp"
+#include "ReadSTL.hpp"
+
+#include <fmt/format.h>
+
+#include <omp.h>
+
+#include <map>
+
+namespace Scenes {
+
+const std::vector<std::string>& names()
+{
+    static const std::vector<std::string> names = {"teapot.stl", "sydler.stl", "sphere"};
+    return names;
+}
+
+std::string path(const std::string& name)
+{
+    if (!name.ends_with(".stl"))
+        return {};
+    return std::string(WALDO_GEOMETRY_DIR) + "/" + name;
+}
+
+const std::vector<BVH::Triangle>& triangles(const std::string& name)
+{
+    static std::map<std::string, std::vector<BVH::Triangle>> meshes;
+    auto it = meshes.find(name);
+    if (it == meshes.end()) {
+        std::vector<BVH::Triangle> tris;
+        if (name == "sphere")
+            tris = Meshes::sphere(256);
+        else
+            tris = std::get<0>(STLReader::read(path(name)));
+        it = meshes.emplace(name, std::move(tris)).first;
+    }
+    return it->second;
+}
+
+std::string asciiSTL(const std::vector<BVH::Triangle>& tris)
+{
+    std::string text = "solid sphere\n";
+    for (const auto& tri : tris) {
+        text += "  facet normal 0 0 0\n    outer loop\n";
+        for (const auto& v : tri.vertices)
+            text += fmt::format("      vertex {} {} {}\n", v.x, v.y, v.z);
+        text += "    endloop\n  endfacet\n";
+    }
+    return text + "endsolid sphere\n";
+}
+
+int maxThreads()
+{
+    static const int threads = omp_get_max_threads();
+    return threads;
+}
+
+void threadCounts(benchmark::internal::Benchmark* benchmark)
+{
+    for (int threads = 1; threads < maxThreads(); threads *= 2)
+        benchmark->Arg(threads);
+    benchmark->Arg(maxThreads());
+    benchmark->ArgName("threads");
+}
+
+}
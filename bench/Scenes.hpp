@@ -0,0 +1,40 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#ifndef WALDO_BENCH_SCENES_HPP_
+#define WALDO_BENCH_SCENES_HPP_
+
+#include "bvh.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <vector>
+
+//! \brief Meshes and thread counts shared by the benchmarks.
+namespace Scenes {
+    //! \brief Benchmarked meshes, the shipped models and a synthetic sphere.
+    const std::vector<std::string>& names();
+
+    //! \brief Path of a shipped model, empty for synthetic meshes.
+    std::string path(const std::string& name);
+
+    //! \brief Triangles of a mesh, loaded or generated on first use.
+    const std::vector<BVH::Triangle>& triangles(const std::string& name);
+
+    //! \brief Triangles as ASCII STL text.
+    std::string asciiSTL(const std::vector<BVH::Triangle>& tris);
+
+    //! \brief OpenMP threads available before any benchmark changed them.
+    int maxThreads();
+
+    //! \brief Sweep the first argument over the powers of two below
+    //!        maxThreads() and maxThreads() itself.
+    void threadCounts(benchmark::internal::Benchmark* benchmark);
+};
+
+#endif
@@ -0,0 +1,52 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "Chunks.hpp"
+
+#include <fmt/format.h>
+
+#include <stdexcept>
+
+#include <omp.h>
+
+namespace Chunks {
+
+std::vector<std::size_t> split(std::string_view buffer, std::string_view separator)
+{
+    const std::size_t num_chunks =
+        std::clamp<std::size_t>(buffer.size() / MIN_CHUNK_SIZE, 1,
+                                4 * omp_get_max_threads());
+
+    std::vector<std::size_t> bounds{0};
+    for (std::size_t i = 1; i < num_chunks; ++i) {
+        const std::size_t start = std::max(bounds.back(), i * buffer.size() / num_chunks);
+        const std::size_t found = buffer.find(separator, start);
+        if (found == std::string_view::npos)
+            break;
+        bounds.push_back(found + separator.size());
+    }
+    bounds.push_back(buffer.size());
+
+    return bounds;
+}
+
+void rethrowFirst(const std::vector<std::exception_ptr>& errors,
+                  std::string_view name)
+{
+    for (const auto& error : errors) {
+        if (error) {
+            try {
+                std::rethrow_exception(error);
+            } catch (const std::exception& e) {
+                throw std::runtime_error(fmt::format("Error reading {}, error = {}",
+                                                     name, e.what()));
+            }
+        }
+    }
+}
+
+}
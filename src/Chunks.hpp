@@ -0,0 +1,51 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#ifndef WALDO_CHUNKS_HPP_
+#define WALDO_CHUNKS_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <string_view>
+#include <vector>
+
+//! \brief Helpers for parsing text buffers in parallel chunks.
+namespace Chunks {
+    //! \brief Minimum number of bytes handed to each parser task.
+    constexpr std::size_t MIN_CHUNK_SIZE = 1 << 20;
+
+    //! \brief Split a buffer into chunks ending right after a separator.
+    //! \param[in] buffer Buffer to split
+    //! \param[in] separator Separator to end chunks on
+    //! \return Chunk boundaries, chunk i is [bounds[i], bounds[i+1])
+    std::vector<std::size_t> split(std::string_view buffer,
+                                   std::string_view separator);
+
+    //! \brief Rethrow the first error, prefixed with the name of the input.
+    void rethrowFirst(const std::vector<std::exception_ptr>& errors,
+                      std::string_view name);
+
+    inline bool isBlank(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    //! \brief Calls func(begin, end) for each non-blank line in the range.
+    template<class Function>
+    void forEachLine(const char* pos, const char* end, Function&& func)
+    {
+        while (pos != end) {
+            const char* eol = std::find(pos, end, '\n');
+            if (std::find_if_not(pos, eol, isBlank) != eol)
+                func(pos, eol);
+            pos = eol == end ? end : eol + 1;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,49 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "Culling.hpp"
+
+namespace Culling {
+
+Frustum Frustum::fromMatrix(const float* matrix)
+{
+    // Gribb and Hartmann: the planes are sums and differences of the rows
+    auto row = [matrix](int r) {
+        return std::array<float,4>{matrix[r], matrix[4 + r], matrix[8 + r], matrix[12 + r]};
+    };
+    const auto w = row(3);
+    Frustum frustum;
+    for (int axis = 0; axis < 3; ++axis) {
+        const auto r = row(axis);
+        for (int k = 0; k < 4; ++k) {
+            frustum.planes[2*axis][k] = w[k] + r[k];
+            frustum.planes[2*axis+1][k] = w[k] - r[k];
+        }
+    }
+    return frustum;
+}
+
+Side Frustum::classify(const float lower[3], const float upper[3]) const
+{
+    Side side = Side::Inside;
+    for (const auto& plane : planes) {
+        // Corners furthest along and against the plane normal
+        float far = plane[3], near = plane[3];
+        for (int a = 0; a < 3; ++a) {
+            const bool positive = plane[a] >= 0.0f;
+            far += plane[a] * (positive ? upper[a] : lower[a]);
+            near += plane[a] * (positive ? lower[a] : upper[a]);
+        }
+        if (far < 0.0f)
+            return Side::Outside;
+        if (near < 0.0f)
+            side = Side::Intersecting;
+    }
+    return side;
+}
+
+}
@@ -0,0 +1,82 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#ifndef WALDO_CULLING_HPP_
+#define WALDO_CULLING_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//! \brief View frustum culling of tree nodes for chunked drawing.
+//! \details The primitives of a tree are stored in leaf order, so every node
+//!          covers a contiguous range of them. Walking the tree against the
+//!          frustum gives the ranges to draw.
+namespace Culling {
+    enum class Side { Outside, Intersecting, Inside };
+
+    //! \brief The six planes of a view frustum, inside where a x + b y + c z + d >= 0.
+    struct Frustum
+    {
+        std::array<std::array<float,4>,6> planes;
+
+        //! \brief Frustum of a projection times view matrix.
+        //! \param[in] matrix 16 values in column major order, as in OpenGL
+        static Frustum fromMatrix(const float* matrix);
+
+        //! \brief Where an axis aligned box is, conservatively Intersecting near the corners of the frustum.
+        Side classify(const float lower[3], const float upper[3]) const;
+    };
+
+    //! \brief Triangles [first, first + count) in the order of the tree.
+    struct Range
+    {
+        std::uint32_t first, count;
+    };
+
+    //! \brief Append the ranges of the nodes in a frustum, merging adjacent ones.
+    //! \details Nodes partly in the frustum are split down to chunk_size
+    //!          triangles or to the leaves.
+    //! \param[in] root Root of a BVH::BasicAABBTree
+    //! \param[in] chunk_size Largest range drawn for a partly visible node
+    //! \param[out] ranges Visible ranges, in ascending order
+    template<class Node>
+    void visibleRanges(const Node* root, const Frustum& frustum, std::size_t chunk_size,
+                       std::vector<Range>& ranges)
+    {
+        if (!root)
+            return;
+        std::vector<const Node*> stack = {root};
+        while (!stack.empty()) {
+            const Node* node = stack.back();
+            stack.pop_back();
+            const float lower[3] = {node->aabb.lower.x, node->aabb.lower.y, node->aabb.lower.z};
+            const float upper[3] = {node->aabb.upper.x, node->aabb.upper.y, node->aabb.upper.z};
+            const Side side = frustum.classify(lower, upper);
+            if (side == Side::Outside)
+                continue;
+
+            const std::size_t count = node->end - node->begin;
+            if (side == Side::Inside || node->is_leaf() || count <= chunk_size) {
+                const std::uint32_t first = node->begin - root->begin;
+                if (!ranges.empty() && ranges.back().first + ranges.back().count == first)
+                    ranges.back().count += count;
+                else
+                    ranges.push_back({first, std::uint32_t(count)});
+                continue;
+            }
+            // Left on top, so the ranges come out in ascending order
+            if (node->right)
+                stack.push_back(node->right);
+            if (node->left)
+                stack.push_back(node->left);
+        }
+    }
+};
+
+#endif
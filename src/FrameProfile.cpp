@@ -0,0 +1,76 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "FrameProfile.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+
+FrameProfile::FrameProfile(std::vector<std::string> sections, std::size_t window)
+    : m_sections(std::move(sections)),
+      m_window(std::max<std::size_t>(window, 1)),
+      m_history(m_window * m_sections.size(), 0.0),
+      m_sums(m_sections.size(), 0.0)
+{}
+
+void FrameProfile::trace(std::string_view path)
+{
+    m_trace.open(std::filesystem::path(path));
+    if (!m_trace)
+        throw std::runtime_error(fmt::format("Error writing {}", path));
+    m_trace << "frame";
+    for (const auto& name : m_sections)
+        m_trace << ',' << name << "_ms";
+    m_trace << '\n';
+}
+
+void FrameProfile::add(const std::vector<double>& milliseconds)
+{
+    if (milliseconds.size() != m_sections.size())
+        throw std::invalid_argument(fmt::format("Expected {} section timings, got {}",
+                                                m_sections.size(), milliseconds.size()));
+
+    // Replace the oldest frame in the running sums
+    double* row = &m_history[(m_frames % m_window) * m_sections.size()];
+    for (std::size_t i = 0; i < m_sections.size(); ++i) {
+        m_sums[i] += milliseconds[i] - row[i];
+        row[i] = milliseconds[i];
+    }
+
+    if (m_trace.is_open()) {
+        m_trace << m_frames;
+        for (double ms : milliseconds)
+            m_trace << fmt::format(",{:.4f}", ms);
+        m_trace << '\n';
+    }
+    ++m_frames;
+}
+
+double FrameProfile::average(std::size_t section) const
+{
+    const std::size_t count = std::min(m_frames, m_window);
+    return count > 0 ? m_sums[section] / count : 0.0;
+}
+
+double FrameProfile::total() const
+{
+    double sum = 0.0;
+    for (std::size_t i = 0; i < m_sections.size(); ++i)
+        sum += average(i);
+    return sum;
+}
+
+std::string FrameProfile::summary() const
+{
+    std::string result;
+    for (std::size_t i = 0; i < m_sections.size(); ++i)
+        result += fmt::format("{}{} {:.2f} ms", i == 0 ? "" : ", ", m_sections[i], average(i));
+    return result;
+}
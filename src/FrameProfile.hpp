@@ -0,0 +1,58 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#ifndef WALDO_FRAME_PROFILE_HPP_
+#define WALDO_FRAME_PROFILE_HPP_
+
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//! \brief Timings of named sections of interactive frames.
+//! \details Keeps running averages over the last frames for display and
+//!          optionally appends every frame to a CSV trace.
+class FrameProfile
+{
+public:
+    //! \brief Profile of the given sections.
+    //! \param[in] window Number of frames averaged
+    explicit FrameProfile(std::vector<std::string> sections, std::size_t window = 60);
+
+    const std::vector<std::string>& sections() const { return m_sections; }
+
+    //! \brief Start writing each frame as a line of a CSV file.
+    //! \details Throws std::runtime_error if the file cannot be opened.
+    void trace(std::string_view path);
+
+    //! \brief Record a frame.
+    //! \param[in] milliseconds Time spent in each section, in the order of sections()
+    void add(const std::vector<double>& milliseconds);
+
+    //! \brief Number of frames recorded.
+    std::size_t size() const { return m_frames; }
+
+    //! \brief Average time of a section over the last frames, in milliseconds.
+    double average(std::size_t section) const;
+
+    //! \brief Sum of the averages of all sections, in milliseconds.
+    double total() const;
+
+    //! \brief Returns the averages as "name 1.23 ms, ...".
+    std::string summary() const;
+
+private:
+    std::vector<std::string> m_sections;
+    std::size_t m_window;
+    std::size_t m_frames = 0;
+    std::vector<double> m_history; //!< Ring of the last frames, a row of sections each
+    std::vector<double> m_sums;
+    std::ofstream m_trace;
+};
+
+#endif
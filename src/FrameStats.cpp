@@ -0,0 +1,82 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "FrameStats.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cmath>
+
+void FrameStats::add(double seconds, std::uint64_t rays)
+{
+    m_frames.push_back({seconds, rays});
+}
+
+double FrameStats::mean() const
+{
+    if (m_frames.empty())
+        return 0.0;
+    double sum = 0.0;
+    for (const auto& frame : m_frames)
+        sum += frame.seconds;
+    return sum / m_frames.size();
+}
+
+double FrameStats::percentile(double p) const
+{
+    if (m_frames.empty())
+        return 0.0;
+
+    std::vector<double> times;
+    times.reserve(m_frames.size());
+    for (const auto& frame : m_frames)
+        times.push_back(frame.seconds);
+    std::sort(times.begin(), times.end());
+
+    const double pos = std::clamp(p, 0.0, 100.0) / 100.0 * (times.size() - 1);
+    const std::size_t below = std::floor(pos);
+    const std::size_t above = std::min(below + 1, times.size() - 1);
+    return times[below] + (pos - below) * (times[above] - times[below]);
+}
+
+double FrameStats::mraysPerSecond() const
+{
+    double seconds = 0.0, rays = 0.0;
+    for (const auto& frame : m_frames) {
+        seconds += frame.seconds;
+        rays += frame.rays;
+    }
+    return seconds > 0.0 ? rays / seconds / 1e6 : 0.0;
+}
+
+std::string FrameStats::json(const std::vector<std::pair<std::string, std::string>>& info) const
+{
+    std::string result = "{\n";
+    for (const auto& [key, value] : info)
+        result += fmt::format("  \"{}\": {},\n", key, value);
+
+    result += "  \"frames\": [";
+    for (std::size_t i = 0; i < m_frames.size(); ++i) {
+        const auto& frame = m_frames[i];
+        const double mrays = frame.seconds > 0.0 ? frame.rays / frame.seconds / 1e6 : 0.0;
+        result += fmt::format("{}\n    {{\"frame\": {}, \"ms\": {:.4f}, \"mrays_per_s\": {:.4f}}}",
+                              i == 0 ? "" : ",", i, 1e3 * frame.seconds, mrays);
+    }
+    result += m_frames.empty() ? "],\n" : "\n  ],\n";
+
+    result += fmt::format("  \"summary\": {{\"frames\": {}, \"mean_ms\": {:.4f}, "
+                          "\"min_ms\": {:.4f}, \"p50_ms\": {:.4f}, \"p90_ms\": {:.4f}, "
+                          "\"p95_ms\": {:.4f}, \"p99_ms\": {:.4f}, \"max_ms\": {:.4f}, "
+                          "\"mrays_per_s\": {:.4f}}}\n",
+                          m_frames.size(), 1e3 * mean(),
+                          1e3 * percentile(0), 1e3 * percentile(50), 1e3 * percentile(90),
+                          1e3 * percentile(95), 1e3 * percentile(99), 1e3 * percentile(100),
+                          mraysPerSecond());
+    result += "}\n";
+    return result;
+}
@@ -0,0 +1,50 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#ifndef WALDO_FRAME_STATS_HPP_
+#define WALDO_FRAME_STATS_HPP_
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+//! \brief Per-frame timings of a benchmark run and their summary.
+class FrameStats
+{
+public:
+    //! \brief Record a frame.
+    //! \param[in] seconds Time spent on the frame
+    //! \param[in] rays Number of rays traced in the frame
+    void add(double seconds, std::uint64_t rays);
+
+    std::size_t size() const { return m_frames.size(); }
+
+    double mean() const;
+
+    //! \brief Frame time percentile, linearly interpolated.
+    //! \param[in] p Percentile in [0, 100]
+    double percentile(double p) const;
+
+    //! \brief Rays per second over all frames, in millions.
+    double mraysPerSecond() const;
+
+    //! \brief Returns the frames and summary as JSON.
+    //! \param[in] info Extra key and value pairs, values are emitted verbatim
+    std::string json(const std::vector<std::pair<std::string, std::string>>& info = {}) const;
+
+private:
+    struct Frame
+    {
+        double seconds;
+        std::uint64_t rays;
+    };
+
+    std::vector<Frame> m_frames;
+};
+
+#endif
@@ -0,0 +1,478 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "IndexMesh.hpp"
+
+#include "bvh.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <omp.h>
+
+namespace {
+
+struct CellKey
+{
+    std::int64_t x, y, z;
+    bool operator==(const CellKey&) const = default;
+};
+
+std::uint64_t mix(std::uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+std::uint64_t hashKey(const CellKey& key)
+{
+    return mix(mix(mix(key.x) ^ key.y) ^ key.z);
+}
+
+struct CellKeyHash
+{
+    std::size_t operator()(const CellKey& key) const { return hashKey(key); }
+};
+
+//! \brief Returns the welding cell of a vertex.
+//! \details With zero tolerance the bit pattern is used, so only identical
+//!          coordinates are merged (with -0 and +0 considered equal).
+CellKey cellKey(const Vector4& v, float tolerance)
+{
+    if (tolerance > 0.0f) {
+        const double scale = 1.0 / tolerance;
+        return {std::llround(v.x * scale),
+                std::llround(v.y * scale),
+                std::llround(v.z * scale)};
+    }
+
+    return {std::bit_cast<std::uint32_t>(v.x + 0.0f),
+            std::bit_cast<std::uint32_t>(v.y + 0.0f),
+            std::bit_cast<std::uint32_t>(v.z + 0.0f)};
+}
+
+//! \brief Items grouped into hash buckets.
+//! \details Items within a bucket are kept in ascending order, so the first
+//!          item of a group of equal keys is always the lowest index.
+struct Buckets
+{
+    std::vector<std::uint32_t> items; //!< Item indices grouped by bucket
+    std::vector<std::size_t> starts;  //!< Offset of each bucket in items
+};
+
+//! \brief Parallel counting sort of item indices by hash bucket.
+Buckets bucketize(const std::vector<std::uint64_t>& hashes)
+{
+    const int max_threads = omp_get_max_threads();
+    const std::size_t num_buckets = std::bit_ceil<std::size_t>(64 * max_threads);
+    const std::size_t n = hashes.size();
+
+    Buckets result;
+    result.items.resize(n);
+    result.starts.resize(num_buckets + 1);
+    std::vector<std::size_t> offsets(max_threads * num_buckets, 0);
+
+#pragma omp parallel num_threads(max_threads)
+    {
+        const std::size_t t = omp_get_thread_num();
+        const std::size_t nt = omp_get_num_threads();
+        const std::size_t first = n * t / nt;
+        const std::size_t last = n * (t + 1) / nt;
+        std::size_t* count = offsets.data() + t * num_buckets;
+
+        for (std::size_t i = first; i < last; ++i)
+            ++count[hashes[i] & (num_buckets - 1)];
+
+#pragma omp barrier
+#pragma omp single
+        {
+            std::size_t sum = 0;
+            for (std::size_t b = 0; b < num_buckets; ++b) {
+                result.starts[b] = sum;
+                for (std::size_t k = 0; k < nt; ++k) {
+                    const std::size_t c = offsets[k * num_buckets + b];
+                    offsets[k * num_buckets + b] = sum;
+                    sum += c;
+                }
+            }
+            result.starts[num_buckets] = sum;
+        }
+
+        for (std::size_t i = first; i < last; ++i)
+            result.items[count[hashes[i] & (num_buckets - 1)]++] = i;
+    }
+
+    return result;
+}
+
+//! \brief For each item, find the lowest index item with an equal key.
+template<class Key, class Hash>
+std::vector<std::uint32_t> firstOccurrence(const std::vector<Key>& keys,
+                                           const std::vector<std::uint64_t>& hashes)
+{
+    const Buckets buckets = bucketize(hashes);
+    std::vector<std::uint32_t> first(keys.size());
+
+    const int num_buckets = buckets.starts.size() - 1;
+#pragma omp parallel for schedule(dynamic)
+    for (int b = 0; b < num_buckets; ++b) {
+        const auto begin = buckets.items.begin() + buckets.starts[b];
+        const auto end = buckets.items.begin() + buckets.starts[b+1];
+        std::unordered_map<Key, std::uint32_t, Hash> seen;
+        seen.reserve(end - begin);
+        for (auto it = begin; it != end; ++it)
+            first[*it] = seen.try_emplace(keys[*it], *it).first->second;
+    }
+
+    return first;
+}
+
+struct TriangleKeyHash
+{
+    std::size_t operator()(const BVH::IndexedTriangle& tri) const
+    {
+        return mix(mix(mix(tri[0]) ^ tri[1]) ^ tri[2]);
+    }
+};
+
+//! \brief Position, as float bits or quantized, and packed normal of a corner.
+struct VertexKey
+{
+    std::uint32_t x, y, z, normal;
+    bool operator==(const VertexKey&) const = default;
+};
+
+std::uint64_t hashKey(const VertexKey& key)
+{
+    return mix(mix(mix(mix(key.x) ^ key.y) ^ key.z) ^ key.normal);
+}
+
+struct VertexKeyHash
+{
+    std::size_t operator()(const VertexKey& key) const { return hashKey(key); }
+};
+
+//! \brief Maps positions to a 16 bit grid over bounds.
+struct Quantizer
+{
+    std::array<float,3> lower{}, inv_scale{};
+
+    Quantizer() = default;
+
+    Quantizer(MeshIndexer::PackedMesh& mesh, const std::array<float,3>& lower,
+              const std::array<float,3>& upper)
+        : lower(lower)
+    {
+        for (int a = 0; a < 3; ++a) {
+            const float extent = upper[a] - lower[a];
+            mesh.offset[a] = lower[a];
+            mesh.scale[a] = extent > 0.0f ? extent / 65535.0f : 1.0f;
+            inv_scale[a] = 1.0f / mesh.scale[a];
+        }
+    }
+
+    std::uint16_t operator()(float v, int axis) const
+    {
+        const float q = std::round((v - lower[axis]) * inv_scale[axis]);
+        return static_cast<std::uint16_t>(std::min(std::max(q, 0.0f), 65535.0f));
+    }
+};
+
+//! \brief Bounds of the vertices of count items, with vertex(i, j, v) storing
+//!         vertex j of item i in v.
+template<class Vertex>
+void bounds(std::size_t count, int corners, Vertex&& vertex,
+            std::array<float,3>& lower, std::array<float,3>& upper)
+{
+    float min_x = std::numeric_limits<float>::max(), max_x = -min_x;
+    float min_y = min_x, max_y = max_x, min_z = min_x, max_z = max_x;
+    const std::int64_t n = count;
+#pragma omp parallel for reduction(min : min_x, min_y, min_z) reduction(max : max_x, max_y, max_z)
+    for (std::int64_t i = 0; i < n; ++i)
+        for (int j = 0; j < corners; ++j) {
+            float v[3];
+            vertex(i, j, v);
+            min_x = std::min(min_x, v[0]);
+            max_x = std::max(max_x, v[0]);
+            min_y = std::min(min_y, v[1]);
+            max_y = std::max(max_y, v[1]);
+            min_z = std::min(min_z, v[2]);
+            max_z = std::max(max_z, v[2]);
+        }
+    lower = {min_x, min_y, min_z};
+    upper = {max_x, max_y, max_z};
+}
+
+}
+
+namespace MeshIndexer {
+
+BVH::IndexedMesh weld(const std::vector<BVH::Triangle>& tris, float tolerance)
+{
+    const std::size_t num_corners = 3 * tris.size();
+    if (num_corners >= std::numeric_limits<std::uint32_t>::max())
+        throw std::runtime_error(fmt::format("Too many triangles to index: {}",
+                                             tris.size()));
+
+    const int num_tris = tris.size();
+    std::vector<CellKey> keys(num_corners);
+    std::vector<std::uint64_t> hashes(num_corners);
+#pragma omp parallel for
+    for (int i = 0; i < num_tris; ++i)
+        for (int j = 0; j < 3; ++j) {
+            keys[3*i+j] = cellKey(tris[i].vertices[j], tolerance);
+            hashes[3*i+j] = hashKey(keys[3*i+j]);
+        }
+
+    // Each corner is represented by the first corner in the same cell
+    const std::vector<std::uint32_t> rep = firstOccurrence<CellKey, CellKeyHash>(keys, hashes);
+    keys = {};
+
+    // Orientation independent triangle keys, degenerate triangles get an empty key
+    std::vector<BVH::IndexedTriangle> tri_keys(num_tris);
+    std::vector<std::uint64_t> tri_hashes(num_tris);
+#pragma omp parallel for
+    for (int i = 0; i < num_tris; ++i) {
+        BVH::IndexedTriangle key{rep[3*i], rep[3*i+1], rep[3*i+2]};
+        std::sort(key.begin(), key.end());
+        const Vector4 p0 = tris[rep[3*i] / 3].vertices[rep[3*i] % 3];
+        const Vector4 p1 = tris[rep[3*i+1] / 3].vertices[rep[3*i+1] % 3];
+        const Vector4 p2 = tris[rep[3*i+2] / 3].vertices[rep[3*i+2] % 3];
+        const bool degenerate = key[0] == key[1] || key[1] == key[2] ||
+                                (p1 - p0).cross3(p2 - p0).length3() == 0.0f;
+        tri_keys[i] = degenerate ? BVH::IndexedTriangle{} : key;
+        tri_hashes[i] = TriangleKeyHash()(tri_keys[i]);
+    }
+
+    const std::vector<std::uint32_t> first_tri =
+        firstOccurrence<BVH::IndexedTriangle, TriangleKeyHash>(tri_keys, tri_hashes);
+
+    // Keep the first copy of every non-degenerate triangle.
+    // Vertex ids are one-based while numbering, zero marks unreferenced corners.
+    std::vector<std::uint32_t> kept;
+    kept.reserve(num_tris);
+    std::vector<std::uint32_t> vertex_id(num_corners, 0);
+    for (int i = 0; i < num_tris; ++i)
+        if (first_tri[i] == static_cast<std::uint32_t>(i) && tri_keys[i][0] != tri_keys[i][1]) {
+            kept.push_back(i);
+            for (int j = 0; j < 3; ++j)
+                vertex_id[rep[3*i+j]] = 1;
+        }
+
+    // Number the referenced vertices in order of first appearance
+    std::uint32_t num_vertices = 0;
+    for (auto& id : vertex_id)
+        id = id ? num_vertices++ + 1 : 0;
+
+    BVH::IndexedMesh result;
+    result.vertices.resize(num_vertices);
+    result.triangles.resize(kept.size());
+
+    const int num_kept = kept.size();
+#pragma omp parallel for
+    for (int k = 0; k < num_kept; ++k)
+        for (int j = 0; j < 3; ++j)
+            result.triangles[k][j] = vertex_id[rep[3*kept[k]+j]] - 1;
+
+#pragma omp parallel for
+    for (std::size_t c = 0; c < num_corners; ++c)
+        if (vertex_id[c]) {
+            const Vector4& v = tris[c / 3].vertices[c % 3];
+            result.vertices[vertex_id[c] - 1] = {v.x, v.y, v.z};
+        }
+
+    return result;
+}
+
+std::size_t PackedMesh::numVertices() const
+{
+    return quantized.empty() ? positions.size() / 3 : quantized.size() / 4;
+}
+
+std::size_t PackedMesh::bytes() const
+{
+    return positions.size() * sizeof(float) + quantized.size() * sizeof(std::uint16_t)
+         + normals.size() * sizeof(std::uint32_t) + indices.size() * sizeof(std::uint32_t);
+}
+
+std::uint32_t packNormal(float x, float y, float z)
+{
+    auto component = [](float c) {
+        const float q = std::round(std::min(std::max(c, -1.0f), 1.0f) * 511.0f);
+        return static_cast<std::uint32_t>(static_cast<std::int32_t>(q)) & 0x3FFu;
+    };
+    return component(x) | component(y) << 10 | component(z) << 20;
+}
+
+PackedMesh pack(const std::vector<BVH::Triangle>& tris, bool quantize)
+{
+    const std::size_t num_corners = 3 * tris.size();
+    if (num_corners >= std::numeric_limits<std::uint32_t>::max())
+        throw std::runtime_error(fmt::format("Too many triangles to index: {}",
+                                             tris.size()));
+
+    PackedMesh result;
+    Quantizer quantizer;
+    if (quantize) {
+        std::array<float,3> lower{}, upper{};
+        bounds(tris.size(), 3, [&tris](std::size_t i, int j, float* v) {
+            const Vector4& p = tris[i].vertices[j];
+            v[0] = p.x;
+            v[1] = p.y;
+            v[2] = p.z;
+        }, lower, upper);
+        quantizer = Quantizer(result, lower, upper);
+    }
+
+    // Corners are keyed by their position as stored, and their face normal
+    const int num_tris = tris.size();
+    std::vector<VertexKey> keys(num_corners);
+    std::vector<std::uint64_t> hashes(num_corners);
+#pragma omp parallel for
+    for (int i = 0; i < num_tris; ++i) {
+        const auto& v = tris[i].vertices;
+        Vector4 n = (v[1] - v[0]).cross3(v[2] - v[0]);
+        const float length = n.length3();
+        n = length > 0.0f ? n / length : Vector4(0.0f);
+        const std::uint32_t normal = packNormal(n.x, n.y, n.z);
+        for (int j = 0; j < 3; ++j) {
+            VertexKey& key = keys[3*i+j];
+            if (quantize)
+                key = {quantizer(v[j].x, 0), quantizer(v[j].y, 1), quantizer(v[j].z, 2), normal};
+            else
+                key = {std::bit_cast<std::uint32_t>(v[j].x + 0.0f),
+                       std::bit_cast<std::uint32_t>(v[j].y + 0.0f),
+                       std::bit_cast<std::uint32_t>(v[j].z + 0.0f), normal};
+            hashes[3*i+j] = hashKey(key);
+        }
+    }
+
+    const std::vector<std::uint32_t> rep = firstOccurrence<VertexKey, VertexKeyHash>(keys, hashes);
+    hashes = {};
+
+    // Number the vertices in order of first appearance
+    std::vector<std::uint32_t> vertex_id(num_corners);
+    std::uint32_t num_vertices = 0;
+    for (std::size_t c = 0; c < num_corners; ++c)
+        if (rep[c] == c)
+            vertex_id[c] = num_vertices++;
+
+    result.indices.resize(num_corners);
+    result.normals.resize(num_vertices);
+    if (quantize)
+        result.quantized.resize(4 * std::size_t(num_vertices));
+    else
+        result.positions.resize(3 * std::size_t(num_vertices));
+
+    const std::int64_t n = num_corners;
+#pragma omp parallel for
+    for (std::int64_t c = 0; c < n; ++c) {
+        result.indices[c] = vertex_id[rep[c]];
+        if (rep[c] != c)
+            continue;
+        const VertexKey& key = keys[c];
+        const std::size_t id = vertex_id[c];
+        result.normals[id] = key.normal;
+        if (quantize) {
+            result.quantized[4*id] = key.x;
+            result.quantized[4*id+1] = key.y;
+            result.quantized[4*id+2] = key.z;
+            result.quantized[4*id+3] = 0;
+        } else {
+            const Vector4& v = tris[c / 3].vertices[c % 3];
+            result.positions[3*id] = v.x;
+            result.positions[3*id+1] = v.y;
+            result.positions[3*id+2] = v.z;
+        }
+    }
+
+    return result;
+}
+
+PackedMesh pack(const BVH::IndexedMesh& mesh, bool quantize)
+{
+    PackedMesh result;
+    const std::int64_t num_vertices = mesh.vertices.size();
+    if (quantize) {
+        std::array<float,3> lower{}, upper{};
+        bounds(mesh.vertices.size(), 1, [&mesh](std::size_t i, int, float* v) {
+            for (int a = 0; a < 3; ++a)
+                v[a] = mesh.vertices[i][a];
+        }, lower, upper);
+        const Quantizer quantizer(result, lower, upper);
+        result.quantized.resize(4 * mesh.vertices.size());
+#pragma omp parallel for
+        for (std::int64_t i = 0; i < num_vertices; ++i) {
+            for (int a = 0; a < 3; ++a)
+                result.quantized[4*i+a] = quantizer(mesh.vertices[i][a], a);
+            result.quantized[4*i+3] = 0;
+        }
+    } else {
+        result.positions.resize(3 * mesh.vertices.size());
+#pragma omp parallel for
+        for (std::int64_t i = 0; i < num_vertices; ++i)
+            for (int a = 0; a < 3; ++a)
+                result.positions[3*i+a] = mesh.vertices[i][a];
+    }
+
+    result.indices.resize(3 * mesh.triangles.size());
+    const std::int64_t num_tris = mesh.triangles.size();
+#pragma omp parallel for
+    for (std::int64_t i = 0; i < num_tris; ++i)
+        for (int j = 0; j < 3; ++j)
+            result.indices[3*i+j] = mesh.triangles[i][j];
+
+    return result;
+}
+
+std::size_t cluster(const std::vector<std::array<float,3>>& points, float cell_size,
+                    std::vector<std::uint32_t>& clusters)
+{
+    if (points.size() >= std::numeric_limits<std::uint32_t>::max())
+        throw std::runtime_error(fmt::format("Too many points to cluster: {}", points.size()));
+
+    const std::int64_t n = points.size();
+    std::vector<CellKey> keys(n);
+    std::vector<std::uint64_t> hashes(n);
+#pragma omp parallel for
+    for (std::int64_t i = 0; i < n; ++i) {
+        keys[i] = cellKey(Vector4(points[i][0], points[i][1], points[i][2]), cell_size);
+        hashes[i] = hashKey(keys[i]);
+    }
+
+    const std::vector<std::uint32_t> rep = firstOccurrence<CellKey, CellKeyHash>(keys, hashes);
+
+    clusters.resize(n);
+    std::uint32_t num_clusters = 0;
+    for (std::int64_t i = 0; i < n; ++i)
+        clusters[i] = rep[i] == i ? num_clusters++ : clusters[rep[i]];
+    return num_clusters;
+}
+
+std::vector<BVH::Triangle> expand(const BVH::IndexedMesh& mesh)
+{
+    std::vector<BVH::Triangle> tris(mesh.triangles.size());
+    const int num_tris = tris.size();
+#pragma omp parallel for
+    for (int i = 0; i < num_tris; ++i)
+        tris[i] = mesh.triangle(mesh.triangles[i]);
+
+    return tris;
+}
+
+}
@@ -0,0 +1,73 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#ifndef WALDO_INDEX_MESH_HPP_
+#define WALDO_INDEX_MESH_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace BVH {
+    struct Triangle;
+    struct IndexedMesh;
+}
+
+namespace MeshIndexer {
+    //! \brief Weld the vertices of a triangle soup into an indexed mesh.
+    //! \details Vertices snapping to the same grid cell of size tolerance
+    //!          are merged. Triangles which become degenerate and duplicated
+    //!          triangles (regardless of orientation) are dropped, as are
+    //!          vertices which are no longer referenced.
+    //! \param[in] tris Triangle soup to weld
+    //! \param[in] tolerance Welding tolerance, 0 for exact matches only
+    BVH::IndexedMesh weld(const std::vector<BVH::Triangle>& tris,
+                          float tolerance = 0.0f);
+
+    //! \brief Group points by the grid cell of size cell_size they fall in.
+    //! \param[out] clusters Cluster of each point, numbered in order of first appearance
+    //! \return Number of clusters
+    std::size_t cluster(const std::vector<std::array<float,3>>& points, float cell_size,
+                        std::vector<std::uint32_t>& clusters);
+
+    //! \brief Expand an indexed mesh back into a triangle soup.
+    std::vector<BVH::Triangle> expand(const BVH::IndexedMesh& mesh);
+
+    //! \brief Shared-vertex mesh packed for drawing.
+    //! \details Positions are floats, or 16 bit integers on a grid over the
+    //!          bounds of the mesh when quantized.
+    struct PackedMesh
+    {
+        std::vector<float> positions;          //!< x, y, z per vertex, if not quantized
+        std::vector<std::uint16_t> quantized;  //!< x, y, z and 0 per vertex, if quantized
+        std::array<float,3> offset{};          //!< Position is offset + scale * stored position
+        std::array<float,3> scale{1.0f, 1.0f, 1.0f};
+        std::vector<std::uint32_t> normals;    //!< Per vertex as from packNormal, may be empty
+        std::vector<std::uint32_t> indices;    //!< 3 per triangle
+
+        std::size_t numVertices() const;
+
+        //! \brief Size of the vertex and index data.
+        std::size_t bytes() const;
+    };
+
+    //! \brief Pack a unit vector as signed normalized 10-10-10-2 integers.
+    //! \details x is in the lowest bits and w is 0, the layout of
+    //!          GL_INT_2_10_10_10_REV.
+    std::uint32_t packNormal(float x, float y, float z);
+
+    //! \brief Pack a triangle soup with flat shading normals.
+    //! \details The normals are computed from the geometry. Corners with the
+    //!          same position and packed normal share a vertex.
+    PackedMesh pack(const std::vector<BVH::Triangle>& tris, bool quantize);
+
+    //! \brief Pack an indexed mesh, without normals.
+    PackedMesh pack(const BVH::IndexedMesh& mesh, bool quantize);
+};
+
+#endif
@@ -0,0 +1,256 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "LoadPipeline.hpp"
+#include "IndexMesh.hpp"
+
+#include <fmt/format.h>
+
+#include <future>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+const char* stageName(LoadPipeline::Stage stage)
+{
+    switch (stage) {
+    case LoadPipeline::Stage::Loading:  return "Loading";
+    case LoadPipeline::Stage::Welding:  return "Welding";
+    case LoadPipeline::Stage::Simplifying: return "Simplifying";
+    case LoadPipeline::Stage::Building: return "Building tree";
+    case LoadPipeline::Stage::Done:     return "Done";
+    case LoadPipeline::Stage::Failed:   return "Failed";
+    case LoadPipeline::Stage::Cancelled: return "Cancelled";
+    }
+    return "";
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+//! \brief Every n'th triangle of the mesh, with at most max_tris triangles.
+std::shared_ptr<LoadPipeline::Scene>
+sample(const LoadPipeline::Mesh& mesh, std::size_t max_tris)
+{
+    auto scene = std::make_shared<LoadPipeline::Scene>();
+    scene->coarse = true;
+
+    const bool indexed = !mesh.indexed.triangles.empty();
+    const std::size_t size = indexed ? mesh.indexed.triangles.size() : mesh.tris.size();
+    const std::size_t stride = (size + max_tris - 1) / max_tris;
+    scene->tris.reserve(size / stride + 1);
+    for (std::size_t i = 0; i < size; i += stride) {
+        scene->tris.push_back(indexed ? mesh.indexed.triangle(mesh.indexed.triangles[i])
+                                      : mesh.tris[i]);
+        if (mesh.normals.size() == size)
+            scene->normals.push_back(mesh.normals[i]);
+    }
+    return scene;
+}
+
+//! \brief Levels of detail and the trees referencing them.
+struct Levels
+{
+    std::vector<Simplify::Level> lods;
+    std::vector<std::unique_ptr<BVH::IndexedAABBTree>> trees;
+};
+
+}
+
+LoadPipeline::LoadPipeline(Loader loader)
+    : LoadPipeline(std::move(loader), Options{})
+{}
+
+LoadPipeline::LoadPipeline(Loader loader, const Options& options)
+    : m_options(options),
+      m_start(std::chrono::steady_clock::now())
+{
+    m_thread = std::thread(&LoadPipeline::run, this, std::move(loader));
+}
+
+LoadPipeline::~LoadPipeline()
+{
+    cancel();
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+void LoadPipeline::run(Loader loader)
+{
+    std::future<void> coarse;
+    std::future<Levels> levels;
+    try {
+        auto start = std::chrono::steady_clock::now();
+        Mesh input = loader(m_cancel);
+        addTiming("load", start);
+        checkCancel();
+
+        const std::size_t size = input.indexed.triangles.empty() ? input.tris.size()
+                                                                  : input.indexed.triangles.size();
+        if (size == 0)
+            throw std::runtime_error("Mesh has no triangles");
+        if (m_options.coarse_triangles > 0 && size > m_options.coarse_triangles) {
+            // Sampled before the full build reorders the triangles
+            auto scene = sample(input, m_options.coarse_triangles);
+            coarse = std::async(std::launch::async, [this, scene]
+            {
+                const auto start = std::chrono::steady_clock::now();
+                scene->tree = std::make_unique<BVH::AABBTree>(scene->tris, m_options.aabb_expansion, m_cancel);
+                addTiming("coarse tree", start);
+                publish(scene);
+            });
+        }
+
+        auto scene = std::make_shared<Scene>();
+        // Decided up front: welding can leave an indexed mesh without triangles
+        const bool indexed = !input.indexed.triangles.empty() || m_options.weld_tolerance >= 0.0f;
+        if (!input.indexed.triangles.empty()) {
+            scene->mesh = std::move(input.indexed);
+        } else if (m_options.weld_tolerance >= 0.0f) {
+            setStage(Stage::Welding);
+            start = std::chrono::steady_clock::now();
+            scene->mesh = MeshIndexer::weld(input.tris, m_options.weld_tolerance);
+            input = {};
+            addTiming("weld", start);
+            checkCancel();
+            if (scene->mesh.triangles.empty())
+                throw std::runtime_error("Welded mesh has no triangles");
+        } else {
+            scene->tris = std::move(input.tris);
+            scene->normals = std::move(input.normals);
+        }
+
+        if (m_options.lod_levels > 0) {
+            // The full build reorders the triangles while the levels are
+            // simplified, so they start from a copy in the original order
+            levels = std::async(std::launch::async, [this, indexed, tris = scene->tris, mesh = scene->mesh]
+            {
+                const auto start = std::chrono::steady_clock::now();
+                const BVH::IndexedMesh welded = indexed ? mesh : MeshIndexer::weld(tris);
+                Levels result;
+                result.lods = Simplify::cachedLevels(m_options.lod_cache, welded, m_options.lod_levels);
+                // The trees reference the meshes, so only once the levels are final
+                for (auto& level : result.lods) {
+                    checkCancel();
+                    result.trees.push_back(
+                        std::make_unique<BVH::IndexedAABBTree>(level.mesh, m_options.aabb_expansion, m_cancel));
+                }
+                addTiming("lod", start);
+                return result;
+            });
+        }
+
+        setStage(Stage::Building);
+        start = std::chrono::steady_clock::now();
+        if (indexed)
+            scene->indexed_tree = std::make_unique<BVH::IndexedAABBTree>(scene->mesh, m_options.aabb_expansion,
+                                                                         m_cancel);
+        else
+            scene->tree = std::make_unique<BVH::AABBTree>(scene->tris, m_options.aabb_expansion, m_cancel);
+        addTiming("tree", start);
+
+        if (levels.valid()) {
+            setStage(Stage::Simplifying);
+            // Moving the vectors keeps the levels where their trees point
+            Levels result = levels.get();
+            scene->lods = std::move(result.lods);
+            scene->lod_trees = std::move(result.trees);
+        }
+        if (coarse.valid())
+            coarse.get();
+        checkCancel();
+        publish(scene);
+        setStage(Stage::Done);
+    } catch (...) {
+        if (coarse.valid())
+            coarse.wait();
+        if (levels.valid())
+            levels.wait();
+        std::lock_guard lock(m_mutex);
+        if (m_cancel) {
+            m_stage = Stage::Cancelled;
+        } else {
+            m_error = std::current_exception();
+            m_stage = Stage::Failed;
+        }
+    }
+}
+
+void LoadPipeline::publish(std::shared_ptr<const Scene> scene)
+{
+    std::lock_guard lock(m_mutex);
+    // A late coarse tree must not replace the full one
+    if (!m_scene || m_scene->coarse)
+        m_scene = std::move(scene);
+}
+
+void LoadPipeline::setStage(Stage stage)
+{
+    std::lock_guard lock(m_mutex);
+    m_stage = stage;
+}
+
+void LoadPipeline::checkCancel() const
+{
+    if (m_cancel)
+        throw std::runtime_error("Loading cancelled");
+}
+
+void LoadPipeline::addTiming(std::string name, std::chrono::steady_clock::time_point start)
+{
+    const double seconds = secondsSince(start);
+    std::lock_guard lock(m_mutex);
+    m_timings.push_back({std::move(name), seconds});
+}
+
+std::shared_ptr<const LoadPipeline::Scene> LoadPipeline::latest() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_scene;
+}
+
+LoadPipeline::Stage LoadPipeline::stage() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_stage;
+}
+
+std::vector<LoadPipeline::StageTiming> LoadPipeline::timings() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_timings;
+}
+
+std::string LoadPipeline::status() const
+{
+    std::lock_guard lock(m_mutex);
+    std::string result = fmt::format("{}, {:.1f} s", stageName(m_stage), secondsSince(m_start));
+    if (m_stage == Stage::Done || m_stage == Stage::Failed || m_stage == Stage::Cancelled)
+        for (const auto& timing : m_timings)
+            result += fmt::format(", {} {:.2f} s", timing.name, timing.seconds);
+    else if (m_scene && m_scene->coarse)
+        result += ", coarse tree ready";
+    return result;
+}
+
+void LoadPipeline::cancel()
+{
+    m_cancel = true;
+}
+
+std::shared_ptr<const LoadPipeline::Scene> LoadPipeline::wait()
+{
+    if (m_thread.joinable())
+        m_thread.join();
+    std::lock_guard lock(m_mutex);
+    if (m_error)
+        std::rethrow_exception(m_error);
+    return m_scene;
+}
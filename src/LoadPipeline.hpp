@@ -0,0 +1,149 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#ifndef WALDO_LOAD_PIPELINE_HPP_
+#define WALDO_LOAD_PIPELINE_HPP_
+
+#include "bvh.hpp"
+#include "Simplify.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//! \brief Loads a mesh and builds its tree on a background thread.
+//! \details A coarse tree over a subsample of the triangles is built
+//!          concurrently with welding and the full build, and published
+//!          as soon as it is ready so rendering can start early. The levels
+//!          of detail are simplified and built concurrently with the full
+//!          tree. The full scene replaces the coarse one when done.
+//!
+//!          Loading, welding and building the full tree each need all of
+//!          the output of the stage before, so they run in turn, each
+//!          parallel within itself. Parsing runs in parallel chunks inside
+//!          the readers.
+//!
+//!          cancel() stops the pipeline at the next check. The loader is
+//!          passed the flag, and the pipeline checks it between stages and
+//!          while building trees.
+class LoadPipeline
+{
+public:
+    enum class Stage { Loading, Welding, Simplifying, Building, Done, Failed, Cancelled };
+
+    //! \brief Loader output, either a triangle soup or an indexed mesh.
+    struct Mesh
+    {
+        std::vector<BVH::Triangle> tris;
+        std::vector<std::array<float,3>> normals; //!< Optional per-triangle normals
+        BVH::IndexedMesh indexed;
+    };
+
+    //! \brief Reads the mesh, and may return early once cancel is set.
+    using Loader = std::function<Mesh(const std::atomic<bool>& cancel)>;
+
+    struct Options
+    {
+        float weld_tolerance = -1.0f;           //!< Weld soups if non-negative, for an indexed tree
+        float aabb_expansion = 0.001f;          //!< Bounding box expansion, as for BVH::AABBTree
+        std::size_t coarse_triangles = 1 << 16; //!< Triangles in the coarse tree, 0 to disable
+        int lod_levels = 0;                     //!< Most levels of detail to build
+        std::string lod_cache;                  //!< File caching the levels of detail, empty for none
+    };
+
+    //! \brief Mesh data and the tree referencing it.
+    //! \details Exactly one of the trees is set. The soup tree reorders
+    //!          \ref tris but not \ref normals.
+    struct Scene
+    {
+        bool coarse = false;
+        std::vector<BVH::Triangle> tris;
+        std::vector<std::array<float,3>> normals;
+        BVH::IndexedMesh mesh;
+        std::unique_ptr<BVH::AABBTree> tree;
+        std::unique_ptr<BVH::IndexedAABBTree> indexed_tree;
+        std::vector<Simplify::Level> lods;      //!< Levels of detail, coarser with the index
+        std::vector<std::unique_ptr<BVH::IndexedAABBTree>> lod_trees; //!< A tree per level of detail
+
+        //! \brief Call a function with the tree of the scene.
+        template <class Function>
+        decltype(auto) visit(Function&& f) const
+        {
+            if (indexed_tree)
+                return f(*indexed_tree);
+            return f(*tree);
+        }
+    };
+
+    struct StageTiming
+    {
+        std::string name;
+        double seconds;
+    };
+
+    //! \brief Start loading with default options.
+    explicit LoadPipeline(Loader loader);
+
+    //! \brief Start loading.
+    //! \param[in] loader Function reading the mesh, run on the background thread
+    //! \param[in] options Pipeline options
+    LoadPipeline(Loader loader, const Options& options);
+
+    //! \brief Cancels and waits for the background thread.
+    ~LoadPipeline();
+
+    LoadPipeline(const LoadPipeline&) = delete;
+    LoadPipeline& operator=(const LoadPipeline&) = delete;
+
+    //! \brief Returns the most refined scene available, or null.
+    std::shared_ptr<const Scene> latest() const;
+
+    Stage stage() const;
+
+    //! \brief Returns the durations of the finished stages.
+    std::vector<StageTiming> timings() const;
+
+    //! \brief Returns a one line description of the progress.
+    std::string status() const;
+
+    //! \brief Wait for the full scene.
+    //! \details Rethrows the error if loading failed. After cancel() returns
+    //!          the scene published so far, which may be coarse or null.
+    std::shared_ptr<const Scene> wait();
+
+    //! \brief Ask the background thread to stop early.
+    void cancel();
+
+private:
+    void run(Loader loader);
+    void publish(std::shared_ptr<const Scene> scene);
+    void setStage(Stage stage);
+    void addTiming(std::string name, std::chrono::steady_clock::time_point start);
+    void checkCancel() const;
+
+    Options m_options;
+    std::chrono::steady_clock::time_point m_start;
+
+    mutable std::mutex m_mutex;
+    Stage m_stage = Stage::Loading;
+    std::shared_ptr<const Scene> m_scene;
+    std::vector<StageTiming> m_timings;
+    std::exception_ptr m_error;
+    std::atomic<bool> m_cancel{false};
+
+    std::thread m_thread;
+};
+
+#endif
@@ -0,0 +1,105 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "MappedFile.hpp"
+
+#include <fmt/format.h>
+
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define WALDO_HAVE_MMAP
+#endif
+
+MappedFile::MappedFile(std::string_view path, bool sequential)
+    : MappedFile(path, sequential, false)
+{}
+
+MappedFile MappedFile::writable(std::string_view path)
+{
+    return MappedFile(path, true, true);
+}
+
+MappedFile::MappedFile(std::string_view path, bool sequential, bool writable)
+    : m_writable(writable), m_path(path)
+{
+    const std::filesystem::path fs_path(path);
+#ifdef WALDO_HAVE_MMAP
+    const int fd = ::open(fs_path.c_str(), writable ? O_RDWR : O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error(fmt::format("Error opening {}", path));
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error(fmt::format("Error opening {}", path));
+    }
+    m_size = st.st_size;
+
+    if (m_size > 0) {
+        void* ptr = writable ? ::mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+                             : ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (ptr != MAP_FAILED) {
+            ::madvise(ptr, m_size, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+            m_data = static_cast<const char*>(ptr);
+            m_mapped = true;
+        }
+    }
+    ::close(fd);
+    if (m_mapped || m_size == 0)
+        return;
+#endif
+
+    std::ifstream file(fs_path, std::ios::binary);
+    if (!file)
+        throw std::runtime_error(fmt::format("Error opening {}", path));
+
+    m_buffer.resize(std::filesystem::file_size(fs_path));
+    file.read(m_buffer.data(), m_buffer.size());
+    if (!file)
+        throw std::runtime_error(fmt::format("Error reading {}", path));
+
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+}
+
+MappedFile::~MappedFile()
+{
+    if (m_writable && !m_mapped) {
+        try {
+            sync();
+        } catch (...) {
+        }
+    }
+#ifdef WALDO_HAVE_MMAP
+    if (m_mapped)
+        ::munmap(const_cast<char*>(m_data), m_size);
+#endif
+}
+
+void MappedFile::sync()
+{
+    if (!m_writable)
+        return;
+#ifdef WALDO_HAVE_MMAP
+    if (m_mapped) {
+        if (::msync(const_cast<char*>(m_data), m_size, MS_SYNC) != 0)
+            throw std::runtime_error(fmt::format("Error writing {}", m_path));
+        return;
+    }
+#endif
+    std::ofstream file(std::filesystem::path(m_path), std::ios::binary | std::ios::in);
+    file.write(m_buffer.data(), m_buffer.size());
+    if (!file)
+        throw std::runtime_error(fmt::format("Error writing {}", m_path));
+}
@@ -0,0 +1,56 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#ifndef WALDO_MAPPED_FILE_HPP_
+#define WALDO_MAPPED_FILE_HPP_
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//! \brief View of a whole file.
+//! \details Uses mmap where available, otherwise reads the file into memory.
+class MappedFile
+{
+public:
+    //! \brief Map a file read-only.
+    //! \param[in] path Path to file to map
+    //! \param[in] sequential True to hint sequential access, false for random access
+    explicit MappedFile(std::string_view path, bool sequential = true);
+
+    //! \brief Map a file for modification in place.
+    //! \details Changes are written back by \ref sync, or on destruction.
+    //! \param[in] path Path to file to map
+    static MappedFile writable(std::string_view path);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    //! \brief Returns the file contents.
+    std::string_view view() const { return {m_data, m_size}; }
+
+    //! \brief Returns the modifiable file contents, null unless writable.
+    char* data() { return m_writable ? const_cast<char*>(m_data) : nullptr; }
+
+    //! \brief Write changes back to a writable file.
+    void sync();
+
+private:
+    MappedFile(std::string_view path, bool sequential, bool writable);
+
+    const char* m_data = nullptr;
+    std::size_t m_size = 0;
+    bool m_mapped = false;
+    bool m_writable = false;
+    std::string m_path;
+    std::vector<char> m_buffer;
+};
+
+#endif
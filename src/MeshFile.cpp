@@ -0,0 +1,450 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "MeshFile.hpp"
+#include "MappedFile.hpp"
+
+#include "bvh.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+
+static_assert(std::endian::native == std::endian::little,
+              "Mesh files are stored little endian");
+
+namespace {
+
+constexpr char MAGIC[8] = {'W', 'A', 'L', 'D', 'O', 'M', 'S', 'H'};
+constexpr std::uint32_t VERSION = 1;
+constexpr std::uint32_t HAS_NORMALS = 1;
+constexpr std::uint32_t BLOCK_TRIANGLES = 1 << 14;
+
+struct Header
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t position_bits;
+    std::uint32_t flags;
+    std::uint32_t block_triangles;
+    std::uint64_t num_vertices;
+    std::uint64_t num_triangles;
+    float lower[3];
+    float upper[3];
+};
+static_assert(sizeof(Header) == 64);
+
+std::size_t positionSize(std::uint32_t bits)
+{
+    return bits == 16 ? 3 * sizeof(std::uint16_t) : sizeof(std::uint64_t);
+}
+
+std::size_t numBlocks(const Header& header)
+{
+    return (header.num_triangles + header.block_triangles - 1) / header.block_triangles;
+}
+
+void putVarint(std::string& out, std::uint64_t value)
+{
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+std::uint64_t getVarint(const char*& pos, const char* end)
+{
+    std::uint64_t value = 0;
+    for (int shift = 0;; shift += 7) {
+        if (pos == end || shift > 63)
+            throw std::runtime_error("truncated index data");
+        const auto byte = static_cast<std::uint8_t>(*pos++);
+        value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return value;
+    }
+}
+
+// Deltas between 32-bit indices need 33 bits, so 64-bit zigzag values
+std::uint64_t zigzag(std::int64_t delta)
+{
+    return (static_cast<std::uint64_t>(delta) << 1) ^ static_cast<std::uint64_t>(delta >> 63);
+}
+
+std::int64_t unzigzag(std::uint64_t value)
+{
+    return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+}
+
+//! \brief Octahedral encoding of a unit vector into two snorm16 values.
+std::array<std::int16_t,2> encodeNormal(const std::array<float,3>& n)
+{
+    const float len = std::abs(n[0]) + std::abs(n[1]) + std::abs(n[2]);
+    float x = len > 0.0f ? n[0] / len : 0.0f;
+    float y = len > 0.0f ? n[1] / len : 0.0f;
+    if (n[2] < 0.0f) {
+        const float ox = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        const float oy = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = ox;
+        y = oy;
+    }
+    return {static_cast<std::int16_t>(std::lround(std::clamp(x, -1.0f, 1.0f) * 32767.0f)),
+            static_cast<std::int16_t>(std::lround(std::clamp(y, -1.0f, 1.0f) * 32767.0f))};
+}
+
+std::array<float,3> decodeNormal(std::int16_t qx, std::int16_t qy)
+{
+    float x = qx / 32767.0f;
+    float y = qy / 32767.0f;
+    const float z = 1.0f - std::abs(x) - std::abs(y);
+    if (z < 0.0f) {
+        const float ox = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        const float oy = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = ox;
+        y = oy;
+    }
+    const float len = std::sqrt(x * x + y * y + z * z);
+    return {x / len, y / len, z / len};
+}
+
+template<class T>
+T load(const char* ptr)
+{
+    T value;
+    std::memcpy(&value, ptr, sizeof(T));
+    return value;
+}
+
+//! \brief Validated view of an encoded mesh.
+class Decoder
+{
+public:
+    explicit Decoder(std::string_view buffer)
+        : data(buffer)
+    {
+        if (data.size() < sizeof(Header))
+            throw std::runtime_error("file too small");
+        std::memcpy(&header, data.data(), sizeof(Header));
+        if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+            throw std::runtime_error("not a mesh file");
+        if (header.version != VERSION)
+            throw std::runtime_error(fmt::format("unsupported version {}", header.version));
+        if (header.position_bits != 16 && header.position_bits != 21)
+            throw std::runtime_error(fmt::format("unsupported position bits {}",
+                                                 header.position_bits));
+        if (header.block_triangles == 0 ||
+            header.num_vertices > std::numeric_limits<std::uint32_t>::max())
+            throw std::runtime_error("corrupt header");
+        // Every index takes at least a byte, which bounds the counts used below
+        if (header.num_triangles > data.size() / 3)
+            throw std::runtime_error("corrupt header");
+
+        positions = sizeof(Header);
+        blocks = positions + header.num_vertices * positionSize(header.position_bits);
+        indices = blocks + (numBlocks(header) + 1) * sizeof(std::uint64_t);
+        if (indices > data.size())
+            throw std::runtime_error("unexpected end of file");
+        normals = indices + load<std::uint64_t>(data.data() + blocks +
+                                                numBlocks(header) * sizeof(std::uint64_t));
+        const std::size_t normal_size = hasNormals() ? 4 * header.num_triangles : 0;
+        if (normals < indices || normals + normal_size > data.size())
+            throw std::runtime_error("unexpected end of file");
+    }
+
+    bool hasNormals() const { return header.flags & HAS_NORMALS; }
+
+    std::vector<std::array<float,3>> decodeVertices() const
+    {
+        std::vector<std::array<float,3>> vertices(header.num_vertices);
+        const float max_q = (1u << header.position_bits) - 1;
+        float step[3];
+        for (int c = 0; c < 3; ++c)
+            step[c] = (header.upper[c] - header.lower[c]) / max_q;
+
+        const char* src = data.data() + positions;
+        const std::int64_t num_vertices = header.num_vertices;
+        if (header.position_bits == 16) {
+#pragma omp parallel for schedule(static)
+            for (std::int64_t i = 0; i < num_vertices; ++i)
+                for (int c = 0; c < 3; ++c)
+                    vertices[i][c] = header.lower[c] +
+                                     step[c] * load<std::uint16_t>(src + 2 * (3 * i + c));
+        } else {
+#pragma omp parallel for schedule(static)
+            for (std::int64_t i = 0; i < num_vertices; ++i) {
+                const auto packed = load<std::uint64_t>(src + 8 * i);
+                for (int c = 0; c < 3; ++c)
+                    vertices[i][c] = header.lower[c] +
+                                     step[c] * ((packed >> (21 * c)) & 0x1fffff);
+            }
+        }
+
+        return vertices;
+    }
+
+    //! \brief Decode index blocks in parallel, calling emit(i, triangle).
+    template<class Emit>
+    void decodeTriangles(Emit&& emit) const
+    {
+        const std::int64_t num_blocks = numBlocks(header);
+        std::vector<std::exception_ptr> errors(num_blocks);
+#pragma omp parallel for schedule(dynamic, 1)
+        for (std::int64_t b = 0; b < num_blocks; ++b) {
+            try {
+                decodeBlock(b, emit);
+            } catch (...) {
+                errors[b] = std::current_exception();
+            }
+        }
+
+        for (const auto& error : errors)
+            if (error)
+                std::rethrow_exception(error);
+    }
+
+    std::vector<std::array<float,3>> decodeNormals() const
+    {
+        std::vector<std::array<float,3>> result(header.num_triangles);
+        const char* src = data.data() + normals;
+        const std::int64_t num_triangles = header.num_triangles;
+#pragma omp parallel for schedule(static)
+        for (std::int64_t i = 0; i < num_triangles; ++i)
+            result[i] = decodeNormal(load<std::int16_t>(src + 4 * i),
+                                     load<std::int16_t>(src + 4 * i + 2));
+        return result;
+    }
+
+    Header header;
+
+private:
+    template<class Emit>
+    void decodeBlock(std::size_t b, Emit& emit) const
+    {
+        const char* table = data.data() + blocks;
+        const char* pos = data.data() + indices + load<std::uint64_t>(table + 8 * b);
+        const char* end = data.data() + indices + load<std::uint64_t>(table + 8 * (b + 1));
+        if (pos > end || end > data.data() + normals)
+            throw std::runtime_error("corrupt block table");
+
+        const std::size_t first = b * header.block_triangles;
+        const std::size_t last = std::min<std::size_t>(first + header.block_triangles,
+                                                       header.num_triangles);
+        std::int64_t prev = 0;
+        for (std::size_t t = first; t < last; ++t) {
+            BVH::IndexedTriangle tri;
+            for (auto& index : tri) {
+                prev += MeshFile::getDelta(pos, end);
+                if (prev < 0 || static_cast<std::uint64_t>(prev) >= header.num_vertices)
+                    throw std::runtime_error("index out of range");
+                index = prev;
+            }
+            emit(t, tri);
+        }
+    }
+
+    std::string_view data;
+    std::size_t positions, blocks, indices, normals;
+};
+
+}
+
+namespace MeshFile {
+
+void putDelta(std::string& out, std::int64_t delta)
+{
+    putVarint(out, zigzag(delta));
+}
+
+std::int64_t getDelta(const char*& pos, const char* end)
+{
+    return unzigzag(getVarint(pos, end));
+}
+
+std::string encode(const BVH::IndexedMesh& mesh,
+                   const std::vector<std::array<float,3>>& normals,
+                   int position_bits)
+{
+    if (position_bits != 16 && position_bits != 21)
+        throw std::runtime_error(fmt::format("Unsupported position bits {}", position_bits));
+    if (!normals.empty() && normals.size() != mesh.triangles.size())
+        throw std::runtime_error("Need one normal per triangle");
+
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.position_bits = position_bits;
+    header.flags = normals.empty() ? 0 : HAS_NORMALS;
+    header.block_triangles = BLOCK_TRIANGLES;
+    header.num_vertices = mesh.vertices.size();
+    header.num_triangles = mesh.triangles.size();
+
+    float lower[3] = {0.0f, 0.0f, 0.0f};
+    float upper[3] = {0.0f, 0.0f, 0.0f};
+    if (!mesh.vertices.empty()) {
+        std::copy(mesh.vertices[0].begin(), mesh.vertices[0].end(), lower);
+        std::copy(mesh.vertices[0].begin(), mesh.vertices[0].end(), upper);
+    }
+    const std::int64_t num_vertices = mesh.vertices.size();
+#pragma omp parallel for reduction(min:lower[:3]) reduction(max:upper[:3])
+    for (std::int64_t i = 0; i < num_vertices; ++i)
+        for (int c = 0; c < 3; ++c) {
+            lower[c] = std::min(lower[c], mesh.vertices[i][c]);
+            upper[c] = std::max(upper[c], mesh.vertices[i][c]);
+        }
+    std::copy(lower, lower + 3, header.lower);
+    std::copy(upper, upper + 3, header.upper);
+
+    // Positions
+    const std::uint32_t max_q = (1u << position_bits) - 1;
+    double scale[3];
+    for (int c = 0; c < 3; ++c)
+        scale[c] = upper[c] > lower[c] ? max_q / (double(upper[c]) - lower[c]) : 0.0;
+    auto quantize = [&](std::int64_t i, int c) -> std::uint64_t
+    {
+        return std::min<std::uint64_t>(std::llround((mesh.vertices[i][c] - lower[c]) * scale[c]), max_q);
+    };
+
+    std::string positions(num_vertices * positionSize(position_bits), '\0');
+#pragma omp parallel for schedule(static)
+    for (std::int64_t i = 0; i < num_vertices; ++i) {
+        if (position_bits == 16) {
+            for (int c = 0; c < 3; ++c) {
+                const auto q = static_cast<std::uint16_t>(quantize(i, c));
+                std::memcpy(positions.data() + 2 * (3 * i + c), &q, sizeof(q));
+            }
+        } else {
+            const std::uint64_t packed = quantize(i, 0) | quantize(i, 1) << 21 | quantize(i, 2) << 42;
+            std::memcpy(positions.data() + 8 * i, &packed, sizeof(packed));
+        }
+    }
+
+    // Index blocks, delta encoded against the previous index in the block
+    const std::int64_t num_blocks = numBlocks(header);
+    std::vector<std::string> block_data(num_blocks);
+#pragma omp parallel for schedule(dynamic, 1)
+    for (std::int64_t b = 0; b < num_blocks; ++b) {
+        const std::size_t first = std::size_t(b) * BLOCK_TRIANGLES;
+        const std::size_t last = std::min<std::size_t>(first + BLOCK_TRIANGLES,
+                                                       mesh.triangles.size());
+        std::string& out = block_data[b];
+        out.reserve(6 * (last - first));
+        std::int64_t prev = 0;
+        for (std::size_t t = first; t < last; ++t)
+            for (const std::uint32_t index : mesh.triangles[t]) {
+                putDelta(out, std::int64_t(index) - prev);
+                prev = index;
+            }
+    }
+
+    std::vector<std::uint64_t> table(num_blocks + 1, 0);
+    for (std::int64_t b = 0; b < num_blocks; ++b)
+        table[b+1] = table[b] + block_data[b].size();
+
+    std::string result;
+    result.reserve(sizeof(Header) + positions.size() + table.size() * 8 +
+                   table.back() + 4 * normals.size());
+    result.append(reinterpret_cast<const char*>(&header), sizeof(Header));
+    result.append(positions);
+    result.append(reinterpret_cast<const char*>(table.data()), table.size() * 8);
+    for (const std::string& block : block_data)
+        result.append(block);
+
+    const std::size_t normal_offset = result.size();
+    result.resize(result.size() + 4 * normals.size());
+    const std::int64_t num_normals = normals.size();
+#pragma omp parallel for schedule(static)
+    for (std::int64_t i = 0; i < num_normals; ++i) {
+        const auto q = encodeNormal(normals[i]);
+        std::memcpy(result.data() + normal_offset + 4 * i, q.data(), 4);
+    }
+
+    return result;
+}
+
+void write(std::string_view path,
+           const BVH::IndexedMesh& mesh,
+           const std::vector<std::array<float,3>>& normals,
+           int position_bits)
+{
+    const std::string data = encode(mesh, normals, position_bits);
+    std::ofstream file(std::filesystem::path(path), std::ios::binary);
+    file.write(data.data(), data.size());
+    if (!file)
+        throw std::runtime_error(fmt::format("Error writing {}", path));
+}
+
+BVH::IndexedMesh read(std::string_view path,
+                      std::vector<std::array<float,3>>* normals,
+                      bool is_file)
+{
+    std::optional<MappedFile> file;
+    std::string_view buffer = path;
+    if (is_file) {
+        file.emplace(path);
+        buffer = file->view();
+    }
+
+    try {
+        const Decoder decoder(buffer);
+        BVH::IndexedMesh mesh;
+        mesh.vertices = decoder.decodeVertices();
+        mesh.triangles.resize(decoder.header.num_triangles);
+        decoder.decodeTriangles([&mesh](std::size_t i, const BVH::IndexedTriangle& tri)
+                                { mesh.triangles[i] = tri; });
+        if (normals)
+            *normals = decoder.hasNormals() ? decoder.decodeNormals()
+                                            : std::vector<std::array<float,3>>{};
+        return mesh;
+    } catch (const std::exception& e) {
+        throw std::runtime_error(fmt::format("Error reading {}, error = {}",
+                                             is_file ? path : "buffer", e.what()));
+    }
+}
+
+std::tuple<std::vector<BVH::Triangle>,
+           std::vector<std::array<float,3>>>
+readTriangles(std::string_view path, bool is_file)
+{
+    std::optional<MappedFile> file;
+    std::string_view buffer = path;
+    if (is_file) {
+        file.emplace(path);
+        buffer = file->view();
+    }
+
+    try {
+        const Decoder decoder(buffer);
+        const auto vertices = decoder.decodeVertices();
+        std::vector<BVH::Triangle> tris(decoder.header.num_triangles);
+        decoder.decodeTriangles([&tris, &vertices](std::size_t i, const BVH::IndexedTriangle& tri)
+        {
+            for (int j = 0; j < 3; ++j) {
+                const auto& v = vertices[tri[j]];
+                tris[i].vertices[j] = Vector4(v[0], v[1], v[2]);
+            }
+        });
+        return {std::move(tris),
+                decoder.hasNormals() ? decoder.decodeNormals()
+                                     : std::vector<std::array<float,3>>{}};
+    } catch (const std::exception& e) {
+        throw std::runtime_error(fmt::format("Error reading {}, error = {}",
+                                             is_file ? path : "buffer", e.what()));
+    }
+}
+
+}
@@ -0,0 +1,72 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#ifndef WALDO_MESH_FILE_HPP_
+#define WALDO_MESH_FILE_HPP_
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+namespace BVH {
+    struct Triangle;
+    struct IndexedMesh;
+}
+
+//! \brief Compact quantized mesh container (.wmsh).
+//! \details Vertex positions are stored as 16 or 21 bit fixed point within
+//!          the mesh bounds. Indices are zigzag delta encoded varints in
+//!          independent blocks, so they can be decoded in parallel.
+//!          Per-triangle normals are optional and stored octahedral encoded.
+namespace MeshFile {
+    //! \brief Encode a mesh.
+    //! \param[in] mesh Mesh to encode
+    //! \param[in] normals Per-triangle normals, empty to leave them out
+    //! \param[in] position_bits Bits per coordinate, 16 or 21
+    std::string encode(const BVH::IndexedMesh& mesh,
+                       const std::vector<std::array<float,3>>& normals = {},
+                       int position_bits = 21);
+
+    //! \brief Encode a mesh and write it to a file.
+    //! \param[in] path Path to file to write
+    //! \param[in] mesh Mesh to write
+    //! \param[in] normals Per-triangle normals, empty to leave them out
+    //! \param[in] position_bits Bits per coordinate, 16 or 21
+    void write(std::string_view path,
+               const BVH::IndexedMesh& mesh,
+               const std::vector<std::array<float,3>>& normals = {},
+               int position_bits = 21);
+
+    //! \brief Read a mesh file into an indexed mesh.
+    //! \param[in] path Path to file or buffer to read
+    //! \param[out] normals Per-triangle normals if stored, may be null
+    //! \param[in] is_file True if path is a filename
+    BVH::IndexedMesh read(std::string_view path,
+                          std::vector<std::array<float,3>>* normals = nullptr,
+                          bool is_file = true);
+
+    //! \brief Read a mesh file straight into a triangle soup.
+    //! \param[in] path Path to file or buffer to read
+    //! \param[in] is_file True if path is a filename
+    //! \return Triangles and their normals, normals are empty if not stored
+    std::tuple<std::vector<BVH::Triangle>,
+               std::vector<std::array<float,3>>>
+    readTriangles(std::string_view path,
+                  bool is_file = true);
+
+    //! \brief Append an index delta as a zigzag varint, as in the index blocks.
+    void putDelta(std::string& out, std::int64_t delta);
+
+    //! \brief Read a delta written by putDelta and advance pos past it.
+    //! \details Throws std::runtime_error if the varint runs past end.
+    std::int64_t getDelta(const char*& pos, const char* end);
+};
+
+#endif
@@ -0,0 +1,220 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "MeshTransform.hpp"
+
+#include "bvh.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+namespace {
+
+using MeshTransform::Affine;
+using MeshTransform::Stats;
+using MeshTransform::STL_RECORD_SIZE;
+
+using Point = std::array<float,3>;
+
+Point load(const char* ptr)
+{
+    Point p;
+    std::memcpy(p.data(), ptr, sizeof(p));
+    return p;
+}
+
+void store(char* ptr, const Point& p)
+{
+    std::memcpy(ptr, p.data(), sizeof(p));
+}
+
+//! \brief Reduce over the corners of count triangles, corner(i, k) returns corner k of triangle i.
+template <class Corner>
+Stats reduce(std::size_t count, const Affine& transform, Corner corner)
+{
+    double sx = 0.0, sy = 0.0, sz = 0.0;
+    float lx = std::numeric_limits<float>::max(), ly = lx, lz = lx;
+    float ux = std::numeric_limits<float>::lowest(), uy = ux, uz = ux;
+
+    const std::int64_t n = count;
+#pragma omp parallel for reduction(+:sx,sy,sz) reduction(min:lx,ly,lz) reduction(max:ux,uy,uz)
+    for (std::int64_t i = 0; i < n; ++i)
+        for (int k = 0; k < 3; ++k) {
+            const Point p = transform.point(corner(i, k));
+            sx += p[0];
+            sy += p[1];
+            sz += p[2];
+            lx = std::min(lx, p[0]);
+            ly = std::min(ly, p[1]);
+            lz = std::min(lz, p[2]);
+            ux = std::max(ux, p[0]);
+            uy = std::max(uy, p[1]);
+            uz = std::max(uz, p[2]);
+        }
+
+    Stats stats;
+    stats.num_vertices = 3 * count;
+    if (count > 0)
+        stats.mean = {sx / stats.num_vertices, sy / stats.num_vertices, sz / stats.num_vertices};
+    stats.lower = {lx, ly, lz};
+    stats.upper = {ux, uy, uz};
+    return stats;
+}
+
+}
+
+namespace MeshTransform {
+
+Affine Affine::translation(float x, float y, float z)
+{
+    Affine result;
+    result.m[3] = x;
+    result.m[7] = y;
+    result.m[11] = z;
+    return result;
+}
+
+Affine Affine::scaling(float x, float y, float z)
+{
+    Affine result;
+    result.m[0] = x;
+    result.m[5] = y;
+    result.m[10] = z;
+    return result;
+}
+
+Affine Affine::swap(int a, int b)
+{
+    Affine result;
+    result.m[5*a] = 0.0f;
+    result.m[5*b] = 0.0f;
+    result.m[4*a+b] = 1.0f;
+    result.m[4*b+a] = 1.0f;
+    return result;
+}
+
+Affine Affine::then(const Affine& next) const
+{
+    Affine result;
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            float sum = j == 3 ? next.m[4*i+3] : 0.0f;
+            for (int k = 0; k < 3; ++k)
+                sum += next.m[4*i+k] * m[4*k+j];
+            result.m[4*i+j] = sum;
+        }
+    }
+    return result;
+}
+
+Point Affine::point(const Point& p) const
+{
+    return {m[0]*p[0] + m[1]*p[1] + m[2]*p[2] + m[3],
+            m[4]*p[0] + m[5]*p[1] + m[6]*p[2] + m[7],
+            m[8]*p[0] + m[9]*p[1] + m[10]*p[2] + m[11]};
+}
+
+Point Affine::normal(const Point& n) const
+{
+    // Cofactor matrix, the inverse transpose up to the determinant
+    const float c[9] = {m[5]*m[10] - m[6]*m[9], m[6]*m[8] - m[4]*m[10], m[4]*m[9] - m[5]*m[8],
+                        m[2]*m[9] - m[1]*m[10], m[0]*m[10] - m[2]*m[8], m[1]*m[8] - m[0]*m[9],
+                        m[1]*m[6] - m[2]*m[5], m[2]*m[4] - m[0]*m[6], m[0]*m[5] - m[1]*m[4]};
+    const float sign = determinant() < 0.0f ? -1.0f : 1.0f;
+    Point r = {sign * (c[0]*n[0] + c[1]*n[1] + c[2]*n[2]),
+               sign * (c[3]*n[0] + c[4]*n[1] + c[5]*n[2]),
+               sign * (c[6]*n[0] + c[7]*n[1] + c[8]*n[2])};
+    const float len = std::sqrt(r[0]*r[0] + r[1]*r[1] + r[2]*r[2]);
+    if (len > 0.0f)
+        for (float& v : r)
+            v /= len;
+    return r;
+}
+
+float Affine::determinant() const
+{
+    return m[0] * (m[5]*m[10] - m[6]*m[9]) -
+           m[1] * (m[4]*m[10] - m[6]*m[8]) +
+           m[2] * (m[4]*m[9] - m[5]*m[8]);
+}
+
+float Stats::radius() const
+{
+    if (num_vertices == 0)
+        return 0.0f;
+    float result = 0.0f;
+    for (int i = 0; i < 3; ++i)
+        result = std::max({result, float(upper[i] - mean[i]), float(mean[i] - lower[i])});
+    return result;
+}
+
+Stats measure(const char* records, std::size_t count, const Affine& transform)
+{
+    return reduce(count, transform, [records](std::int64_t i, int k)
+    {
+        return load(records + STL_RECORD_SIZE * i + 12 * (k + 1));
+    });
+}
+
+Stats measure(const std::vector<BVH::Triangle>& tris, const Affine& transform)
+{
+    return reduce(tris.size(), transform, [&tris](std::int64_t i, int k)
+    {
+        const Vector4& v = tris[i].vertices[k];
+        return Point{v.x, v.y, v.z};
+    });
+}
+
+void apply(char* records, std::size_t count, const Affine& transform)
+{
+    const bool mirror = transform.determinant() < 0.0f;
+    const std::int64_t n = count;
+#pragma omp parallel for
+    for (std::int64_t i = 0; i < n; ++i) {
+        char* record = records + STL_RECORD_SIZE * i;
+        store(record, transform.normal(load(record)));
+        Point v[3];
+        for (int k = 0; k < 3; ++k)
+            v[k] = transform.point(load(record + 12 * (k + 1)));
+        if (mirror)
+            std::swap(v[1], v[2]);
+        for (int k = 0; k < 3; ++k)
+            store(record + 12 * (k + 1), v[k]);
+    }
+}
+
+void apply(std::vector<BVH::Triangle>& tris, const Affine& transform)
+{
+    const bool mirror = transform.determinant() < 0.0f;
+    const std::int64_t n = tris.size();
+#pragma omp parallel for
+    for (std::int64_t i = 0; i < n; ++i) {
+        for (auto& v : tris[i].vertices) {
+            const Point p = transform.point({v.x, v.y, v.z});
+            v = Vector4(p[0], p[1], p[2]);
+        }
+        if (mirror)
+            std::swap(tris[i].vertices[1], tris[i].vertices[2]);
+    }
+}
+
+Affine center(const Stats& stats)
+{
+    return Affine::translation(-stats.mean[0], -stats.mean[1], -stats.mean[2]);
+}
+
+Affine normalize(const Stats& stats)
+{
+    const float radius = stats.radius();
+    const float scale = radius > 0.0f ? 1.0f / radius : 1.0f;
+    return center(stats).then(Affine::scaling(scale, scale, scale));
+}
+
+}
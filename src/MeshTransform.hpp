@@ -0,0 +1,86 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#ifndef WALDO_MESH_TRANSFORM_HPP_
+#define WALDO_MESH_TRANSFORM_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace BVH { struct Triangle; }
+
+//! \brief Affine transforms of triangle soups and binary STL records.
+//! \details Reductions and transforms each take a single parallel pass.
+//!          Binary STL records are modified in place, so a memory mapped
+//!          file can be transformed without a copy.
+namespace MeshTransform {
+    //! \brief Row major 3x4 affine transform.
+    struct Affine
+    {
+        std::array<float,12> m{1.0f, 0.0f, 0.0f, 0.0f,
+                               0.0f, 1.0f, 0.0f, 0.0f,
+                               0.0f, 0.0f, 1.0f, 0.0f};
+
+        static Affine translation(float x, float y, float z);
+        static Affine scaling(float x, float y, float z);
+
+        //! \brief Exchange two coordinate axes (0 = x, 1 = y, 2 = z).
+        static Affine swap(int a, int b);
+
+        //! \brief Returns the transform applying this, then next.
+        Affine then(const Affine& next) const;
+
+        std::array<float,3> point(const std::array<float,3>& p) const;
+
+        //! \brief Transform a normal by the inverse transpose and normalize it.
+        std::array<float,3> normal(const std::array<float,3>& n) const;
+
+        float determinant() const;
+    };
+
+    //! \brief Vertex statistics, with every triangle corner counted.
+    struct Stats
+    {
+        std::array<double,3> mean{};
+        std::array<float,3> lower{};
+        std::array<float,3> upper{};
+        std::uint64_t num_vertices = 0;
+
+        //! \brief Largest coordinate distance from the mean over all axes.
+        float radius() const;
+    };
+
+    //! \brief Size of a binary STL facet record.
+    constexpr std::size_t STL_RECORD_SIZE = 50;
+
+    //! \brief Statistics of the transformed vertices of binary STL records.
+    //! \param[in] records First facet record, after the 84 byte header
+    //! \param[in] count Number of records
+    //! \param[in] transform Transform applied before measuring
+    Stats measure(const char* records, std::size_t count,
+                  const Affine& transform = {});
+
+    Stats measure(const std::vector<BVH::Triangle>& tris,
+                  const Affine& transform = {});
+
+    //! \brief Transform binary STL records in place.
+    //! \details Normals are transformed as well. Transforms which mirror
+    //!          the mesh swap two corners to keep the winding outward.
+    void apply(char* records, std::size_t count, const Affine& transform);
+
+    void apply(std::vector<BVH::Triangle>& tris, const Affine& transform);
+
+    //! \brief Transform centering the mesh on the mean vertex.
+    Affine center(const Stats& stats);
+
+    //! \brief Transform centering the mesh and scaling it into [-1, 1].
+    Affine normalize(const Stats& stats);
+};
+
+#endif
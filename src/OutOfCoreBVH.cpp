@@ -0,0 +1,802 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "OutOfCoreBVH.hpp"
+#include "ReadSTL.hpp"
+#include "ReadTri.hpp"
+
+#include "bvh.hpp"
+#include "ray_intersection.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+using OutOfCoreBVH::FlatNode;
+using OutOfCoreBVH::PackedTriangle;
+using OutOfCoreBVH::Subtree;
+
+constexpr char MAGIC[8] = {'W', 'A', 'L', 'D', 'O', 'B', 'V', 'H'};
+constexpr std::uint32_t VERSION = 1;
+
+//! \brief Rays report hits with 32-bit primitive indices, so trees hold at most this many triangles.
+constexpr std::uint64_t MAX_TRIANGLES = std::uint64_t(std::numeric_limits<std::uint32_t>::max()) + 1;
+
+//! \brief Sections in the tree file are aligned to this many bytes.
+constexpr std::uint64_t ALIGNMENT = 32;
+
+//! \brief Number of Morton code bits used per bucketing level (fanout 512).
+constexpr int BITS_PER_LEVEL = 9;
+constexpr int MORTON_BITS = 30;
+
+struct FileHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t reserved;
+    std::uint64_t num_triangles;
+    std::uint64_t num_subtrees;
+    std::uint64_t subtree_offset;
+    std::uint64_t num_top_nodes;
+    std::uint64_t top_offset;
+    std::uint64_t padding;
+};
+static_assert(sizeof(FileHeader) == 64);
+static_assert(sizeof(FlatNode) == 32);
+
+PackedTriangle pack(const BVH::Triangle& tri)
+{
+    PackedTriangle result;
+    for (int i = 0; i < 3; ++i)
+        for (int j = 0; j < 3; ++j)
+            result.v[3*i+j] = tri.vertices[i].arr[j];
+    return result;
+}
+
+BVH::Triangle unpack(const PackedTriangle& tri)
+{
+    return {Vector4(tri.v[0], tri.v[1], tri.v[2]),
+            Vector4(tri.v[3], tri.v[4], tri.v[5]),
+            Vector4(tri.v[6], tri.v[7], tri.v[8])};
+}
+
+//! \brief Streams triangles in chunks.
+class TriangleSource
+{
+public:
+    virtual ~TriangleSource() = default;
+
+    //! \brief Read the next chunk, returns false when exhausted.
+    virtual bool next(std::vector<BVH::Triangle>& chunk) = 0;
+};
+
+//! \brief Fixed size records of a binary STL file.
+class BinarySTLSource : public TriangleSource
+{
+public:
+    BinarySTLSource(const std::filesystem::path& path, std::size_t chunk_size)
+        : file(path, std::ios::binary), chunk(chunk_size)
+    {
+        char header[84];
+        file.read(header, sizeof(header));
+        std::uint32_t count;
+        std::memcpy(&count, header + 80, sizeof(count));
+        remaining = count;
+    }
+
+    bool next(std::vector<BVH::Triangle>& tris) override
+    {
+        const std::size_t n = std::min<std::uint64_t>(remaining, chunk);
+        if (n == 0)
+            return false;
+
+        buffer.resize(50 * n);
+        file.read(buffer.data(), buffer.size());
+        if (!file)
+            throw std::runtime_error("unexpected end of file");
+
+        tris.resize(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            float v[9];
+            std::memcpy(v, buffer.data() + 50 * i + 12, sizeof(v));
+            tris[i] = {Vector4(v[0], v[1], v[2]),
+                       Vector4(v[3], v[4], v[5]),
+                       Vector4(v[6], v[7], v[8])};
+        }
+        remaining -= n;
+        return true;
+    }
+
+private:
+    std::ifstream file;
+    std::size_t chunk;
+    std::uint64_t remaining = 0;
+    std::vector<char> buffer;
+};
+
+//! \brief Text blocks cut at a record separator and handed to an in-memory parser.
+class TextSource : public TriangleSource
+{
+public:
+    using Parser = std::vector<BVH::Triangle>(*)(std::string_view);
+
+    TextSource(const std::filesystem::path& path, std::size_t block_size,
+               std::string_view separator, Parser parser)
+        : file(path, std::ios::binary), block(block_size),
+          separator(separator), parser(parser)
+    {}
+
+    bool next(std::vector<BVH::Triangle>& tris) override
+    {
+        while (true) {
+            if (!file)
+                break;
+
+            const std::size_t old_size = carry.size();
+            carry.resize(old_size + block);
+            file.read(carry.data() + old_size, block);
+            carry.resize(old_size + file.gcount());
+
+            const std::size_t found = carry.rfind(separator);
+            if (found != std::string::npos) {
+                const std::size_t end = found + separator.size();
+                tris = parser(std::string_view(carry).substr(0, end));
+                carry.erase(0, end);
+                return true;
+            }
+        }
+
+        if (carry.find_first_not_of(" \t\r\n") == std::string::npos)
+            return false;
+
+        tris = parser(carry);
+        carry.clear();
+        return true;
+    }
+
+private:
+    std::ifstream file;
+    std::size_t block;
+    std::string separator;
+    Parser parser;
+    std::string carry;
+};
+
+//! \brief Triangles spilled to a temporary file.
+struct Spill
+{
+    std::filesystem::path path;
+    std::uint64_t count = 0;
+};
+
+class SpillSource : public TriangleSource
+{
+public:
+    SpillSource(const Spill& spill, std::size_t chunk_size)
+        : file(spill.path, std::ios::binary), chunk(chunk_size), remaining(spill.count)
+    {}
+
+    bool next(std::vector<BVH::Triangle>& tris) override
+    {
+        const std::size_t n = std::min<std::uint64_t>(remaining, chunk);
+        if (n == 0)
+            return false;
+
+        buffer.resize(n);
+        file.read(reinterpret_cast<char*>(buffer.data()), n * sizeof(PackedTriangle));
+        if (!file)
+            throw std::runtime_error("error reading spill file");
+
+        tris.resize(n);
+        std::transform(buffer.begin(), buffer.end(), tris.begin(), unpack);
+        remaining -= n;
+        return true;
+    }
+
+private:
+    std::ifstream file;
+    std::size_t chunk;
+    std::uint64_t remaining;
+    std::vector<PackedTriangle> buffer;
+};
+
+std::unique_ptr<TriangleSource> openInput(std::string_view input, std::size_t chunk_size)
+{
+    const std::filesystem::path path(input);
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        throw std::runtime_error(fmt::format("Error opening {}", input));
+
+    if (path.extension() == ".tri")
+        return std::make_unique<TextSource>(path, 64 * chunk_size, "\n",
+                                            [](std::string_view text)
+                                            { return TriReader::read(text, false); });
+
+    char header[84] = {};
+    file.read(header, sizeof(header));
+    std::uint32_t count;
+    std::memcpy(&count, header + 80, sizeof(count));
+    if (file && 84 + 50 * std::uint64_t(count) == std::filesystem::file_size(path))
+        return std::make_unique<BinarySTLSource>(path, chunk_size);
+
+    if (std::string_view(header, file.gcount()).find("solid") != std::string_view::npos)
+        return std::make_unique<TextSource>(path, 256 * chunk_size, "endfacet",
+                                            [](std::string_view text)
+                                            { return std::get<0>(STLReader::readASCII(text, false)); });
+
+    throw std::runtime_error(fmt::format("Unsupported out-of-core input {}", input));
+}
+
+std::uint32_t expandBits(std::uint32_t v)
+{
+    v = (v * 0x00010001u) & 0xFF0000FFu;
+    v = (v * 0x00000101u) & 0x0F00F00Fu;
+    v = (v * 0x00000011u) & 0xC30C30C3u;
+    v = (v * 0x00000005u) & 0x49249249u;
+    return v;
+}
+
+//! \brief Removes a directory tree when going out of scope.
+struct TempDir
+{
+    explicit TempDir(const std::filesystem::path& parent)
+    {
+        std::random_device rd;
+        path = parent / fmt::format("waldo-bvh-{:08x}", rd());
+        std::filesystem::create_directories(path);
+    }
+
+    ~TempDir()
+    {
+        std::error_code ec;
+        std::filesystem::remove_all(path, ec);
+    }
+
+    std::filesystem::path path;
+};
+
+class Builder
+{
+public:
+    Builder(std::string_view output, const OutOfCoreBVH::BuildOptions& opts)
+        : options(opts),
+          temp(opts.temp_dir.empty() ? std::filesystem::temp_directory_path() : opts.temp_dir),
+          out(std::filesystem::path(output), std::ios::binary)
+    {
+        if (!out)
+            throw std::runtime_error(fmt::format("Error opening {}", output));
+
+        // Everything held in memory while building a subtree
+        const std::size_t bytes_per_triangle = sizeof(BVH::Triangle) + 2 * sizeof(BVH::Node) +
+                                               2 * sizeof(FlatNode) + sizeof(PackedTriangle);
+        max_triangles = std::max<std::size_t>(1, options.memory_budget / bytes_per_triangle);
+        chunk_size = std::clamp<std::size_t>(max_triangles / 4, 1, 1 << 20);
+        bucket_buffer = std::clamp<std::size_t>(options.memory_budget /
+                                                (8 * (1 << BITS_PER_LEVEL) * sizeof(PackedTriangle)),
+                                                16, 4096);
+
+        const FileHeader header{};
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        pos = sizeof(header);
+    }
+
+    void run(std::string_view input)
+    {
+        // First pass: centroid bounds for the Morton codes
+        auto source = openInput(input, chunk_size);
+        std::vector<BVH::Triangle> chunk;
+        lower = Vector4(std::numeric_limits<float>::max());
+        upper = Vector4(std::numeric_limits<float>::lowest());
+        while (source->next(chunk))
+            for (auto& tri : chunk) {
+                scale(tri);
+                lower = lower.min(tri.calc_centroid());
+                upper = upper.max(tri.calc_centroid());
+            }
+
+        // Second pass: spill to buckets, then build them
+        source = openInput(input, chunk_size);
+        processAll(partition(*source, 0, true), 0);
+
+        finish();
+    }
+
+private:
+    void scale(BVH::Triangle& tri) const
+    {
+        for (auto& v : tri.vertices)
+            v = v * options.scale;
+    }
+
+    std::uint32_t morton(const BVH::Triangle& tri) const
+    {
+        const Vector4 extent = upper - lower;
+        std::uint32_t bits[3];
+        const Vector4 c = tri.calc_centroid();
+        for (int i = 0; i < 3; ++i) {
+            const float rel = extent.arr[i] > 0.0f ? (c.arr[i] - lower.arr[i]) / extent.arr[i] : 0.0f;
+            bits[i] = expandBits(std::clamp<std::int64_t>(rel * 1023.0f, 0, 1023));
+        }
+        return bits[0] << 2 | bits[1] << 1 | bits[2];
+    }
+
+    //! \brief Spill triangles to buckets keyed by the Morton bits of a level.
+    std::vector<Spill> partition(TriangleSource& source, int level, bool apply_scale)
+    {
+        const int bits = std::min(BITS_PER_LEVEL, MORTON_BITS - BITS_PER_LEVEL * level);
+        const int shift = MORTON_BITS - BITS_PER_LEVEL * level - bits;
+        const std::size_t num_buckets = std::size_t(1) << bits;
+
+        std::vector<Spill> spills(num_buckets);
+        std::vector<std::ofstream> files(num_buckets);
+        std::vector<std::vector<PackedTriangle>> buffers(num_buckets);
+        auto flush = [&](std::size_t b)
+        {
+            if (!files[b].is_open()) {
+                spills[b].path = temp.path / fmt::format("spill-{}.bin", num_spills++);
+                files[b].open(spills[b].path, std::ios::binary);
+            }
+            files[b].write(reinterpret_cast<const char*>(buffers[b].data()),
+                           buffers[b].size() * sizeof(PackedTriangle));
+            if (!files[b])
+                throw std::runtime_error(fmt::format("Error writing {}", spills[b].path.string()));
+            buffers[b].clear();
+        };
+
+        std::vector<BVH::Triangle> chunk;
+        while (source.next(chunk))
+            for (auto& tri : chunk) {
+                if (apply_scale)
+                    scale(tri);
+                const std::size_t b = (morton(tri) >> shift) & (num_buckets - 1);
+                buffers[b].push_back(pack(tri));
+                ++spills[b].count;
+                if (buffers[b].size() == bucket_buffer)
+                    flush(b);
+            }
+
+        for (std::size_t b = 0; b < num_buckets; ++b)
+            if (!buffers[b].empty())
+                flush(b);
+
+        std::erase_if(spills, [](const Spill& spill) { return spill.count == 0; });
+        return spills;
+    }
+
+    //! \brief Build buckets, merging runs of small neighbours into one subtree.
+    void processAll(const std::vector<Spill>& spills, int level)
+    {
+        std::size_t begin = 0;
+        while (begin < spills.size()) {
+            std::size_t end = begin + 1;
+            std::uint64_t count = spills[begin].count;
+            while (end < spills.size() && count + spills[end].count <= max_triangles)
+                count += spills[end++].count;
+
+            if (end - begin == 1) {
+                process(spills[begin], level);
+            } else {
+                std::vector<BVH::Triangle> tris, chunk;
+                tris.reserve(count);
+                for (std::size_t i = begin; i < end; ++i) {
+                    {
+                        SpillSource source(spills[i], chunk_size);
+                        while (source.next(chunk))
+                            tris.insert(tris.end(), chunk.begin(), chunk.end());
+                    }
+                    std::filesystem::remove(spills[i].path);
+                }
+                addSubtree(tris);
+            }
+            begin = end;
+        }
+    }
+
+    void process(const Spill& spill, int level)
+    {
+        const bool can_split = MORTON_BITS - BITS_PER_LEVEL * (level + 1) > 0;
+        if (spill.count > max_triangles && can_split) {
+            std::vector<Spill> children;
+            {
+                SpillSource source(spill, chunk_size);
+                children = partition(source, level + 1, false);
+            }
+            std::filesystem::remove(spill.path);
+            processAll(children, level + 1);
+            return;
+        }
+
+        // Fits in memory, or identical Morton codes: split by count
+        SpillSource source(spill, max_triangles);
+        std::vector<BVH::Triangle> tris;
+        while (source.next(tris))
+            addSubtree(tris);
+        std::filesystem::remove(spill.path);
+    }
+
+    void flatten(const BVH::Node* node, BVH::AABBTree::Iterator first,
+                 std::vector<FlatNode>& nodes)
+    {
+        const std::size_t index = nodes.size();
+        nodes.push_back(box(node->aabb.lower, node->aabb.upper));
+        if (node->is_leaf()) {
+            nodes[index].offset = node->begin - first;
+            nodes[index].count = node->end - node->begin;
+        } else {
+            flatten(node->left, first, nodes);
+            nodes[index].offset = nodes.size();
+            nodes[index].count = 0;
+            flatten(node->right, first, nodes);
+        }
+    }
+
+    static FlatNode box(const Vector4& lower, const Vector4& upper)
+    {
+        return {{lower.x, lower.y, lower.z}, {upper.x, upper.y, upper.z}, 0, 0};
+    }
+
+    void addSubtree(std::vector<BVH::Triangle>& tris)
+    {
+        if (tris.empty())
+            return;
+
+        std::vector<FlatNode> nodes;
+        {
+            BVH::AABBTree tree(tris, options.aabb_expansion);
+            nodes.reserve(2 * tris.size());
+            flatten(tree.root, tris.begin(), nodes);
+        }
+
+        Subtree subtree;
+        subtree.node_offset = append(nodes.data(), nodes.size() * sizeof(FlatNode));
+        subtree.num_nodes = nodes.size();
+        std::vector<PackedTriangle> packed(tris.size());
+        std::transform(tris.begin(), tris.end(), packed.begin(), pack);
+        subtree.triangle_offset = append(packed.data(), packed.size() * sizeof(PackedTriangle));
+        subtree.num_triangles = tris.size();
+
+        subtrees.push_back(subtree);
+        roots.push_back(nodes.front());
+        num_triangles += tris.size();
+        if (num_triangles > MAX_TRIANGLES)
+            throw std::runtime_error(fmt::format("more than {} triangles", MAX_TRIANGLES));
+    }
+
+    //! \brief Append an aligned section to the output, returns its offset.
+    std::uint64_t append(const void* data, std::size_t size)
+    {
+        static const char zeros[ALIGNMENT] = {};
+        const std::uint64_t padding = (ALIGNMENT - pos % ALIGNMENT) % ALIGNMENT;
+        out.write(zeros, padding);
+        const std::uint64_t offset = pos + padding;
+        out.write(static_cast<const char*>(data), size);
+        pos = offset + size;
+        return offset;
+    }
+
+    //! \brief Top tree over subtrees [begin, end), which are in Morton order.
+    void buildTop(std::size_t begin, std::size_t end, std::vector<FlatNode>& nodes)
+    {
+        const std::size_t index = nodes.size();
+        nodes.push_back(roots[begin]);
+        for (std::size_t i = begin + 1; i < end; ++i)
+            for (int c = 0; c < 3; ++c) {
+                nodes[index].lower[c] = std::min(nodes[index].lower[c], roots[i].lower[c]);
+                nodes[index].upper[c] = std::max(nodes[index].upper[c], roots[i].upper[c]);
+            }
+
+        if (end - begin == 1) {
+            nodes[index].offset = begin;
+            nodes[index].count = 1;
+            return;
+        }
+
+        const std::size_t middle = begin + (end - begin) / 2;
+        buildTop(begin, middle, nodes);
+        nodes[index].offset = nodes.size();
+        nodes[index].count = 0;
+        buildTop(middle, end, nodes);
+    }
+
+    void finish()
+    {
+        std::vector<FlatNode> top;
+        if (!subtrees.empty())
+            buildTop(0, subtrees.size(), top);
+
+        FileHeader header{};
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.num_triangles = num_triangles;
+        header.num_subtrees = subtrees.size();
+        header.subtree_offset = append(subtrees.data(), subtrees.size() * sizeof(Subtree));
+        header.num_top_nodes = top.size();
+        header.top_offset = append(top.data(), top.size() * sizeof(FlatNode));
+
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.close();
+        if (!out)
+            throw std::runtime_error("Error writing tree file");
+    }
+
+    OutOfCoreBVH::BuildOptions options;
+    TempDir temp;
+    std::ofstream out;
+    std::uint64_t pos = 0;
+
+    std::size_t max_triangles;
+    std::size_t chunk_size;
+    std::size_t bucket_buffer;
+    std::size_t num_spills = 0;
+
+    Vector4 lower, upper;
+
+    std::vector<Subtree> subtrees;
+    std::vector<FlatNode> roots;
+    std::uint64_t num_triangles = 0;
+};
+
+BVH::AABB aabb(const FlatNode& node)
+{
+    BVH::AABB result;
+    result.lower = Vector4(node.lower[0], node.lower[1], node.lower[2]);
+    result.upper = Vector4(node.upper[0], node.upper[1], node.upper[2]);
+    return result;
+}
+
+//! \brief Whether count items of the given size at offset lie within size bytes of file.
+bool within(std::uint64_t offset, std::uint64_t count, std::size_t size, std::uint64_t file_size)
+{
+    return offset <= file_size && count <= (file_size - offset) / size;
+}
+
+//! \brief Whether depth first nodes are well formed, so that traversal ends.
+//! \details Right children must follow the left subtree, and leaves must reference
+//!          items below num_items.
+bool validNodes(const FlatNode* nodes, std::uint64_t num_nodes, std::uint64_t num_items)
+{
+    for (std::uint64_t i = 0; i < num_nodes; ++i) {
+        const FlatNode& node = nodes[i];
+        if (node.count > 0) {
+            if (std::uint64_t(node.offset) + node.count > num_items)
+                return false;
+        } else if (node.offset <= i + 1 || node.offset >= num_nodes) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <class Stats>
+void intersectSubtree(BVH::Ray& ray, const FlatNode* nodes, const PackedTriangle* tris,
+                      std::uint64_t first_triangle, std::uint32_t index, Stats& stats)
+{
+    const FlatNode& node = nodes[index];
+    stats.box();
+    if (!BVH::intersect_ray_aabb(ray, aabb(node)))
+        return;
+    stats.node();
+
+    if (node.count > 0) {
+        for (std::uint32_t i = node.offset; i < node.offset + node.count; ++i) {
+            const float t = ray.get_t();
+            BVH::intersect_ray_triangle(ray, unpack(tris[i]), stats);
+            if (ray.get_t() < t)
+                ray.set_primitive(first_triangle + i);
+        }
+    } else {
+        intersectSubtree(ray, nodes, tris, first_triangle, index + 1, stats);
+        intersectSubtree(ray, nodes, tris, first_triangle, node.offset, stats);
+    }
+}
+
+template <class Stats>
+bool occludeSubtree(BVH::Ray& ray, const FlatNode* nodes, const PackedTriangle* tris,
+                    std::uint32_t index, Stats& stats)
+{
+    const FlatNode& node = nodes[index];
+    stats.box();
+    if (!BVH::intersect_ray_aabb_within(ray, aabb(node)))
+        return false;
+    stats.node();
+
+    if (node.count > 0) {
+        const float t = ray.get_t();
+        for (std::uint32_t i = node.offset; i < node.offset + node.count; ++i) {
+            BVH::intersect_ray_triangle(ray, unpack(tris[i]), stats);
+            if (ray.get_t() < t)
+                return true;
+        }
+        return false;
+    }
+    return occludeSubtree(ray, nodes, tris, index + 1, stats) ||
+           occludeSubtree(ray, nodes, tris, node.offset, stats);
+}
+
+}
+
+namespace OutOfCoreBVH {
+
+void build(std::string_view input, std::string_view output, const BuildOptions& options)
+{
+    try {
+        Builder(output, options).run(input);
+    } catch (const std::exception& e) {
+        throw std::runtime_error(fmt::format("Error building tree from {}, error = {}",
+                                             input, e.what()));
+    }
+}
+
+PagedTree::PagedTree(std::string_view path)
+    : m_file(path, false)
+{
+    const std::string_view data = m_file.view();
+    FileHeader header;
+    if (data.size() < sizeof(header))
+        throw std::runtime_error(fmt::format("Error reading {}, error = file too small", path));
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION)
+        throw std::runtime_error(fmt::format("Error reading {}, error = not a tree file", path));
+    if (!within(header.subtree_offset, header.num_subtrees, sizeof(Subtree), data.size()) ||
+        !within(header.top_offset, header.num_top_nodes, sizeof(FlatNode), data.size()))
+        throw std::runtime_error(fmt::format("Error reading {}, error = truncated file", path));
+    if (header.num_triangles > MAX_TRIANGLES)
+        throw std::runtime_error(fmt::format("Error reading {}, error = more than {} triangles", path, MAX_TRIANGLES));
+
+    m_subtrees = reinterpret_cast<const Subtree*>(data.data() + header.subtree_offset);
+    m_top = reinterpret_cast<const FlatNode*>(data.data() + header.top_offset);
+    m_num_subtrees = header.num_subtrees;
+    m_num_top = header.num_top_nodes;
+    m_num_triangles = header.num_triangles;
+
+    m_first_triangle.resize(m_num_subtrees);
+    std::uint64_t first_triangle = 0;
+    for (std::uint64_t i = 0; i < m_num_subtrees; ++i) {
+        const Subtree& s = m_subtrees[i];
+        if (!within(s.node_offset, s.num_nodes, sizeof(FlatNode), data.size()) ||
+            !within(s.triangle_offset, s.num_triangles, sizeof(PackedTriangle), data.size()))
+            throw std::runtime_error(fmt::format("Error reading {}, error = truncated subtree", path));
+        if (s.num_nodes == 0 ||
+            !validNodes(reinterpret_cast<const FlatNode*>(data.data() + s.node_offset), s.num_nodes, s.num_triangles))
+            throw std::runtime_error(fmt::format("Error reading {}, error = corrupt tree", path));
+        m_first_triangle[i] = first_triangle;
+        first_triangle += s.num_triangles;
+    }
+    if (first_triangle != m_num_triangles)
+        throw std::runtime_error(fmt::format("Error reading {}, error = triangle count mismatch", path));
+    if (!validNodes(m_top, m_num_top, m_num_subtrees))
+        throw std::runtime_error(fmt::format("Error reading {}, error = corrupt tree", path));
+}
+
+template <class Stats>
+bool PagedTree::intersect(Vector4 origin, Vector4 direction, float *t_out,
+                          Vector4 *pt_out, Vector4 *normal_out,
+                          std::uint32_t *primitive_out, Stats& stats) const
+{
+    BVH::Ray ray(origin, direction);
+    if (m_num_top > 0) {
+        const char* base = m_file.view().data();
+        auto visit = [&](auto&& self, std::uint32_t index) -> void
+        {
+            const FlatNode& node = m_top[index];
+            stats.box();
+            if (!BVH::intersect_ray_aabb(ray, aabb(node)))
+                return;
+            stats.node();
+            if (node.count > 0) {
+                const Subtree& s = m_subtrees[node.offset];
+                intersectSubtree(ray, reinterpret_cast<const FlatNode*>(base + s.node_offset),
+                                 reinterpret_cast<const PackedTriangle*>(base + s.triangle_offset),
+                                 m_first_triangle[node.offset], 0, stats);
+            } else {
+                self(self, index + 1);
+                self(self, node.offset);
+            }
+        };
+        visit(visit, 0);
+    }
+
+    *t_out = ray.get_t();
+    *pt_out = ray.get_pt();
+    *normal_out = ray.get_normal();
+    if (primitive_out)
+        *primitive_out = ray.get_primitive();
+    return ray.get_t() < std::numeric_limits<float>::max();
+}
+
+template <class Stats>
+bool PagedTree::occluded(Vector4 origin, Vector4 direction, float t_max, Stats& stats) const
+{
+    if (m_num_top == 0)
+        return false;
+    BVH::Ray ray(origin, direction);
+    ray.set_t(t_max);
+    const char* base = m_file.view().data();
+    auto visit = [&](auto&& self, std::uint32_t index) -> bool
+    {
+        const FlatNode& node = m_top[index];
+        stats.box();
+        if (!BVH::intersect_ray_aabb_within(ray, aabb(node)))
+            return false;
+        stats.node();
+        if (node.count > 0) {
+            const Subtree& s = m_subtrees[node.offset];
+            return occludeSubtree(ray, reinterpret_cast<const FlatNode*>(base + s.node_offset),
+                                  reinterpret_cast<const PackedTriangle*>(base + s.triangle_offset), 0, stats);
+        }
+        return self(self, index + 1) || self(self, node.offset);
+    };
+    return visit(visit, 0);
+}
+
+bool PagedTree::does_intersect_ray(Vector4 origin, Vector4 direction, float *t_out,
+                                   Vector4 *pt_out, Vector4 *normal_out,
+                                   std::uint32_t *primitive_out) const
+{
+    BVH::NoStats stats;
+    return intersect(origin, direction, t_out, pt_out, normal_out, primitive_out, stats);
+}
+
+bool PagedTree::is_occluded(Vector4 origin, Vector4 direction, float t_max) const
+{
+    BVH::NoStats stats;
+    return occluded(origin, direction, t_max, stats);
+}
+
+bool PagedTree::does_intersect_ray(Vector4 origin, Vector4 direction, float *t_out,
+                                   Vector4 *pt_out, Vector4 *normal_out,
+                                   std::uint32_t *primitive_out, BVH::TraversalStats& stats) const
+{
+    stats.queries++;
+    return intersect(origin, direction, t_out, pt_out, normal_out, primitive_out, stats);
+}
+
+bool PagedTree::is_occluded(Vector4 origin, Vector4 direction, float t_max, BVH::TraversalStats& stats) const
+{
+    stats.queries++;
+    return occluded(origin, direction, t_max, stats);
+}
+
+BVH::Triangle PagedTree::triangle(std::uint32_t primitive) const
+{
+    const auto next = std::upper_bound(m_first_triangle.begin(), m_first_triangle.end(), primitive);
+    const std::size_t subtree = next - m_first_triangle.begin() - 1;
+    const Subtree& s = m_subtrees[subtree];
+    const auto* tris = reinterpret_cast<const PackedTriangle*>(m_file.view().data() + s.triangle_offset);
+    return unpack(tris[primitive - m_first_triangle[subtree]]);
+}
+
+void PagedTree::bounds(Vector4 *lower, Vector4 *upper) const
+{
+    *lower = *upper = Vector4(0.0f);
+    if (m_num_top > 0) {
+        const BVH::AABB box = aabb(m_top[0]);
+        *lower = box.lower;
+        *upper = box.upper;
+    }
+}
+
+void PagedTree::print_stats() const
+{
+    std::cout << "Num. BVH triangles = " << m_num_triangles << std::endl;
+    std::cout << "Num. BVH subtrees = " << m_num_subtrees << std::endl;
+    std::cout << "Num. BVH top nodes = " << m_num_top << std::endl;
+}
+
+}
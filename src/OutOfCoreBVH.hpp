@@ -0,0 +1,128 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#ifndef WALDO_OUT_OF_CORE_BVH_HPP_
+#define WALDO_OUT_OF_CORE_BVH_HPP_
+
+#include "MappedFile.hpp"
+
+#include "bvh.hpp"
+#include "vec4.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+#include <vector>
+
+//! \brief BVH build for meshes larger than memory, and queries on the result.
+//! \details The input is streamed in chunks and spilled to temporary files
+//!          bucketed by the Morton code of the triangle centroids. Buckets
+//!          exceeding the memory budget are split further. A subtree is built
+//!          in memory for each bucket and appended to the output file, and a
+//!          top tree over the subtrees is written last.
+namespace OutOfCoreBVH {
+    //! \brief Node of a flattened tree.
+    //! \details Nodes are stored depth first, so the left child of an interior
+    //!          node directly follows it.
+    struct FlatNode
+    {
+        float lower[3];
+        float upper[3];
+        std::uint32_t offset; //!< Right child if interior, else first triangle (subtree in top tree)
+        std::uint32_t count;  //!< Number of triangles, 0 for interior nodes
+    };
+
+    //! \brief Location of a subtree in the output file.
+    struct Subtree
+    {
+        std::uint64_t node_offset;
+        std::uint64_t num_nodes;
+        std::uint64_t triangle_offset;
+        std::uint64_t num_triangles;
+    };
+
+    //! \brief Triangle as stored in spill and output files.
+    struct PackedTriangle
+    {
+        float v[9];
+    };
+
+    struct BuildOptions
+    {
+        std::size_t memory_budget = std::size_t(1) << 30; //!< Bytes available for subtree builds
+        std::filesystem::path temp_dir; //!< Directory for spill files, system default if empty
+        float aabb_expansion = 0.001f;  //!< Bounding box expansion, as for BVH::AABBTree
+        float scale = 1.0f;             //!< Scale applied to the vertices
+    };
+
+    //! \brief Build a tree out of core.
+    //! \details Throws std::runtime_error for meshes of more than 2^32 triangles, which the
+    //!          32-bit primitive indices of ray hits cannot address.
+    //! \param[in] input Mesh to read, binary or ASCII STL or a .tri file
+    //! \param[in] output Tree file to write
+    //! \param[in] options Build options
+    void build(std::string_view input,
+               std::string_view output,
+               const BuildOptions& options = {});
+
+    //! \brief Tree file mapped for on-demand paging.
+    class PagedTree
+    {
+    public:
+        //! \brief Map a tree file.
+        //! \details Throws std::runtime_error for trees of more than 2^32 triangles.
+        //! \param[in] path Path to tree file
+        explicit PagedTree(std::string_view path);
+
+        PagedTree(const PagedTree&) = delete;
+        PagedTree& operator=(const PagedTree&) = delete;
+
+        //! \brief Closest hit along a ray, as BVH::AABBTree::does_intersect_ray.
+        //! \details primitive_out, if given, receives the index of the hit
+        //!          triangle counted across subtrees in file order.
+        bool does_intersect_ray(Vector4 origin, Vector4 direction, float *t_out,
+                                Vector4 *pt_out, Vector4 *normal_out,
+                                std::uint32_t *primitive_out = nullptr) const;
+
+        //! \brief True if anything is hit along the ray before t_max.
+        bool is_occluded(Vector4 origin, Vector4 direction, float t_max) const;
+
+        //! \brief As above, also adding the query and its traversal counters to stats.
+        bool does_intersect_ray(Vector4 origin, Vector4 direction, float *t_out,
+                                Vector4 *pt_out, Vector4 *normal_out,
+                                std::uint32_t *primitive_out, BVH::TraversalStats& stats) const;
+        bool is_occluded(Vector4 origin, Vector4 direction, float t_max, BVH::TraversalStats& stats) const;
+
+        //! \brief Triangle with a primitive index reported by does_intersect_ray.
+        BVH::Triangle triangle(std::uint32_t primitive) const;
+
+        void print_stats() const;
+
+        //! \brief Bounds of the whole tree, zero if empty.
+        void bounds(Vector4 *lower, Vector4 *upper) const;
+
+        std::uint64_t num_triangles() const { return m_num_triangles; }
+
+    private:
+        template <class Stats>
+        bool intersect(Vector4 origin, Vector4 direction, float *t_out, Vector4 *pt_out,
+                       Vector4 *normal_out, std::uint32_t *primitive_out, Stats& stats) const;
+        template <class Stats>
+        bool occluded(Vector4 origin, Vector4 direction, float t_max, Stats& stats) const;
+
+        MappedFile m_file;
+        const FlatNode* m_top = nullptr;
+        const Subtree* m_subtrees = nullptr;
+        std::uint64_t m_num_top = 0;
+        std::uint64_t m_num_subtrees = 0;
+        std::uint64_t m_num_triangles = 0;
+        std::vector<std::uint64_t> m_first_triangle; // per subtree
+    };
+};
+
+#endif
@@ -0,0 +1,32 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "Picking.hpp"
+
+namespace {
+
+//! \brief Transform a point in clip space and divide by w.
+Vector4 transform(const float* m, float x, float y, float z)
+{
+    float out[4];
+    for (int r = 0; r < 4; ++r)
+        out[r] = m[r] * x + m[4 + r] * y + m[8 + r] * z + m[12 + r];
+    return Vector4(out[0] / out[3], out[1] / out[3], out[2] / out[3]);
+}
+
+}
+
+namespace Picking {
+
+Ray unproject(const float* inverse, float x, float y)
+{
+    const Vector4 near = transform(inverse, x, y, -1.0f);
+    const Vector4 far = transform(inverse, x, y, 1.0f);
+    return {near, (far - near).normalized3()};
+}
+
+}
@@ -0,0 +1,61 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#ifndef WALDO_PICKING_HPP_
+#define WALDO_PICKING_HPP_
+
+#include "vec4.hpp"
+
+#include <cstdint>
+#include <optional>
+
+//! \brief Picking points on a model with rays through the window.
+//! \details Rays are unprojected with the inverse of the matrix used for
+//!          drawing and traced through the tree of the model, so a pick
+//!          costs about as much as one primary ray.
+namespace Picking {
+    //! \brief A ray in model coordinates, with a unit direction.
+    struct Ray
+    {
+        Vector4 origin;
+        Vector4 direction;
+    };
+
+    //! \brief Closest hit of a ray.
+    struct Hit
+    {
+        float t;                 //!< Distance along the ray
+        Vector4 point;
+        std::uint32_t primitive; //!< Index of the triangle in the order of the tree
+    };
+
+    //! \brief Ray from the near to the far plane through a point of the window.
+    //! \param[in] inverse Inverse of the projection times view matrix, 16 values column major
+    //! \param[in] x Horizontal normalized device coordinate in [-1, 1]
+    //! \param[in] y Vertical normalized device coordinate in [-1, 1], up
+    Ray unproject(const float* inverse, float x, float y);
+
+    //! \brief Normalized device coordinates of a pixel center, y pointing down in the window.
+    inline void windowToDevice(int px, int py, int width, int height, float* x, float* y)
+    {
+        *x = 2.0f * (px + 0.5f) / width - 1.0f;
+        *y = 1.0f - 2.0f * (py + 0.5f) / height;
+    }
+
+    //! \brief Closest triangle of a BVH::BasicAABBTree along a ray.
+    template<class Tree>
+    std::optional<Hit> pick(const Tree& tree, const Ray& ray)
+    {
+        Hit hit;
+        Vector4 normal;
+        if (!tree.does_intersect_ray(ray.origin, ray.direction, &hit.t, &hit.point, &normal, &hit.primitive))
+            return std::nullopt;
+        return hit;
+    }
+};
+
+#endif
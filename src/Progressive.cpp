@@ -0,0 +1,38 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "Progressive.hpp"
+
+#include <cmath>
+
+namespace Progressive {
+
+int firstPass(bool cached)
+{
+    return cached ? 1 : 0;
+}
+
+Pass plan(int pass, bool cached)
+{
+    Pass result;
+    if (pass == 0) {
+        result.divisor = PREVIEW_DIVISOR;
+    } else if (pass == 1) {
+        result.divisor = cached ? 1 : PREVIEW_DIVISOR / 2;
+        result.reproject = cached;
+    } else {
+        // R2 low discrepancy jitter, the first sample at the pixel corner
+        result.sample = pass - 2;
+        if (result.sample > 0) {
+            result.jitter_x = std::fmod(0.5f + result.sample * 0.7548777f, 1.0f);
+            result.jitter_y = std::fmod(0.5f + result.sample * 0.5698403f, 1.0f);
+        }
+    }
+    return result;
+}
+
+}
@@ -0,0 +1,46 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#ifndef WALDO_PROGRESSIVE_HPP_
+#define WALDO_PROGRESSIVE_HPP_
+
+//! \brief Schedule of the passes that progressively refine an image.
+//! \details After a change the first pass traces every 4th pixel and the
+//!          next every 2nd. Then full resolution passes with jittered samples
+//!          are accumulated. When the hits of an earlier view are cached, a
+//!          full resolution preview reprojected from them replaces both
+//!          coarse previews. Previews are shown but never accumulated, so the
+//!          refined image is the same with and without reprojection.
+namespace Progressive {
+    constexpr int PREVIEW_DIVISOR = 4;
+    constexpr int MAX_SAMPLES = 8;
+
+    //! \brief Number of passes of a fully refined image.
+    constexpr int PASSES = 2 + MAX_SAMPLES;
+
+    //! \brief How a pass samples the image.
+    struct Pass
+    {
+        int divisor = 1;        //!< Traces every divisor-th pixel and fills the block below and right of it
+        bool reproject = false; //!< Reuses the cached hits and only traces the pixels they do not cover
+        int sample = -1;        //!< Index of the accumulated sample, -1 for previews
+        float jitter_x = 0.0f, jitter_y = 0.0f; //!< Sample offset within the pixels
+
+        bool preview() const { return sample < 0; }
+    };
+
+    //! \brief First pass after a change.
+    //! \param[in] cached Whether the hits of an earlier view are cached
+    int firstPass(bool cached);
+
+    //! \brief Plan of a pass.
+    //! \param[in] pass Pass index, 0 to PASSES - 1
+    //! \param[in] cached Whether the hits of an earlier view are cached
+    Pass plan(int pass, bool cached);
+};
+
+#endif
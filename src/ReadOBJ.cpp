@@ -0,0 +1,174 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "ReadOBJ.hpp"
+#include "Chunks.hpp"
+#include "MappedFile.hpp"
+
+#include "bvh.hpp"
+
+#include <fmt/format.h>
+
+#include <charconv>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <stdexcept>
+
+namespace {
+
+//! \brief Tokenizer for a single OBJ line.
+class LineParser
+{
+public:
+    LineParser(const char* begin, const char* end)
+        : pos(begin), last(end)
+    {}
+
+    std::string_view word()
+    {
+        while (pos != last && Chunks::isBlank(*pos))
+            ++pos;
+        const char* start = pos;
+        while (pos != last && !Chunks::isBlank(*pos))
+            ++pos;
+        return {start, static_cast<std::size_t>(pos - start)};
+    }
+
+    float number()
+    {
+        const std::string_view w = word();
+        float value;
+        const auto [ptr, ec] = std::from_chars(w.data(), w.data() + w.size(), value);
+        if (ec != std::errc())
+            throw std::runtime_error(fmt::format("malformed number '{}'", w));
+        return value;
+    }
+
+    //! \brief Vertex index of a v, v/vt, v//vn or v/vt/vn corner.
+    std::int64_t corner(std::string_view w)
+    {
+        std::int64_t value;
+        const auto [ptr, ec] = std::from_chars(w.data(), w.data() + w.size(), value);
+        if (ec != std::errc() || value == 0)
+            throw std::runtime_error(fmt::format("malformed face corner '{}'", w));
+        return value;
+    }
+
+    //! \brief Number of words left on the line.
+    std::size_t remaining() const
+    {
+        std::size_t count = 0;
+        bool in_word = false;
+        for (const char* p = pos; p != last; ++p) {
+            const bool blank = Chunks::isBlank(*p);
+            count += !blank && !in_word;
+            in_word = !blank;
+        }
+        return count;
+    }
+
+private:
+    const char* pos;
+    const char* last;
+};
+
+struct ChunkCounts
+{
+    std::size_t vertices = 0;
+    std::size_t triangles = 0;
+};
+
+}
+
+namespace OBJReader {
+
+BVH::IndexedMesh read(std::string_view path, bool is_file)
+{
+    std::optional<MappedFile> file;
+    std::string_view buffer = path;
+    if (is_file) {
+        file.emplace(path);
+        buffer = file->view();
+    }
+
+    const std::vector<std::size_t> bounds = Chunks::split(buffer, "\n");
+    const int num_chunks = bounds.size() - 1;
+
+    // Count vertices and triangles per chunk to find where each chunk goes in the output
+    std::vector<ChunkCounts> offsets(num_chunks + 1);
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int i = 0; i < num_chunks; ++i)
+        Chunks::forEachLine(buffer.data() + bounds[i], buffer.data() + bounds[i+1],
+                            [&count = offsets[i+1]](const char* begin, const char* end)
+                            {
+                                LineParser line(begin, end);
+                                const std::string_view key = line.word();
+                                if (key == "v")
+                                    ++count.vertices;
+                                else if (key == "f" && line.remaining() > 2)
+                                    count.triangles += line.remaining() - 2;
+                            });
+
+    for (int i = 0; i < num_chunks; ++i) {
+        offsets[i+1].vertices += offsets[i].vertices;
+        offsets[i+1].triangles += offsets[i].triangles;
+    }
+
+    BVH::IndexedMesh mesh;
+    mesh.vertices.resize(offsets.back().vertices);
+    mesh.triangles.resize(offsets.back().triangles);
+    const std::int64_t num_vertices = mesh.vertices.size();
+
+    std::vector<std::exception_ptr> errors(num_chunks);
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int i = 0; i < num_chunks; ++i) {
+        try {
+            std::size_t v = offsets[i].vertices;
+            std::size_t t = offsets[i].triangles;
+            Chunks::forEachLine(buffer.data() + bounds[i], buffer.data() + bounds[i+1],
+                                [&](const char* begin, const char* end)
+            {
+                LineParser line(begin, end);
+                const std::string_view key = line.word();
+                if (key == "v") {
+                    for (float& c : mesh.vertices[v])
+                        c = line.number();
+                    ++v;
+                } else if (key == "f") {
+                    // Negative indices are relative to the vertices read so far
+                    auto index = [&line, &v, num_vertices](std::string_view w)
+                    {
+                        std::int64_t idx = line.corner(w);
+                        idx = idx > 0 ? idx - 1 : static_cast<std::int64_t>(v) + idx;
+                        if (idx < 0 || idx >= num_vertices)
+                            throw std::runtime_error(fmt::format("face index '{}' out of range", w));
+                        return static_cast<std::uint32_t>(idx);
+                    };
+                    const std::size_t corners = line.remaining();
+                    if (corners < 3)
+                        return;
+                    const std::uint32_t first = index(line.word());
+                    std::uint32_t prev = index(line.word());
+                    for (std::size_t k = 2; k < corners; ++k) {
+                        const std::uint32_t cur = index(line.word());
+                        mesh.triangles[t++] = {first, prev, cur};
+                        prev = cur;
+                    }
+                }
+            });
+        } catch (...) {
+            errors[i] = std::current_exception();
+        }
+    }
+
+    Chunks::rethrowFirst(errors, is_file ? path : "buffer");
+
+    return mesh;
+}
+
+}
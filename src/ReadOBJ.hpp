@@ -0,0 +1,25 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#ifndef WALDO_READ_OBJ_HPP_
+#define WALDO_READ_OBJ_HPP_
+
+#include <string_view>
+
+namespace BVH { struct IndexedMesh; }
+
+namespace OBJReader {
+    //! \brief Read a Wavefront OBJ file.
+    //! \details Only vertex positions and faces are read, polygons are
+    //!          split into triangle fans. Line ranges are parsed in parallel.
+    //! \param[in] path Path to file or buffer to read
+    //! \param[in] is_file True if path is a filename
+    BVH::IndexedMesh read(std::string_view path,
+                          bool is_file = true);
+};
+
+#endif
@@ -0,0 +1,371 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "ReadPLY.hpp"
+#include "MappedFile.hpp"
+
+#include "bvh.hpp"
+
+#include <fmt/format.h>
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+static_assert(std::endian::native == std::endian::little,
+              "PLY reader assumes a little endian host");
+
+namespace {
+
+enum class Type { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64 };
+
+struct Property
+{
+    std::string name;
+    Type type;
+    bool is_list = false;
+    Type count_type = Type::UInt8;
+};
+
+struct Element
+{
+    std::string name;
+    std::size_t count;
+    std::vector<Property> properties;
+};
+
+Type typeFromName(std::string_view name)
+{
+    if (name == "char" || name == "int8")
+        return Type::Int8;
+    if (name == "uchar" || name == "uint8")
+        return Type::UInt8;
+    if (name == "short" || name == "int16")
+        return Type::Int16;
+    if (name == "ushort" || name == "uint16")
+        return Type::UInt16;
+    if (name == "int" || name == "int32")
+        return Type::Int32;
+    if (name == "uint" || name == "uint32")
+        return Type::UInt32;
+    if (name == "float" || name == "float32")
+        return Type::Float32;
+    if (name == "double" || name == "float64")
+        return Type::Float64;
+    throw std::runtime_error(fmt::format("unknown property type '{}'", name));
+}
+
+std::size_t sizeOf(Type type)
+{
+    switch (type) {
+    case Type::Int8:
+    case Type::UInt8:
+        return 1;
+    case Type::Int16:
+    case Type::UInt16:
+        return 2;
+    case Type::Int32:
+    case Type::UInt32:
+    case Type::Float32:
+        return 4;
+    case Type::Float64:
+        return 8;
+    }
+    return 0;
+}
+
+template<class T>
+T load(const char* ptr)
+{
+    T value;
+    std::memcpy(&value, ptr, sizeof(T));
+    return value;
+}
+
+template<class T>
+T loadAs(Type type, const char* ptr)
+{
+    switch (type) {
+    case Type::Int8:    return static_cast<T>(load<std::int8_t>(ptr));
+    case Type::UInt8:   return static_cast<T>(load<std::uint8_t>(ptr));
+    case Type::Int16:   return static_cast<T>(load<std::int16_t>(ptr));
+    case Type::UInt16:  return static_cast<T>(load<std::uint16_t>(ptr));
+    case Type::Int32:   return static_cast<T>(load<std::int32_t>(ptr));
+    case Type::UInt32:  return static_cast<T>(load<std::uint32_t>(ptr));
+    case Type::Float32: return static_cast<T>(load<float>(ptr));
+    case Type::Float64: return static_cast<T>(load<double>(ptr));
+    }
+    return T{};
+}
+
+//! \brief Split a header line into words.
+std::vector<std::string_view> words(std::string_view line)
+{
+    std::vector<std::string_view> result;
+    while (true) {
+        const std::size_t start = line.find_first_not_of(" \t\r");
+        if (start == std::string_view::npos)
+            return result;
+        line.remove_prefix(start);
+        const std::size_t end = std::min(line.find_first_of(" \t\r"), line.size());
+        result.push_back(line.substr(0, end));
+        line.remove_prefix(end);
+    }
+}
+
+//! \brief Parse the header, returns the elements and the offset of the body.
+std::pair<std::vector<Element>, std::size_t> parseHeader(std::string_view buffer)
+{
+    if (!buffer.starts_with("ply"))
+        throw std::runtime_error("not a PLY file");
+
+    std::vector<Element> elements;
+    std::size_t pos = 0;
+    while (true) {
+        const std::size_t eol = buffer.find('\n', pos);
+        if (eol == std::string_view::npos)
+            throw std::runtime_error("unterminated header");
+        const auto w = words(buffer.substr(pos, eol - pos));
+        pos = eol + 1;
+
+        if (w.empty() || w[0] == "ply" || w[0] == "comment" || w[0] == "obj_info")
+            continue;
+        if (w[0] == "end_header")
+            return {elements, pos};
+
+        if (w[0] == "format") {
+            if (w.size() < 2 || w[1] != "binary_little_endian")
+                throw std::runtime_error(fmt::format("unsupported format '{}'",
+                                                     w.size() < 2 ? "" : w[1]));
+        } else if (w[0] == "element" && w.size() == 3) {
+            elements.push_back({std::string(w[1]), std::stoull(std::string(w[2])), {}});
+        } else if (w[0] == "property" && !elements.empty()) {
+            if (w.size() == 5 && w[1] == "list")
+                elements.back().properties.push_back({std::string(w[4]), typeFromName(w[3]),
+                                                      true, typeFromName(w[2])});
+            else if (w.size() == 3)
+                elements.back().properties.push_back({std::string(w[2]), typeFromName(w[1])});
+            else
+                throw std::runtime_error("malformed property");
+        } else {
+            throw std::runtime_error(fmt::format("unexpected header keyword '{}'", w[0]));
+        }
+    }
+}
+
+//! \brief Returns the size of an element item if it has no list properties.
+std::optional<std::size_t> fixedStride(const Element& element)
+{
+    std::size_t stride = 0;
+    for (const Property& prop : element.properties) {
+        if (prop.is_list)
+            return std::nullopt;
+        stride += sizeOf(prop.type);
+    }
+    return stride;
+}
+
+class PLYBody
+{
+public:
+    PLYBody(const char* begin, const char* end)
+        : pos(begin), last(end)
+    {}
+
+    void readVertices(const Element& element, BVH::IndexedMesh& mesh)
+    {
+        const auto stride = fixedStride(element);
+        if (!stride)
+            throw std::runtime_error("list properties in vertex element");
+
+        std::size_t offset[3];
+        Type type[3];
+        for (int c = 0; c < 3; ++c) {
+            const char* name = c == 0 ? "x" : c == 1 ? "y" : "z";
+            std::size_t off = 0;
+            const Property* found = nullptr;
+            for (const Property& prop : element.properties) {
+                if (prop.name == name) {
+                    found = &prop;
+                    break;
+                }
+                off += sizeOf(prop.type);
+            }
+            if (!found)
+                throw std::runtime_error(fmt::format("missing vertex property '{}'", name));
+            offset[c] = off;
+            type[c] = found->type;
+        }
+
+        require(element.count * *stride);
+        mesh.vertices.resize(element.count);
+        const char* data = pos;
+        const std::int64_t count = element.count;
+#pragma omp parallel for
+        for (std::int64_t i = 0; i < count; ++i) {
+            const char* item = data + i * *stride;
+            for (int c = 0; c < 3; ++c)
+                mesh.vertices[i][c] = loadAs<float>(type[c], item + offset[c]);
+        }
+        pos += element.count * *stride;
+    }
+
+    void readFaces(const Element& element, BVH::IndexedMesh& mesh)
+    {
+        std::size_t index_offset = 0;
+        const Property* indices = nullptr;
+        for (const Property& prop : element.properties) {
+            if (prop.is_list && (prop.name == "vertex_indices" || prop.name == "vertex_index")) {
+                indices = &prop;
+                break;
+            }
+            if (prop.is_list)
+                throw std::runtime_error("list property before face indices");
+            index_offset += sizeOf(prop.type);
+        }
+        if (!indices)
+            throw std::runtime_error("missing face property 'vertex_indices'");
+
+        if (element.properties.size() == 1 && readTriangles(*indices, element.count, mesh))
+            return;
+
+        // General polygons, split into triangle fans
+        const std::size_t count_size = sizeOf(indices->count_type);
+        const std::size_t index_size = sizeOf(indices->type);
+        mesh.triangles.reserve(mesh.triangles.size() + element.count);
+        for (std::size_t i = 0; i < element.count; ++i) {
+            const std::size_t size = checkedItemSize(element);
+            const char* list = pos + index_offset;
+            const auto n = loadAs<std::size_t>(indices->count_type, list);
+            const char* idx = list + count_size;
+            for (std::size_t k = 1; k + 1 < n; ++k)
+                mesh.triangles.push_back({loadAs<std::uint32_t>(indices->type, idx),
+                                          loadAs<std::uint32_t>(indices->type, idx + k * index_size),
+                                          loadAs<std::uint32_t>(indices->type, idx + (k + 1) * index_size)});
+            pos += size;
+        }
+    }
+
+    void skip(const Element& element)
+    {
+        if (const auto stride = fixedStride(element)) {
+            require(element.count * *stride);
+            pos += element.count * *stride;
+            return;
+        }
+        for (std::size_t i = 0; i < element.count; ++i)
+            pos += checkedItemSize(element);
+    }
+
+private:
+    //! \brief Fast path for pure triangle meshes, decoded in parallel.
+    //! \return False if any face is not a triangle
+    bool readTriangles(const Property& indices, std::size_t count, BVH::IndexedMesh& mesh)
+    {
+        const std::size_t count_size = sizeOf(indices.count_type);
+        const std::size_t index_size = sizeOf(indices.type);
+        const std::size_t stride = count_size + 3 * index_size;
+        if (static_cast<std::size_t>(last - pos) < count * stride)
+            return false;
+
+        const char* data = pos;
+        const std::int64_t num_faces = count;
+        bool all_triangles = true;
+#pragma omp parallel for reduction(&&:all_triangles)
+        for (std::int64_t i = 0; i < num_faces; ++i)
+            all_triangles = all_triangles &&
+                            loadAs<std::size_t>(indices.count_type, data + i * stride) == 3;
+        if (!all_triangles)
+            return false;
+
+        const std::size_t first = mesh.triangles.size();
+        mesh.triangles.resize(first + count);
+#pragma omp parallel for
+        for (std::int64_t i = 0; i < num_faces; ++i) {
+            const char* idx = data + i * stride + count_size;
+            for (int k = 0; k < 3; ++k)
+                mesh.triangles[first + i][k] = loadAs<std::uint32_t>(indices.type, idx + k * index_size);
+        }
+        pos += count * stride;
+
+        return true;
+    }
+
+    //! \brief Size of the item at the current position, checked against the buffer.
+    std::size_t checkedItemSize(const Element& element) const
+    {
+        std::size_t size = 0;
+        for (const Property& prop : element.properties) {
+            if (prop.is_list) {
+                require(size + sizeOf(prop.count_type));
+                const auto n = loadAs<std::size_t>(prop.count_type, pos + size);
+                size += sizeOf(prop.count_type) + n * sizeOf(prop.type);
+            } else {
+                size += sizeOf(prop.type);
+            }
+        }
+        require(size);
+        return size;
+    }
+
+    void require(std::size_t bytes) const
+    {
+        if (static_cast<std::size_t>(last - pos) < bytes)
+            throw std::runtime_error("unexpected end of file");
+    }
+
+    const char* pos;
+    const char* last;
+};
+
+}
+
+namespace PLYReader {
+
+BVH::IndexedMesh read(std::string_view path, bool is_file)
+{
+    std::optional<MappedFile> file;
+    std::string_view buffer = path;
+    if (is_file) {
+        file.emplace(path);
+        buffer = file->view();
+    }
+
+    BVH::IndexedMesh mesh;
+    try {
+        const auto [elements, offset] = parseHeader(buffer);
+        PLYBody body(buffer.data() + offset, buffer.data() + buffer.size());
+        for (const Element& element : elements) {
+            if (element.name == "vertex")
+                body.readVertices(element, mesh);
+            else if (element.name == "face")
+                body.readFaces(element, mesh);
+            else
+                body.skip(element);
+        }
+
+        const std::uint32_t num_vertices = mesh.vertices.size();
+        const std::int64_t num_tris = mesh.triangles.size();
+        bool valid = true;
+#pragma omp parallel for reduction(&&:valid)
+        for (std::int64_t i = 0; i < num_tris; ++i)
+            for (const std::uint32_t idx : mesh.triangles[i])
+                valid = valid && idx < num_vertices;
+        if (!valid)
+            throw std::runtime_error("face index out of range");
+    } catch (const std::exception& e) {
+        throw std::runtime_error(fmt::format("Error reading {}, error = {}",
+                                             is_file ? path : "buffer", e.what()));
+    }
+
+    return mesh;
+}
+
+}
@@ -0,0 +1,25 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#ifndef WALDO_READ_PLY_HPP_
+#define WALDO_READ_PLY_HPP_
+
+#include <string_view>
+
+namespace BVH { struct IndexedMesh; }
+
+namespace PLYReader {
+    //! \brief Read a binary little endian PLY file.
+    //! \details Vertex positions and faces are decoded straight into the
+    //!          indexed mesh, polygons are split into triangle fans.
+    //! \param[in] path Path to file or buffer to read
+    //! \param[in] is_file True if path is a filename
+    BVH::IndexedMesh read(std::string_view path,
+                          bool is_file = true);
+};
+
+#endif
@@ -5,12 +5,21 @@
  *  See LICENSE.md for more information.
  */
 
+#include "ReadSTL.hpp"
+#include "Chunks.hpp"
+#include "MappedFile.hpp"
+
 #include "bvh.hpp"
 #include "include/microstl.h"
 
 #include <fmt/format.h>
 
-#include <filesystem>
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <optional>
 #include <stdexcept>
 
 namespace {
@@ -42,6 +51,166 @@ private:
     std::vector<std::array<float,3>> nrmls;
 };
 
+//! \brief Approximate size of an ASCII facet, used to reserve output.
+constexpr std::size_t BYTES_PER_FACET = 256;
+
+bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+//! \brief Returns true if the buffer holds an ASCII STL.
+//! \details Binary files may also start with 'solid', so the size of the
+//!          buffer is checked against the binary facet count as well.
+bool isAscii(std::string_view buffer)
+{
+    if (buffer.size() >= 84) {
+        uint32_t count;
+        std::memcpy(&count, buffer.data() + 80, sizeof(count));
+        if (84 + 50 * static_cast<uint64_t>(count) == buffer.size())
+            return false;
+    }
+
+    const auto first = std::find_if_not(buffer.begin(), buffer.end(), isSpace);
+    return buffer.substr(first - buffer.begin()).starts_with("solid");
+}
+
+//! \brief Tokenizer for a range of an ASCII STL buffer.
+class AsciiChunkParser
+{
+public:
+    AsciiChunkParser(const char* begin, const char* end)
+        : pos(begin), last(end)
+    {}
+
+    //! \brief Parse all facets in the chunk.
+    void parse(std::vector<BVH::Triangle>& tris,
+               std::vector<std::array<float,3>>& normals)
+    {
+        while (true) {
+            const std::string_view w = word();
+            if (w.empty())
+                return;
+            if (w == "solid" || w == "endsolid") {
+                skipLine();
+                continue;
+            }
+            if (w != "facet")
+                fail(w);
+
+            expect("normal");
+            const std::array n{number(), number(), number()};
+            expect("outer");
+            expect("loop");
+            BVH::Triangle tri;
+            for (auto& vertex : tri.vertices) {
+                expect("vertex");
+                const float x = number();
+                const float y = number();
+                const float z = number();
+                vertex = Vector4(x, y, z);
+            }
+            expect("endloop");
+            expect("endfacet");
+            tris.push_back(tri);
+            normals.push_back(n);
+        }
+    }
+
+private:
+    void skipSpace()
+    {
+        while (pos != last && isSpace(*pos))
+            ++pos;
+    }
+
+    void skipLine()
+    {
+        pos = std::find(pos, last, '\n');
+    }
+
+    std::string_view word()
+    {
+        skipSpace();
+        const char* start = pos;
+        while (pos != last && !isSpace(*pos))
+            ++pos;
+        return {start, static_cast<std::size_t>(pos - start)};
+    }
+
+    void expect(std::string_view keyword)
+    {
+        const std::string_view w = word();
+        if (w != keyword)
+            fail(w);
+    }
+
+    float number()
+    {
+        skipSpace();
+        if (pos != last && *pos == '+')
+            ++pos;
+        float value;
+        const auto [ptr, ec] = std::from_chars(pos, last, value);
+        if (ec != std::errc())
+            fail(word());
+        pos = ptr;
+        return value;
+    }
+
+    [[noreturn]] void fail(std::string_view token)
+    {
+        throw std::runtime_error(fmt::format("unexpected token '{}'", token));
+    }
+
+    const char* pos;
+    const char* last;
+};
+
+std::tuple<std::vector<BVH::Triangle>,
+           std::vector<std::array<float,3>>>
+parseAscii(std::string_view buffer, std::string_view name)
+{
+    const std::vector<std::size_t> bounds = Chunks::split(buffer, "endfacet");
+    const int num_chunks = bounds.size() - 1;
+
+    std::vector<std::vector<BVH::Triangle>> chunk_tris(num_chunks);
+    std::vector<std::vector<std::array<float,3>>> chunk_normals(num_chunks);
+    std::vector<std::exception_ptr> errors(num_chunks);
+
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int i = 0; i < num_chunks; ++i) {
+        try {
+            const std::size_t estimate = (bounds[i+1] - bounds[i]) / BYTES_PER_FACET;
+            chunk_tris[i].reserve(estimate);
+            chunk_normals[i].reserve(estimate);
+            AsciiChunkParser(buffer.data() + bounds[i],
+                             buffer.data() + bounds[i+1]).parse(chunk_tris[i],
+                                                                chunk_normals[i]);
+        } catch (...) {
+            errors[i] = std::current_exception();
+        }
+    }
+
+    Chunks::rethrowFirst(errors, name);
+
+    // Splice the chunks in order
+    std::vector<std::size_t> offsets(num_chunks + 1, 0);
+    for (int i = 0; i < num_chunks; ++i)
+        offsets[i+1] = offsets[i] + chunk_tris[i].size();
+
+    std::vector<BVH::Triangle> tris(offsets.back());
+    std::vector<std::array<float,3>> normals(offsets.back());
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int i = 0; i < num_chunks; ++i) {
+        std::copy(chunk_tris[i].begin(), chunk_tris[i].end(), tris.begin() + offsets[i]);
+        std::copy(chunk_normals[i].begin(), chunk_normals[i].end(),
+                  normals.begin() + offsets[i]);
+    }
+
+    return {std::move(tris), std::move(normals)};
+}
+
 }
 
 namespace STLReader {
@@ -50,19 +219,36 @@ std::tuple<std::vector<BVH::Triangle>,
            std::vector<std::array<float, 3>>>
 read(std::string_view path, bool is_file)
 {
-    BVHHandler meshHandler;
-    microstl::Result result;
+    std::optional<MappedFile> file;
+    std::string_view buffer = path;
     if (is_file) {
-        std::filesystem::path fs_path(path);
-        result = microstl::Reader::readStlFile(path, meshHandler);
-    } else {
-        result = microstl::Reader::readStlBuffer(path.data(), path.size(), meshHandler);
+        file.emplace(path);
+        buffer = file->view();
     }
+    const std::string_view name = is_file ? path : std::string_view{"buffer"};
+
+    if (isAscii(buffer))
+        return parseAscii(buffer, name);
+
+    BVHHandler meshHandler;
+    const microstl::Result result =
+        microstl::Reader::readStlBuffer(buffer.data(), buffer.size(), meshHandler);
     if (result != microstl::Result::Success)
         throw std::runtime_error(fmt::format("Error reading {}, error = {}",
-                                             path, microstl::getResultString(result)));
+                                             name, microstl::getResultString(result)));
 
     return {meshHandler.triangles(), meshHandler.normals()};
 }
 
+std::tuple<std::vector<BVH::Triangle>,
+           std::vector<std::array<float, 3>>>
+readASCII(std::string_view path, bool is_file)
+{
+    if (!is_file)
+        return parseAscii(path, "buffer");
+
+    const MappedFile file(path);
+    return parseAscii(file.view(), path);
+}
+
 }
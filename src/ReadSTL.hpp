@@ -14,10 +14,21 @@ namespace BVH { struct Triangle; }
 
 namespace STLReader {
     //! \brief Read a STL file.
+    //! \details ASCII files are parsed with \ref readASCII.
     //! \param[in] path Path to file or buffer to read
     //! \param[in] is_file True if path is a filename
     std::tuple<std::vector<BVH::Triangle>,
                std::vector<std::array<float,3>>>
     read(std::string_view path,
          bool is_file = true);
+
+    //! \brief Read an ASCII STL file in parallel.
+    //! \details The buffer is split into chunks on facet boundaries which
+    //!          are parsed concurrently and spliced together in order.
+    //! \param[in] path Path to file or buffer to read
+    //! \param[in] is_file True if path is a filename
+    std::tuple<std::vector<BVH::Triangle>,
+               std::vector<std::array<float,3>>>
+    readASCII(std::string_view path,
+              bool is_file = true);
 };
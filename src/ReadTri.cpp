@@ -0,0 +1,87 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "ReadTri.hpp"
+#include "Chunks.hpp"
+#include "MappedFile.hpp"
+
+#include "bvh.hpp"
+
+#include <fmt/format.h>
+
+#include <charconv>
+#include <exception>
+#include <optional>
+#include <stdexcept>
+
+namespace {
+
+//! \brief Parse nine coordinates from a line.
+BVH::Triangle parseLine(const char* pos, const char* end)
+{
+    float c[9];
+    for (float& value : c) {
+        while (pos != end && Chunks::isBlank(*pos))
+            ++pos;
+        const auto [ptr, ec] = std::from_chars(pos, end, value);
+        if (ec != std::errc())
+            throw std::runtime_error(fmt::format("malformed line '{}'",
+                                                 std::string_view(pos, end - pos)));
+        pos = ptr;
+    }
+
+    return {Vector4(c[0], c[1], c[2]),
+            Vector4(c[3], c[4], c[5]),
+            Vector4(c[6], c[7], c[8])};
+}
+
+}
+
+namespace TriReader {
+
+std::vector<BVH::Triangle> read(std::string_view path, bool is_file)
+{
+    std::optional<MappedFile> file;
+    std::string_view buffer = path;
+    if (is_file) {
+        file.emplace(path);
+        buffer = file->view();
+    }
+
+    const std::vector<std::size_t> bounds = Chunks::split(buffer, "\n");
+    const int num_chunks = bounds.size() - 1;
+
+    // Count lines per chunk to find where each chunk goes in the output
+    std::vector<std::size_t> offsets(num_chunks + 1, 0);
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int i = 0; i < num_chunks; ++i)
+        Chunks::forEachLine(buffer.data() + bounds[i], buffer.data() + bounds[i+1],
+                    [&count = offsets[i+1]](const char*, const char*) { ++count; });
+
+    for (int i = 0; i < num_chunks; ++i)
+        offsets[i+1] += offsets[i];
+
+    std::vector<BVH::Triangle> tris(offsets.back());
+    std::vector<std::exception_ptr> errors(num_chunks);
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int i = 0; i < num_chunks; ++i) {
+        try {
+            auto out = tris.begin() + offsets[i];
+            Chunks::forEachLine(buffer.data() + bounds[i], buffer.data() + bounds[i+1],
+                        [&out](const char* begin, const char* end)
+                        { *out++ = parseLine(begin, end); });
+        } catch (...) {
+            errors[i] = std::current_exception();
+        }
+    }
+
+    Chunks::rethrowFirst(errors, is_file ? path : "buffer");
+
+    return tris;
+}
+
+}
@@ -0,0 +1,26 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#ifndef WALDO_READ_TRI_HPP_
+#define WALDO_READ_TRI_HPP_
+
+#include <string_view>
+#include <vector>
+
+namespace BVH { struct Triangle; }
+
+namespace TriReader {
+    //! \brief Read a .tri file with nine vertex coordinates per line.
+    //! \details Lines are counted in a first pass to size the output,
+    //!          then line ranges are parsed in parallel.
+    //! \param[in] path Path to file or buffer to read
+    //! \param[in] is_file True if path is a filename
+    std::vector<BVH::Triangle> read(std::string_view path,
+                                    bool is_file = true);
+};
+
+#endif
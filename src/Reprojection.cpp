@@ -0,0 +1,158 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "Reprojection.hpp"
+
+#include "ray_intersection.hpp"
+
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+constexpr std::uint64_t NO_CANDIDATE = std::numeric_limits<std::uint64_t>::max();
+
+// Keep the smaller of value and the current one
+void atomicMin(std::uint64_t& target, std::uint64_t value)
+{
+    std::atomic_ref<std::uint64_t> ref(target);
+    std::uint64_t current = ref.load(std::memory_order_relaxed);
+    while (value < current && !ref.compare_exchange_weak(current, value, std::memory_order_relaxed))
+        ;
+}
+
+}
+
+namespace Reprojection {
+
+Vector4 View::direction(int x, int y) const
+{
+    return directionAt(x + jitter_x, y + jitter_y);
+}
+
+Vector4 View::directionAt(float x, float y) const
+{
+    const float pixel_x_normalized = (2 * x / (float)width - 1) * aspect_ratio;
+    const float pixel_y_normalized = 1 - 2 * y / (float)height;
+    return forward + right * tan_half_fov * pixel_x_normalized + up * tan_half_fov * pixel_y_normalized;
+}
+
+bool View::project(Vector4 point, int* x, int* y) const
+{
+    const Vector4 d = point - eye;
+    const float depth = d.dot3(forward);
+    if (depth <= 0.0f)
+        return false;
+    const float u = d.dot3(right) / (depth * tan_half_fov * aspect_ratio);
+    const float v = d.dot3(up) / (depth * tan_half_fov);
+    const float px = (u + 1) * 0.5f * width - jitter_x;
+    const float py = (1 - v) * 0.5f * height - jitter_y;
+    if (!(px > -0.5f && px < width - 0.5f && py > -0.5f && py < height - 0.5f))
+        return false;
+    *x = std::min(int(std::lround(px)), width - 1);
+    *y = std::min(int(std::lround(py)), height - 1);
+    return true;
+}
+
+void Cache::store(const View& view, const Shading::GBuffer& gbuffer)
+{
+    m_width = view.width;
+    m_height = view.height;
+    const std::size_t size = gbuffer.size();
+    m_x.resize(size);
+    m_y.resize(size);
+    m_z.resize(size);
+    m_primitive.resize(size);
+    m_hit.resize(size);
+
+    const int width = view.width;
+#pragma omp parallel for schedule(static)
+    for (std::int64_t i = 0; i < std::int64_t(size); ++i) {
+        const float t = gbuffer.t[i];
+        m_hit[i] = t < std::numeric_limits<float>::max();
+        if (!m_hit[i])
+            continue;
+        const Vector4 p = view.eye + view.direction(i % width, i / width).normalized3() * t;
+        m_x[i] = p.x;
+        m_y[i] = p.y;
+        m_z[i] = p.z;
+        m_primitive[i] = gbuffer.primitive[i];
+    }
+}
+
+void Cache::clear()
+{
+    m_width = m_height = 0;
+}
+
+std::size_t Cache::reproject(const View& view, Shading::GBuffer& gbuffer,
+                             std::vector<std::uint8_t>& trace, const TriangleFetch& fetch) const
+{
+    const int width = view.width, height = view.height;
+    const std::size_t size = std::size_t(width) * height;
+    gbuffer.resize(size);
+    trace.assign(size, 1);
+    if (empty())
+        return size;
+
+    // Nearest stored hit landing in each pixel, distance bits above the primitive
+    std::vector<std::uint64_t> nearest(size, NO_CANDIDATE);
+    const std::int64_t stored = m_hit.size();
+#pragma omp parallel for schedule(static)
+    for (std::int64_t i = 0; i < stored; ++i) {
+        if (!m_hit[i])
+            continue;
+        const Vector4 p(m_x[i], m_y[i], m_z[i]);
+        int x, y;
+        if (!view.project(p, &x, &y))
+            continue;
+        const float distance = (p - view.eye).length3();
+        const std::uint64_t key = std::uint64_t(std::bit_cast<std::uint32_t>(distance)) << 32 | m_primitive[i];
+        atomicMin(nearest[x + std::size_t(y) * width], key);
+    }
+
+    // Keep a candidate if the pixel's own ray hits its triangle. Neighbours'
+    // candidates fill the gaps when surfaces are magnified.
+    std::size_t num_trace = 0;
+#pragma omp parallel for schedule(static) reduction(+ : num_trace)
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            const std::size_t i = x + std::size_t(y) * width;
+            const std::uint64_t candidates[5] = {
+                nearest[i],
+                x > 0 ? nearest[i - 1] : NO_CANDIDATE,
+                x + 1 < width ? nearest[i + 1] : NO_CANDIDATE,
+                y > 0 ? nearest[i - width] : NO_CANDIDATE,
+                y + 1 < height ? nearest[i + width] : NO_CANDIDATE};
+
+            const Vector4 direction = view.direction(x, y).normalized3();
+            for (std::uint64_t candidate : candidates) {
+                if (candidate == NO_CANDIDATE)
+                    continue;
+                const std::uint32_t primitive = candidate & 0xffffffffu;
+                BVH::Ray ray(view.eye, direction);
+                BVH::intersect_ray_triangle(ray, fetch(primitive));
+                if (ray.get_t() < std::numeric_limits<float>::max()) {
+                    const Vector4 normal = ray.get_normal();
+                    gbuffer.t[i] = ray.get_t();
+                    gbuffer.normal_x[i] = normal.x;
+                    gbuffer.normal_y[i] = normal.y;
+                    gbuffer.normal_z[i] = normal.z;
+                    gbuffer.primitive[i] = primitive;
+                    trace[i] = 0;
+                    break;
+                }
+            }
+            num_trace += trace[i];
+        }
+    }
+    return num_trace;
+}
+
+}
@@ -0,0 +1,79 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#ifndef WALDO_REPROJECTION_HPP_
+#define WALDO_REPROJECTION_HPP_
+
+#include "Shading.hpp"
+
+#include "bvh.hpp"
+#include "vec4.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+//! \brief Reuse of the hits of the previous frame when the camera moves.
+//! \details The world space hit points of a frame are projected into the
+//!          next view. A pixel keeps a projected hit if its own ray hits the
+//!          same triangle, which costs one ray and triangle test. The rest
+//!          are traced.
+namespace Reprojection {
+    //! \brief Pinhole view with the pixel to ray mapping of raytrace.
+    struct View
+    {
+        Vector4 eye;
+        Vector4 forward, right, up; //!< Orthonormal camera basis
+        float tan_half_fov = 1.0f;
+        float aspect_ratio = 1.0f;
+        int width = 0, height = 0;
+        float jitter_x = 0.0f, jitter_y = 0.0f; //!< Sample offset within the pixels
+
+        //! \brief Direction of the ray through a pixel, not normalized.
+        Vector4 direction(int x, int y) const;
+
+        //! \brief Direction of the ray through a point of the image in pixel units, not normalized.
+        //! \details The jitter is not added, direction(x, y) is directionAt(x + jitter_x, y + jitter_y).
+        Vector4 directionAt(float x, float y) const;
+
+        //! \brief Pixel whose ray passes closest to a point.
+        //! \return False if the point is behind the eye or outside the image
+        bool project(Vector4 point, int* x, int* y) const;
+    };
+
+    //! \brief Hit points and primitives of the last stored frame.
+    class Cache
+    {
+    public:
+        using TriangleFetch = std::function<BVH::Triangle(std::uint32_t)>;
+
+        //! \brief Remember the hits of a traced frame.
+        //! \param[in] gbuffer Hits along the normalized view directions, width x height entries
+        void store(const View& view, const Shading::GBuffer& gbuffer);
+
+        void clear();
+
+        bool empty() const { return m_width == 0; }
+
+        //! \brief Fill a G-buffer for a new view from the stored hits.
+        //! \param[out] gbuffer Validated hits, resized to the view
+        //! \param[out] trace 1 for the pixels that still need a ray traced
+        //! \param[in] fetch Triangle of a primitive index
+        //! \return Number of pixels to trace
+        std::size_t reproject(const View& view, Shading::GBuffer& gbuffer,
+                              std::vector<std::uint8_t>& trace, const TriangleFetch& fetch) const;
+
+    private:
+        int m_width = 0, m_height = 0;
+        std::vector<float> m_x, m_y, m_z;
+        std::vector<std::uint32_t> m_primitive;
+        std::vector<std::uint8_t> m_hit;
+    };
+};
+
+#endif
@@ -0,0 +1,264 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "Shading.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+using Shading::Method;
+
+constexpr float HALF_PI = 1.57079632679f;
+
+float clampColor(float c)
+{
+    return std::min(std::max(c, 0.0f), 255.0f);
+}
+
+// atan for x >= 0 within 1e-5, unlike std::atan it vectorizes.
+// Reduced to [0, 1] with atan(x) = pi/2 - atan(1/x).
+float atanPositive(float x)
+{
+    const bool large = x > 1.0f;
+    const float z = std::min(x, 1.0f / x);
+    const float z2 = z * z;
+    const float p = z * (0.99997726f + z2 * (-0.33262347f + z2 * (0.19354346f + z2 * (-0.11643287f
+                    + z2 * (0.05265332f - z2 * 0.01172120f)))));
+    return large ? HALF_PI - p : p;
+}
+
+// Misses are shaded as hits at distance 0 and then weighted by 0. Selecting
+// the inputs rather than the results keeps the loop free of branches.
+template <Method M>
+void shadeSpan(const Shading::GBuffer& gbuffer, std::size_t begin, std::size_t count,
+               const Shading::Lighting& lighting, const float direction[3], const float step[3],
+               float* __restrict r, float* __restrict g, float* __restrict b)
+{
+    const float* __restrict ts = gbuffer.t.data() + begin;
+    const float* __restrict nxs = gbuffer.normal_x.data() + begin;
+    const float* __restrict nys = gbuffer.normal_y.data() + begin;
+    const float* __restrict nzs = gbuffer.normal_z.data() + begin;
+    const std::uint32_t* __restrict ids = gbuffer.primitive.data() + begin;
+    const float* __restrict visibility = gbuffer.visibility.data() + begin;
+    const float* __restrict costs = gbuffer.cost.data() + begin;
+    const Shading::Lighting l = lighting;
+    const float d0x = direction[0], d0y = direction[1], d0z = direction[2];
+    const float sx = step[0], sy = step[1], sz = step[2];
+
+    const int n = static_cast<int>(count);
+#pragma omp simd
+    for (int i = 0; i < n; ++i) {
+        const bool hit = ts[i] < std::numeric_limits<float>::max();
+        const float t = hit ? ts[i] : 0.0f;
+        const float coverage = hit || M == Method::Cost ? 1.0f : 0.0f;
+        const float nx = nxs[i], ny = nys[i], nz = nzs[i];
+        float cr, cg, cb;
+
+        if constexpr (M == Method::Depth) {
+            // Map t from [0, inf[ to [0, 1[, white is close
+            const float tn = atanPositive(t) / HALF_PI;
+            cr = cg = cb = tn * tn * 255.0f;
+        } else if constexpr (M == Method::Normal) {
+            cr = clampColor((nx + 1.0f) * 128.0f);
+            cg = clampColor((ny + 1.0f) * 128.0f);
+            cb = clampColor((nz + 1.0f) * 128.0f);
+        } else if constexpr (M == Method::AmbientOcclusion) {
+            cr = cg = cb = 255.0f * visibility[i];
+        } else if constexpr (M == Method::Cost) {
+            // Blue through green to red as the cost approaches max_cost
+            const float x = std::min(costs[i] / l.max_cost, 1.0f);
+            cr = clampColor(255.0f * (1.5f - std::abs(4.0f * x - 3.0f)));
+            cg = clampColor(255.0f * (1.5f - std::abs(4.0f * x - 2.0f)));
+            cb = clampColor(255.0f * (1.5f - std::abs(4.0f * x - 1.0f)));
+        } else {
+            float dx = d0x + i * sx, dy = d0y + i * sy, dz = d0z + i * sz;
+            const float inv_length = 1.0f / std::sqrt(dx * dx + dy * dy + dz * dz);
+            dx *= inv_length;
+            dy *= inv_length;
+            dz *= inv_length;
+
+            if constexpr (M == Method::Primitive) {
+                // Flat color per triangle, dimmed by the angle to the view
+                const std::uint32_t h = ids[i] * 2654435761u;
+                const float facing = 0.3f + 0.7f * std::abs(nx * dx + ny * dy + nz * dz);
+                cr = float(int(h >> 24)) * facing;
+                cg = float(int((h >> 16) & 0xff)) * facing;
+                cb = float(int((h >> 8) & 0xff)) * facing;
+            } else {
+                // Phong https://en.wikipedia.org/wiki/Phong_reflection_model
+                const float px = l.eye[0] + t * dx, py = l.eye[1] + t * dy, pz = l.eye[2] + t * dz;
+                float lx = l.light[0] - px, ly = l.light[1] - py, lz = l.light[2] - pz;
+                const float inv_light = 1.0f / std::sqrt(lx * lx + ly * ly + lz * lz);
+                lx *= inv_light;
+                ly *= inv_light;
+                lz *= inv_light;
+
+                const float diffuse = lx * nx + ly * ny + lz * nz;
+                float rx = lx - 2.0f * diffuse * nx, ry = ly - 2.0f * diffuse * ny, rz = lz - 2.0f * diffuse * nz;
+                const float inv_reflection = 1.0f / std::sqrt(rx * rx + ry * ry + rz * rz);
+                const float specular = std::max((rx * dx + ry * dy + rz * dz) * inv_reflection, 0.0f);
+
+                float kd = 0.8f * std::max(diffuse, 0.0f);
+                float ks = 0.5f * specular * std::sqrt(specular); // specular^1.5
+                if constexpr (M == Method::Shadow) {
+                    kd *= visibility[i];
+                    ks *= visibility[i];
+                }
+                cr = clampColor(0.25f * l.ambient[0] + kd * l.material[0] + ks * l.specular[0]);
+                cg = clampColor(0.25f * l.ambient[1] + kd * l.material[1] + ks * l.specular[1]);
+                cb = clampColor(0.25f * l.ambient[2] + kd * l.material[2] + ks * l.specular[2]);
+            }
+        }
+
+        r[i] = cr * coverage;
+        g[i] = cg * coverage;
+        b[i] = cb * coverage;
+    }
+}
+
+}
+
+namespace Shading {
+
+Method fromIndex(int index)
+{
+    switch (index) {
+    case 1:
+        return Method::Depth;
+    case 2:
+        return Method::Normal;
+    case 3:
+        return Method::Primitive;
+    case 4:
+        return Method::Shadow;
+    case 5:
+        return Method::AmbientOcclusion;
+    case 6:
+        return Method::Cost;
+    default:
+        return Method::Phong;
+    }
+}
+
+bool needsVisibility(Method method)
+{
+    return method == Method::Shadow || method == Method::AmbientOcclusion;
+}
+
+void GBuffer::resize(std::size_t size)
+{
+    t.resize(size);
+    normal_x.resize(size);
+    normal_y.resize(size);
+    normal_z.resize(size);
+    primitive.resize(size);
+    visibility.resize(size);
+    cost.resize(size);
+}
+
+std::size_t findEdges(const GBuffer& gbuffer, int width, int height, int y,
+                      const EdgeThresholds& thresholds, std::uint8_t* edges)
+{
+    const auto differs = [&](std::size_t i, std::size_t j)
+    {
+        const float ti = gbuffer.t[i], tj = gbuffer.t[j];
+        const bool hit_i = ti < std::numeric_limits<float>::max();
+        const bool hit_j = tj < std::numeric_limits<float>::max();
+        if (hit_i != hit_j)
+            return true;
+        if (!hit_i)
+            return false;
+        const float cosine = gbuffer.normal_x[i] * gbuffer.normal_x[j] + gbuffer.normal_y[i] * gbuffer.normal_y[j]
+                             + gbuffer.normal_z[i] * gbuffer.normal_z[j];
+        return gbuffer.primitive[i] != gbuffer.primitive[j]
+               || std::abs(ti - tj) > thresholds.depth * std::min(ti, tj)
+               || cosine < thresholds.normal;
+    };
+
+    std::size_t count = 0;
+    const std::size_t row = std::size_t(y) * width;
+    for (int x = 0; x < width; ++x) {
+        const std::size_t i = row + x;
+        const bool edge = (x > 0 && differs(i, i - 1)) || (x + 1 < width && differs(i, i + 1))
+                          || (y > 0 && differs(i, i - width)) || (y + 1 < height && differs(i, i + width));
+        edges[x] = edge;
+        count += edge;
+    }
+    return count;
+}
+
+void cosineDirections(const float normal[3], int strata, std::uint32_t seed,
+                      float* x, float* y, float* z)
+{
+    // Orthonormal basis around the normal, Duff et al. 2017
+    const float nx = normal[0], ny = normal[1], nz = normal[2];
+    const float sign = std::copysign(1.0f, nz);
+    const float a = -1.0f / (sign + nz);
+    const float c = nx * ny * a;
+    const float tx = 1.0f + sign * nx * nx * a, ty = sign * c, tz = -sign * nx;
+    const float bx = c, by = sign + ny * ny * a, bz = -ny;
+
+    const float cell = 1.0f / strata;
+    // xorshift32, which must not start at 0
+    std::uint32_t state = seed != 0 ? seed : 0x9e3779b9u;
+    auto next = [&state]
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return (state >> 8) * (1.0f / 16777216.0f);
+    };
+
+    for (int j = 0; j < strata; ++j)
+        for (int i = 0; i < strata; ++i) {
+            const float u = (i + next()) * cell;
+            const float v = (j + next()) * cell;
+            // Uniform on the disk, projected up to the hemisphere
+            const float r = std::sqrt(u);
+            const float phi = 2.0f * 3.14159265f * v;
+            const float lx = r * std::cos(phi), ly = r * std::sin(phi);
+            const float lz = std::sqrt(std::max(0.0f, 1.0f - u));
+            const int k = i + j * strata;
+            x[k] = lx * tx + ly * bx + lz * nx;
+            y[k] = lx * ty + ly * by + lz * ny;
+            z[k] = lx * tz + ly * bz + lz * nz;
+        }
+}
+
+void shade(Method method, const GBuffer& gbuffer, std::size_t begin, std::size_t count,
+           const Lighting& lighting, const float direction[3], const float step[3],
+           float* r, float* g, float* b)
+{
+    switch (method) {
+    case Method::Depth:
+        shadeSpan<Method::Depth>(gbuffer, begin, count, lighting, direction, step, r, g, b);
+        break;
+    case Method::Normal:
+        shadeSpan<Method::Normal>(gbuffer, begin, count, lighting, direction, step, r, g, b);
+        break;
+    case Method::Primitive:
+        shadeSpan<Method::Primitive>(gbuffer, begin, count, lighting, direction, step, r, g, b);
+        break;
+    case Method::Shadow:
+        shadeSpan<Method::Shadow>(gbuffer, begin, count, lighting, direction, step, r, g, b);
+        break;
+    case Method::AmbientOcclusion:
+        shadeSpan<Method::AmbientOcclusion>(gbuffer, begin, count, lighting, direction, step, r, g, b);
+        break;
+    case Method::Cost:
+        shadeSpan<Method::Cost>(gbuffer, begin, count, lighting, direction, step, r, g, b);
+        break;
+    default:
+        shadeSpan<Method::Phong>(gbuffer, begin, count, lighting, direction, step, r, g, b);
+        break;
+    }
+}
+
+}
@@ -0,0 +1,95 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#ifndef WALDO_SHADING_HPP_
+#define WALDO_SHADING_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//! \brief Deferred shading of primary ray hits.
+//! \details Tracing fills a G-buffer, which is then shaded a span of
+//!          consecutive entries at a time. Each method has its own kernel
+//!          without branches, so the compiler vectorizes it.
+namespace Shading {
+    //! \brief Render methods, numbered as the keys selecting them in raytrace.
+    //! \details Shadow is Phong lit only where the light is visible,
+    //!          AmbientOcclusion shades by the open part of the hemisphere
+    //!          and Cost is a heatmap of GBuffer::cost, also where rays miss.
+    enum class Method { Phong = 0, Depth = 1, Normal = 2, Primitive = 3, Shadow = 4, AmbientOcclusion = 5,
+                        Cost = 6 };
+
+    //! \brief Method for a number key, Phong for unassigned ones.
+    Method fromIndex(int index);
+
+    //! \brief True for methods shading with GBuffer::visibility, traced with secondary rays.
+    bool needsVisibility(Method method);
+
+    //! \brief Hits of primary rays in structure of arrays layout.
+    //! \details t is infinity where the ray missed. visibility is the
+    //!          unoccluded fraction of the secondary rays from the hit.
+    //!          cost is the number of boxes and triangles the primary ray
+    //!          tested, only traced for Method::Cost.
+    struct GBuffer
+    {
+        std::vector<float> t;
+        std::vector<float> normal_x, normal_y, normal_z;
+        std::vector<std::uint32_t> primitive;
+        std::vector<float> visibility;
+        std::vector<float> cost;
+
+        void resize(std::size_t size);
+        std::size_t size() const { return t.size(); }
+    };
+
+    //! \brief Differences between neighbouring hits that make an edge.
+    struct EdgeThresholds
+    {
+        float depth = 0.05f;  //!< Largest difference of t relative to the nearer hit
+        float normal = 0.9f;  //!< Smallest cosine of the angle between the normals
+    };
+
+    //! \brief Mark the entries of a row that are on an edge.
+    //! \details An entry is on an edge if a 4-neighbour differs from it in
+    //!          coverage, primitive, depth or normal. Both sides of an edge
+    //!          are marked.
+    //! \param[in] gbuffer width x height entries
+    //! \param[out] edges 1 for the entries of row y on an edge, 0 for the rest, width values
+    //! \return Number of entries marked
+    std::size_t findEdges(const GBuffer& gbuffer, int width, int height, int y,
+                          const EdgeThresholds& thresholds, std::uint8_t* edges);
+
+    //! \brief Scene constants, colors are rgb in [0, 255].
+    struct Lighting
+    {
+        float eye[3] = {0.0f, 0.0f, 0.0f};
+        float light[3] = {100.0f, -100.0f, 100.0f};
+        float ambient[3] = {255.0f, 0.0f, 0.0f};
+        float material[3] = {245.0f, 213.0f, 127.0f};
+        float specular[3] = {255.0f, 255.0f, 255.0f};
+        float max_cost = 256.0f; //!< Cost shown in the hottest color by Method::Cost
+    };
+
+    //! \brief Cosine weighted directions in the hemisphere around a normal.
+    //! \details One direction in each cell of a strata x strata grid over the
+    //!          unit square, at a position within the cell chosen by seed.
+    //! \param[in] normal Unit normal
+    //! \param[out] x, y, z Unit directions, strata * strata values each
+    void cosineDirections(const float normal[3], int strata, std::uint32_t seed,
+                          float* x, float* y, float* z);
+
+    //! \brief Shade count G-buffer entries starting at begin.
+    //! \param[in] direction Direction of the ray of the first entry, not normalized
+    //! \param[in] step Change of the direction from one entry to the next
+    //! \param[out] r, g, b Color channels in [0, 255], count values each
+    void shade(Method method, const GBuffer& gbuffer, std::size_t begin, std::size_t count,
+               const Lighting& lighting, const float direction[3], const float step[3],
+               float* r, float* g, float* b);
+};
+
+#endif
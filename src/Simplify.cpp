@@ -0,0 +1,309 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "Simplify.hpp"
+
+#include "IndexMesh.hpp"
+#include "MappedFile.hpp"
+#include "MeshFile.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+
+constexpr char MAGIC[8] = {'W', 'A', 'L', 'D', 'O', 'L', 'O', 'D'};
+constexpr std::uint32_t VERSION = 1;
+
+std::uint64_t mix(std::uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+//! \brief Symmetric 4x4 matrix of a sum of plane quadrics, upper triangle row by row.
+struct Quadric
+{
+    double q[10] = {};
+};
+
+//! \brief Item indices sorted by key, the items with key k in [offsets[k], offsets[k + 1]).
+struct Groups
+{
+    std::vector<std::uint32_t> offsets, items;
+};
+
+//! \brief Counting sort, keeping items with equal keys in index order.
+Groups group(const std::vector<std::uint32_t>& keys, std::size_t num_keys)
+{
+    Groups groups;
+    groups.offsets.assign(num_keys + 1, 0);
+    for (std::uint32_t key : keys)
+        ++groups.offsets[key + 1];
+    std::partial_sum(groups.offsets.begin(), groups.offsets.end(), groups.offsets.begin());
+    std::vector<std::uint32_t> cursor(groups.offsets.begin(), groups.offsets.end() - 1);
+    groups.items.resize(keys.size());
+    for (std::size_t i = 0; i < keys.size(); ++i)
+        groups.items[cursor[keys[i]]++] = i;
+    return groups;
+}
+
+//! \brief Point minimizing the quadric, false if it is not unique.
+bool minimize(const Quadric& quadric, double* x, double* y, double* z)
+{
+    const double* q = quadric.q;
+    // A x = -b with A = [q0 q1 q2; q1 q4 q5; q2 q5 q7] and b = [q3 q6 q8]
+    const double a00 = q[0], a01 = q[1], a02 = q[2], a11 = q[4], a12 = q[5], a22 = q[7];
+    const double c00 = a11 * a22 - a12 * a12;
+    const double c01 = a02 * a12 - a01 * a22;
+    const double c02 = a01 * a12 - a02 * a11;
+    const double det = a00 * c00 + a01 * c01 + a02 * c02;
+    const double trace = a00 + a11 + a22;
+    // Flat or creased clusters have no single best point
+    if (!(std::abs(det) > 1e-6 * trace * trace * trace))
+        return false;
+    const double c11 = a00 * a22 - a02 * a02;
+    const double c12 = a01 * a02 - a00 * a12;
+    const double c22 = a00 * a11 - a01 * a01;
+    const double bx = -q[3], by = -q[6], bz = -q[8];
+    *x = (c00 * bx + c01 * by + c02 * bz) / det;
+    *y = (c01 * bx + c11 * by + c12 * bz) / det;
+    *z = (c02 * bx + c12 * by + c22 * bz) / det;
+    return true;
+}
+
+template<class T>
+void append(std::string& out, const T& value)
+{
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<class T>
+T take(std::string_view& buffer)
+{
+    if (buffer.size() < sizeof(T))
+        throw std::runtime_error("Truncated level of detail data");
+    T value;
+    std::memcpy(&value, buffer.data(), sizeof(T));
+    buffer.remove_prefix(sizeof(T));
+    return value;
+}
+
+}
+
+namespace Simplify {
+
+BVH::IndexedMesh simplify(const BVH::IndexedMesh& mesh, float cell_size)
+{
+    std::vector<std::uint32_t> clusters;
+    const std::size_t num_clusters = MeshIndexer::cluster(mesh.vertices, cell_size, clusters);
+
+    // Corners and vertices grouped by cluster, in index order, so the sums
+    // below do not depend on the number of threads
+    const std::int64_t num_tris = mesh.triangles.size();
+    std::vector<std::uint32_t> corner_clusters(3 * num_tris);
+#pragma omp parallel for
+    for (std::int64_t i = 0; i < num_tris; ++i)
+        for (int j = 0; j < 3; ++j)
+            corner_clusters[3*i+j] = clusters[mesh.triangles[i][j]];
+    const Groups corners = group(corner_clusters, num_clusters);
+    corner_clusters = {};
+    const Groups vertices = group(clusters, num_clusters);
+
+    // Each cluster is placed at the point minimizing its area weighted plane
+    // quadric, or the mean of its vertices if that is not unique or too far
+    // from them
+    std::vector<Vector4> points(num_clusters);
+    const std::int64_t n = num_clusters;
+#pragma omp parallel for schedule(dynamic, 1024)
+    for (std::int64_t k = 0; k < n; ++k) {
+        Quadric quadric;
+        for (std::uint32_t g = corners.offsets[k]; g < corners.offsets[k + 1]; ++g) {
+            const BVH::IndexedTriangle& tri = mesh.triangles[corners.items[g] / 3];
+            const Vector4 p0 = mesh.vertex(tri[0]);
+            const Vector4 normal = (mesh.vertex(tri[1]) - p0).cross3(mesh.vertex(tri[2]) - p0);
+            const double length = normal.length3();
+            if (length == 0.0)
+                continue;
+            // Unit plane weighted by the area, 0.5 n n^T / |n| for the cross product n
+            const double w = 0.5 / length;
+            const double a = normal.x, b = normal.y, c = normal.z, d = -normal.dot3(p0);
+            const double plane[10] = {a * a, a * b, a * c, a * d, b * b, b * c, b * d, c * c, c * d, d * d};
+            for (int i = 0; i < 10; ++i)
+                quadric.q[i] += w * plane[i];
+        }
+        double x = 0.0, y = 0.0, z = 0.0;
+        for (std::uint32_t g = vertices.offsets[k]; g < vertices.offsets[k + 1]; ++g) {
+            const auto& v = mesh.vertices[vertices.items[g]];
+            x += v[0];
+            y += v[1];
+            z += v[2];
+        }
+        const double count = vertices.offsets[k + 1] - vertices.offsets[k];
+        const Vector4 mean(x / count, y / count, z / count);
+        if (minimize(quadric, &x, &y, &z)) {
+            const Vector4 best(x, y, z);
+            points[k] = (best - mean).length3() <= cell_size ? best : mean;
+        } else {
+            points[k] = mean;
+        }
+    }
+
+    // Triangles spanning three clusters, welding drops the duplicates
+    std::vector<BVH::Triangle> tris;
+    tris.reserve(mesh.triangles.size());
+    for (const auto& tri : mesh.triangles) {
+        const std::uint32_t a = clusters[tri[0]], b = clusters[tri[1]], c = clusters[tri[2]];
+        if (a != b && b != c && a != c)
+            tris.push_back({points[a], points[b], points[c]});
+    }
+    return MeshIndexer::weld(tris);
+}
+
+std::vector<Level> buildLevels(const BVH::IndexedMesh& mesh, int max_levels, std::size_t min_triangles)
+{
+    double edge_sum = 0.0;
+    const std::int64_t num_tris = mesh.triangles.size();
+#pragma omp parallel for reduction(+ : edge_sum)
+    for (std::int64_t i = 0; i < num_tris; ++i) {
+        const BVH::IndexedTriangle& tri = mesh.triangles[i];
+        for (int j = 0; j < 3; ++j)
+            edge_sum += (mesh.vertex(tri[(j + 1) % 3]) - mesh.vertex(tri[j])).length3();
+    }
+    if (num_tris == 0)
+        return {};
+
+    std::vector<Level> levels;
+    float cell_size = edge_sum / (3 * num_tris);
+    float error = 0.0f;
+    std::size_t previous = mesh.triangles.size();
+    // Cells that barely merge anything are skipped, a bounded number of times
+    for (int attempt = 0; attempt < 4 * max_levels && int(levels.size()) < max_levels; ++attempt) {
+        const BVH::IndexedMesh& source = levels.empty() ? mesh : levels.back().mesh;
+        BVH::IndexedMesh simplified = simplify(source, cell_size);
+        if (simplified.triangles.size() < min_triangles)
+            break;
+        if (simplified.triangles.size() < 0.8 * previous) {
+            error += cell_size;
+            previous = simplified.triangles.size();
+            levels.push_back({std::move(simplified), error});
+        }
+        cell_size *= 2.0f;
+    }
+    return levels;
+}
+
+std::size_t select(const std::vector<Level>& levels, float distance, float pixels_per_unit, float pixel_error)
+{
+    std::size_t level = 0;
+    for (std::size_t i = 0; i < levels.size(); ++i)
+        if (levels[i].error * pixels_per_unit <= pixel_error * distance)
+            level = i + 1;
+    return level;
+}
+
+float boxDistance(const float point[3], const float lower[3], const float upper[3])
+{
+    float sum = 0.0f;
+    for (int a = 0; a < 3; ++a) {
+        const float d = std::max({lower[a] - point[a], 0.0f, point[a] - upper[a]});
+        sum += d * d;
+    }
+    return std::sqrt(sum);
+}
+
+std::uint64_t fingerprint(const BVH::IndexedMesh& mesh, int max_levels, std::size_t min_triangles)
+{
+    std::uint64_t h = mix(VERSION ^ mix(max_levels ^ mix(min_triangles)));
+    h = mix(h ^ mesh.vertices.size());
+    for (const auto& v : mesh.vertices)
+        h = mix(h ^ (std::uint64_t(std::bit_cast<std::uint32_t>(v[0])) << 32
+                     ^ std::bit_cast<std::uint32_t>(v[1]) ^ std::uint64_t(std::bit_cast<std::uint32_t>(v[2])) << 16));
+    h = mix(h ^ mesh.triangles.size());
+    for (const auto& tri : mesh.triangles)
+        h = mix(h ^ (std::uint64_t(tri[0]) << 40 ^ std::uint64_t(tri[1]) << 20 ^ tri[2]));
+    return h;
+}
+
+std::string encode(const std::vector<Level>& levels, std::uint64_t key)
+{
+    std::string out(MAGIC, sizeof(MAGIC));
+    append(out, VERSION);
+    append(out, std::uint32_t(levels.size()));
+    append(out, key);
+    for (const auto& level : levels) {
+        const std::string data = MeshFile::encode(level.mesh);
+        append(out, level.error);
+        append(out, std::uint64_t(data.size()));
+        out += data;
+    }
+    return out;
+}
+
+std::vector<Level> decode(std::string_view buffer, std::uint64_t key)
+{
+    if (buffer.size() < sizeof(MAGIC) || std::memcmp(buffer.data(), MAGIC, sizeof(MAGIC)) != 0)
+        throw std::runtime_error("Not level of detail data");
+    buffer.remove_prefix(sizeof(MAGIC));
+    if (const auto version = take<std::uint32_t>(buffer); version != VERSION)
+        throw std::runtime_error(fmt::format("Unsupported level of detail version {}", version));
+    const auto count = take<std::uint32_t>(buffer);
+    if (take<std::uint64_t>(buffer) != key)
+        throw std::runtime_error("Level of detail data is for another mesh");
+
+    std::vector<Level> levels(count);
+    for (auto& level : levels) {
+        level.error = take<float>(buffer);
+        const auto size = take<std::uint64_t>(buffer);
+        if (buffer.size() < size)
+            throw std::runtime_error("Truncated level of detail data");
+        level.mesh = MeshFile::read(buffer.substr(0, size), nullptr, false);
+        buffer.remove_prefix(size);
+    }
+    return levels;
+}
+
+std::vector<Level> cachedLevels(const std::string& path, const BVH::IndexedMesh& mesh, int max_levels,
+                                std::size_t min_triangles)
+{
+    if (path.empty())
+        return buildLevels(mesh, max_levels, min_triangles);
+
+    const std::uint64_t key = fingerprint(mesh, max_levels, min_triangles);
+    if (std::filesystem::exists(path)) {
+        try {
+            const MappedFile file(path);
+            return decode(file.view(), key);
+        } catch (const std::exception&) {
+            // Stale or damaged, rebuilt below
+        }
+    }
+
+    // The cache only saves time next run, so failing to write it is not an error
+    auto levels = buildLevels(mesh, max_levels, min_triangles);
+    const std::string data = encode(levels, key);
+    std::ofstream file(std::filesystem::path(path), std::ios::binary);
+    file.write(data.data(), data.size());
+    if (!file)
+        std::cerr << fmt::format("Error writing {}, levels are not cached", path) << std::endl;
+    return levels;
+}
+
+}
@@ -0,0 +1,72 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#ifndef WALDO_SIMPLIFY_HPP_
+#define WALDO_SIMPLIFY_HPP_
+
+#include "bvh.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//! \brief Levels of detail of a mesh.
+//! \details Meshes are simplified by quadric error vertex clustering: the
+//!          vertices in each cell of a grid are merged into the point
+//!          minimizing the summed squared distances to the planes of their
+//!          triangles. Each step is a parallel pass over the mesh.
+namespace Simplify {
+    //! \brief A simplified mesh.
+    struct Level
+    {
+        BVH::IndexedMesh mesh;
+        float error = 0.0f; //!< Approximate bound on how far the surface moved, in model units
+    };
+
+    //! \brief Merge the vertices in each cell of a grid.
+    //! \details Triangles collapsing to a line or point are dropped, as are
+    //!          duplicated triangles.
+    BVH::IndexedMesh simplify(const BVH::IndexedMesh& mesh, float cell_size);
+
+    //! \brief Successively coarser levels, not including the mesh itself.
+    //! \details The grid cells start at the mean edge length and
+    //!          double for each level. Levels stop at max_levels or when
+    //!          they would have fewer than min_triangles triangles.
+    std::vector<Level> buildLevels(const BVH::IndexedMesh& mesh, int max_levels,
+                                   std::size_t min_triangles = 256);
+
+    //! \brief Coarsest level whose error projects to at most pixel_error pixels.
+    //! \param[in] distance Distance from the eye to the mesh
+    //! \param[in] pixels_per_unit Pixels covered by one unit at distance 1,
+    //!            the image height over 2 tan(fov / 2)
+    //! \return 0 for the mesh itself, otherwise 1 + the index in levels
+    std::size_t select(const std::vector<Level>& levels, float distance, float pixels_per_unit,
+                       float pixel_error = 1.0f);
+
+    //! \brief Distance from a point to a box, 0 inside.
+    float boxDistance(const float point[3], const float lower[3], const float upper[3]);
+
+    //! \brief Hash of a mesh and the level parameters, identifying a cache.
+    std::uint64_t fingerprint(const BVH::IndexedMesh& mesh, int max_levels, std::size_t min_triangles);
+
+    //! \brief Serialize levels, each as a .wmsh mesh.
+    std::string encode(const std::vector<Level>& levels, std::uint64_t key);
+
+    //! \brief Deserialize levels.
+    //! \details Throws std::runtime_error if the buffer is corrupt or has another key.
+    std::vector<Level> decode(std::string_view buffer, std::uint64_t key);
+
+    //! \brief Levels from a cache file, built and written there if it does not match the mesh.
+    //! \details Failing to write the cache is reported on stderr, the built levels are still returned.
+    //! \param[in] path Cache file, empty to always build
+    std::vector<Level> cachedLevels(const std::string& path, const BVH::IndexedMesh& mesh, int max_levels,
+                                    std::size_t min_triangles = 256);
+};
+
+#endif
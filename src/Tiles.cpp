@@ -0,0 +1,102 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "Tiles.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+std::uint64_t spreadBits(std::uint32_t v)
+{
+    std::uint64_t x = v;
+    x = (x | (x << 16)) & 0x0000FFFF0000FFFFull;
+    x = (x | (x << 8)) & 0x00FF00FF00FF00FFull;
+    x = (x | (x << 4)) & 0x0F0F0F0F0F0F0F0Full;
+    x = (x | (x << 2)) & 0x3333333333333333ull;
+    x = (x | (x << 1)) & 0x5555555555555555ull;
+    return x;
+}
+
+}
+
+namespace Tiles {
+
+std::uint64_t mortonIndex(std::uint32_t x, std::uint32_t y)
+{
+    return spreadBits(x) | spreadBits(y) << 1;
+}
+
+std::uint64_t hilbertIndex(std::uint32_t x, std::uint32_t y, int bits)
+{
+    std::uint64_t d = 0;
+    for (std::uint32_t s = std::uint32_t(1) << (bits - 1); s > 0; s /= 2) {
+        const std::uint32_t rx = (x & s) > 0;
+        const std::uint32_t ry = (y & s) > 0;
+        d += std::uint64_t(s) * s * ((3 * rx) ^ ry);
+        // Rotate the quadrant
+        if (ry == 0) {
+            if (rx == 1) {
+                x = s - 1 - x;
+                y = s - 1 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return d;
+}
+
+std::vector<Tile> split(int width, int height, int tile_size, Order order)
+{
+    tile_size = std::max(tile_size, 1);
+    const int nx = (width + tile_size - 1) / tile_size;
+    const int ny = (height + tile_size - 1) / tile_size;
+
+    int bits = 1;
+    while ((1 << bits) < std::max(nx, ny))
+        ++bits;
+
+    std::vector<std::pair<std::uint64_t, Tile>> keyed;
+    keyed.reserve(std::size_t(nx) * ny);
+    for (int ty = 0; ty < ny; ++ty)
+        for (int tx = 0; tx < nx; ++tx) {
+            std::uint64_t key = std::uint64_t(ty) * nx + tx;
+            if (order == Order::Morton)
+                key = mortonIndex(tx, ty);
+            else if (order == Order::Hilbert)
+                key = hilbertIndex(tx, ty, bits);
+            keyed.push_back({key, {tx * tile_size, ty * tile_size,
+                                   std::min((tx + 1) * tile_size, width),
+                                   std::min((ty + 1) * tile_size, height)}});
+        }
+
+    std::sort(keyed.begin(), keyed.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    std::vector<Tile> tiles;
+    tiles.reserve(keyed.size());
+    for (const auto& [key, tile] : keyed)
+        tiles.push_back(tile);
+    return tiles;
+}
+
+Order parseOrder(std::string_view name)
+{
+    if (name == "scanline")
+        return Order::Scanline;
+    if (name == "morton")
+        return Order::Morton;
+    if (name == "hilbert")
+        return Order::Hilbert;
+    throw std::runtime_error(fmt::format("Unknown tile order {}", name));
+}
+
+}
@@ -0,0 +1,45 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#ifndef WALDO_TILES_HPP_
+#define WALDO_TILES_HPP_
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+//! \brief Split of an image into tiles for parallel rendering.
+//! \details Tiles are ordered along a space filling curve so consecutive
+//!          tiles, and the rays traced in them, are spatially coherent.
+namespace Tiles {
+    enum class Order { Scanline, Morton, Hilbert };
+
+    //! \brief Pixel rectangle [x0, x1) x [y0, y1).
+    struct Tile
+    {
+        int x0, y0, x1, y1;
+    };
+
+    //! \brief Split an image into tiles.
+    //! \param[in] width Image width in pixels
+    //! \param[in] height Image height in pixels
+    //! \param[in] tile_size Tile width and height, edge tiles are cropped
+    //! \param[in] order Order of the tiles
+    std::vector<Tile> split(int width, int height, int tile_size, Order order);
+
+    //! \brief Index of a cell along the Hilbert curve of a 2^bits grid.
+    std::uint64_t hilbertIndex(std::uint32_t x, std::uint32_t y, int bits);
+
+    //! \brief Index of a cell along the Morton curve.
+    std::uint64_t mortonIndex(std::uint32_t x, std::uint32_t y);
+
+    //! \brief Parse an order name, scanline, morton or hilbert.
+    //! \details Throws std::runtime_error on unknown names.
+    Order parseOrder(std::string_view name);
+};
+
+#endif
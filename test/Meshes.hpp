@@ -0,0 +1,74 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#ifndef WALDO_TEST_MESHES_HPP_
+#define WALDO_TEST_MESHES_HPP_
+
+#include "bvh.hpp"
+
+#include "IndexMesh.hpp"
+
+#include <cmath>
+#include <numbers>
+#include <vector>
+
+//! \brief Synthetic triangle soups shared by the tests.
+namespace Meshes {
+    //! \brief Height field over an n x n grid of unit squares, two triangles each.
+    //! \param[in] height Function of the grid indices (i, j) giving z
+    template <class Height>
+    std::vector<BVH::Triangle> heightField(int n, Height height)
+    {
+        std::vector<BVH::Triangle> tris;
+        tris.reserve(2 * std::size_t(n) * n);
+        for (int i = 0; i < n; ++i)
+            for (int j = 0; j < n; ++j) {
+                const Vector4 a(i, j, height(i, j));
+                const Vector4 b(i + 1, j, height(i + 1, j));
+                const Vector4 c(i, j + 1, height(i, j + 1));
+                const Vector4 d(i + 1, j + 1, height(i + 1, j + 1));
+                tris.push_back({a, b, d});
+                tris.push_back({a, d, c});
+            }
+        return tris;
+    }
+
+    //! \brief Flat n x n grid at z = 0.
+    inline std::vector<BVH::Triangle> grid(int n)
+    {
+        return heightField(n, [](int, int) { return 0.0f; });
+    }
+
+    //! \brief Unit sphere of 4 n^2 triangles, as a latitude longitude grid.
+    //! \details The triangles at the poles are degenerate.
+    inline std::vector<BVH::Triangle> sphere(int n)
+    {
+        const auto point = [n](int i, int j)
+        {
+            const float theta = std::numbers::pi_v<float> * i / n;
+            const float phi = std::numbers::pi_v<float> * j / n;
+            return Vector4(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta));
+        };
+        std::vector<BVH::Triangle> tris;
+        tris.reserve(4 * std::size_t(n) * n);
+        for (int i = 0; i < n; ++i)
+            for (int j = 0; j < 2 * n; ++j) {
+                const Vector4 a = point(i, j), b = point(i + 1, j), c = point(i, j + 1), d = point(i + 1, j + 1);
+                tris.push_back({a, b, d});
+                tris.push_back({a, d, c});
+            }
+        return tris;
+    }
+
+    //! \brief The sphere welded, without the degenerate triangles.
+    inline BVH::IndexedMesh indexedSphere(int n)
+    {
+        return MeshIndexer::weld(sphere(n), 1e-5f);
+    }
+};
+
+#endif
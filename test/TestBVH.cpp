@@ -0,0 +1,102 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include <gtest/gtest.h>
+
+#include "bvh.hpp"
+
+#include "IndexMesh.hpp"
+#include "Meshes.hpp"
+
+#include <fmt/format.h>
+
+#include <atomic>
+#include <cmath>
+#include <stdexcept>
+
+TEST(TestBVH, TraversalStats)
+{
+    auto tris = Meshes::grid(16);
+    BVH::IndexedMesh mesh = MeshIndexer::weld(tris);
+    BVH::IndexedAABBTree tree(mesh, 0.001f);
+
+    BVH::TraversalStats stats, occlusion;
+    for (float x = 0.25f; x < 16.0f; x += 1.5f) {
+        const Vector4 origin(x, x / 2, 5.0f);
+        const Vector4 direction(0.0f, 0.0f, -1.0f);
+        float t1, t2;
+        Vector4 pt1, pt2, n1, n2;
+        std::uint32_t p1, p2;
+        // Counting does not change the result
+        ASSERT_TRUE(tree.does_intersect_ray(origin, direction, &t1, &pt1, &n1, &p1));
+        ASSERT_TRUE(tree.does_intersect_ray(origin, direction, &t2, &pt2, &n2, &p2, stats));
+        EXPECT_EQ(t1, t2);
+        EXPECT_EQ(p1, p2);
+        EXPECT_TRUE(tree.is_occluded(origin, direction, 10.0f, occlusion));
+    }
+
+    EXPECT_EQ(stats.queries, 11);
+    EXPECT_GE(stats.hits, stats.queries);
+    EXPECT_GE(stats.triangles, stats.hits);
+    EXPECT_GT(stats.nodes, stats.queries);
+    EXPECT_GE(stats.boxes, stats.nodes);
+    // Occlusion stops at the first hit
+    EXPECT_EQ(occlusion.queries, 11);
+    EXPECT_EQ(occlusion.hits, occlusion.queries);
+    EXPECT_LE(occlusion.triangles, stats.triangles);
+
+    stats += occlusion;
+    EXPECT_EQ(stats.queries, 22);
+}
+
+TEST(TestBVH, TreeReport)
+{
+    auto tris = Meshes::grid(16);
+    BVH::IndexedMesh mesh = MeshIndexer::weld(tris);
+    BVH::IndexedAABBTree tree(mesh, 0.001f);
+    const BVH::TreeReport report = tree.report();
+
+    EXPECT_EQ(report.triangles, tris.size());
+    EXPECT_EQ(report.vertices, 17 * 17);
+    EXPECT_EQ(report.nodes, 2 * report.leaves - 1);
+    std::size_t leaves = 0, triangles = 0;
+    for (std::size_t depth = 0; depth < report.depth_histogram.size(); ++depth)
+        leaves += report.depth_histogram[depth];
+    EXPECT_EQ(leaves, report.leaves);
+    EXPECT_EQ(report.depth_histogram.size(), report.max_depth + 1);
+    for (std::size_t bucket = 0; bucket < report.leaf_size_histogram.size(); ++bucket)
+        triangles += report.leaf_size_histogram[bucket] << bucket;
+    EXPECT_LE(triangles, report.triangles);
+
+    // Rays straight down hit the root, so they test about as much as estimated
+    EXPECT_GT(report.sah_cost, 1.0);
+    EXPECT_LT(report.sah_cost, 4.0 * std::log2(double(report.triangles)));
+    EXPECT_GE(report.mean_sibling_overlap, 0.0);
+    EXPECT_LE(report.mean_sibling_overlap, 1.0);
+    EXPECT_GE(report.mean_empty_space, 0.0);
+    EXPECT_LE(report.mean_empty_space, 1.0);
+
+    // Two nodes per triangle are allocated up front
+    EXPECT_EQ(report.node_bytes + report.unused_node_bytes, 2 * tris.size() * sizeof(BVH::IndexedNode));
+    EXPECT_GE(report.triangle_bytes, tris.size() * sizeof(BVH::IndexedTriangle));
+    EXPECT_GE(report.vertex_bytes, 17 * 17 * 3 * sizeof(float));
+
+    const std::string json = report.json();
+    EXPECT_EQ(json.front(), '{');
+    EXPECT_NE(json.find("\"sah_cost\": "), std::string::npos);
+    EXPECT_NE(json.find(fmt::format("\"total_bytes\": {}}}", report.total_bytes())), std::string::npos);
+}
+
+TEST(TestBVH, CancelBuild)
+{
+    auto tris = Meshes::grid(16);
+    std::atomic<bool> cancel{true};
+    EXPECT_THROW(BVH::AABBTree(tris, 0.001f, cancel), std::runtime_error);
+    cancel = false;
+    BVH::AABBTree tree(tris, 0.001f, cancel);
+    EXPECT_EQ(tree.report().triangles, tris.size());
+}
@@ -0,0 +1,90 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include <gtest/gtest.h>
+
+#include "bvh.hpp"
+
+#include "Culling.hpp"
+
+namespace {
+
+// Orthographic projection of the box [x0, x1] x [y0, y1] x [-z1, -z0] looking down -z
+std::array<float,16> ortho(float x0, float x1, float y0, float y1, float z0, float z1)
+{
+    std::array<float,16> m{};
+    m[0] = 2 / (x1 - x0);
+    m[5] = 2 / (y1 - y0);
+    m[10] = -2 / (z1 - z0);
+    m[12] = -(x1 + x0) / (x1 - x0);
+    m[13] = -(y1 + y0) / (y1 - y0);
+    m[14] = -(z1 + z0) / (z1 - z0);
+    m[15] = 1;
+    return m;
+}
+
+}
+
+TEST(TestCulling, Classify)
+{
+    const auto matrix = ortho(0, 10, 0, 10, 1, 100);
+    const auto frustum = Culling::Frustum::fromMatrix(matrix.data());
+
+    const float lower[3] = {1, 1, -5}, upper[3] = {2, 2, -4};
+    EXPECT_EQ(frustum.classify(lower, upper), Culling::Side::Inside);
+    const float lower2[3] = {-1, 1, -5}, upper2[3] = {2, 2, -4};
+    EXPECT_EQ(frustum.classify(lower2, upper2), Culling::Side::Intersecting);
+    const float lower3[3] = {11, 1, -5}, upper3[3] = {12, 2, -4};
+    EXPECT_EQ(frustum.classify(lower3, upper3), Culling::Side::Outside);
+    // Behind the near plane
+    const float lower4[3] = {1, 1, 0}, upper4[3] = {2, 2, 0.5f};
+    EXPECT_EQ(frustum.classify(lower4, upper4), Culling::Side::Outside);
+}
+
+TEST(TestCulling, VisibleRanges)
+{
+    // A row of unit triangles along x, z = -5
+    std::vector<BVH::Triangle> tris;
+    for (int i = 0; i < 1000; ++i)
+        tris.push_back({Vector4(i + 0.1f, 0.1f, -5.0f), Vector4(i + 0.9f, 0.1f, -5.0f),
+                        Vector4(i + 0.5f, 0.9f, -5.0f)});
+    BVH::AABBTree tree(tris, 0.0f);
+
+    const auto frustum = Culling::Frustum::fromMatrix(ortho(100, 200, -1, 2, 1, 10).data());
+    std::vector<Culling::Range> ranges;
+    Culling::visibleRanges(tree.root, frustum, 16, ranges);
+    ASSERT_FALSE(ranges.empty());
+
+    // Every triangle in view is drawn, with few others, in ascending ranges
+    std::vector<bool> drawn(tris.size(), false);
+    std::uint32_t end = 0, count = 0;
+    for (const auto& range : ranges) {
+        // Adjacent ranges are merged
+        if (&range != &ranges.front()) {
+            EXPECT_GT(range.first, end);
+        }
+        end = range.first + range.count;
+        count += range.count;
+        for (std::uint32_t i = range.first; i < end; ++i)
+            drawn[i] = true;
+    }
+    for (std::size_t i = 0; i < tris.size(); ++i) {
+        const float x = tris[i].vertices[0].x;
+        if (x > 100.0f && x < 199.0f) {
+            EXPECT_TRUE(drawn[i]) << i;
+        }
+    }
+    EXPECT_LT(count, 200);
+
+    // Everything in view is a single range
+    ranges.clear();
+    Culling::visibleRanges(tree.root, Culling::Frustum::fromMatrix(ortho(-1, 1001, -1, 2, 1, 10).data()), 16,
+                           ranges);
+    ASSERT_EQ(ranges.size(), 1);
+    EXPECT_EQ(ranges[0].first, 0);
+    EXPECT_EQ(ranges[0].count, tris.size());
+}
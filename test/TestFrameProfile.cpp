@@ -0,0 +1,56 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include <gtest/gtest.h>
+
+#include "FrameProfile.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+TEST(TestFrameProfile, RunningAverage)
+{
+    FrameProfile profile({"model", "lines"}, 3);
+    EXPECT_EQ(profile.average(0), 0.0);
+
+    profile.add({1.0, 10.0});
+    profile.add({2.0, 20.0});
+    EXPECT_DOUBLE_EQ(profile.average(0), 1.5);
+    EXPECT_DOUBLE_EQ(profile.average(1), 15.0);
+
+    // The first frame drops out of the window
+    profile.add({3.0, 30.0});
+    profile.add({4.0, 40.0});
+    EXPECT_EQ(profile.size(), 4);
+    EXPECT_DOUBLE_EQ(profile.average(0), 3.0);
+    EXPECT_DOUBLE_EQ(profile.average(1), 30.0);
+    EXPECT_DOUBLE_EQ(profile.total(), 33.0);
+    EXPECT_EQ(profile.summary(), "model 3.00 ms, lines 30.00 ms");
+
+    EXPECT_THROW(profile.add({1.0}), std::invalid_argument);
+}
+
+TEST(TestFrameProfile, Trace)
+{
+    const auto path = std::filesystem::temp_directory_path() / "waldo-test-profile.csv";
+    {
+        FrameProfile profile({"events", "model"});
+        profile.trace(path.string());
+        profile.add({0.5, 2.0});
+        profile.add({0.25, 1.0});
+    }
+    std::ifstream file(path);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    EXPECT_EQ(contents.str(), "frame,events_ms,model_ms\n0,0.5000,2.0000\n1,0.2500,1.0000\n");
+    std::filesystem::remove(path);
+
+    FrameProfile profile({"model"});
+    EXPECT_THROW(profile.trace("/nonexistent/dir/profile.csv"), std::runtime_error);
+}
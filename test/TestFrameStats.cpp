@@ -0,0 +1,39 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include <gtest/gtest.h>
+
+#include "FrameStats.hpp"
+
+TEST(TestFrameStats, Percentiles)
+{
+    FrameStats stats;
+    for (int i : {4, 1, 3, 2, 5})
+        stats.add(i * 1e-3, 1000000);
+
+    EXPECT_EQ(stats.size(), 5);
+    EXPECT_DOUBLE_EQ(stats.mean(), 3e-3);
+    EXPECT_DOUBLE_EQ(stats.percentile(0), 1e-3);
+    EXPECT_DOUBLE_EQ(stats.percentile(50), 3e-3);
+    EXPECT_DOUBLE_EQ(stats.percentile(100), 5e-3);
+    EXPECT_NEAR(stats.percentile(90), 4.6e-3, 1e-12);
+    EXPECT_NEAR(stats.mraysPerSecond(), 5.0 / 15e-3, 1e-9);
+}
+
+TEST(TestFrameStats, Json)
+{
+    FrameStats stats;
+    stats.add(0.002, 2000);
+    const std::string json = stats.json({{"mesh", "\"teapot.stl\""}, {"width", "64"}});
+    EXPECT_NE(json.find("\"mesh\": \"teapot.stl\""), std::string::npos);
+    EXPECT_NE(json.find("\"width\": 64"), std::string::npos);
+    EXPECT_NE(json.find("\"ms\": 2.0000"), std::string::npos);
+    EXPECT_NE(json.find("\"p99_ms\": 2.0000"), std::string::npos);
+    EXPECT_NE(json.find("\"mrays_per_s\": 1.0000"), std::string::npos);
+
+    EXPECT_NE(FrameStats().json().find("\"frames\": []"), std::string::npos);
+}
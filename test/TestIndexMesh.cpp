@@ -0,0 +1,135 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include <gtest/gtest.h>
+
+#include "bvh.hpp"
+
+#include "IndexMesh.hpp"
+#include "Meshes.hpp"
+
+TEST(TestIndexMesh, WeldGrid)
+{
+    const auto tris = Meshes::grid(10);
+    const BVH::IndexedMesh mesh = MeshIndexer::weld(tris);
+    EXPECT_EQ(mesh.vertices.size(), 11 * 11);
+    ASSERT_EQ(mesh.triangles.size(), tris.size());
+
+    // Orientation and order are preserved
+    for (std::size_t i = 0; i < tris.size(); ++i)
+        for (int j = 0; j < 3; ++j) {
+            const auto& v = mesh.vertices[mesh.triangles[i][j]];
+            EXPECT_EQ(v[0], tris[i].vertices[j].x);
+            EXPECT_EQ(v[1], tris[i].vertices[j].y);
+            EXPECT_EQ(v[2], tris[i].vertices[j].z);
+        }
+}
+
+TEST(TestIndexMesh, DropDegenerateAndDuplicates)
+{
+    std::vector<BVH::Triangle> tris = Meshes::grid(1);
+    tris.push_back({tris[0].vertices[1], tris[0].vertices[2], tris[0].vertices[0]});
+    tris.push_back({tris[1].vertices[2], tris[1].vertices[1], tris[1].vertices[0]});
+    tris.push_back({Vector4(0, 0, 0), Vector4(0, 0, 0), Vector4(1, 0, 0)});
+    tris.push_back({Vector4(0, 0, 0), Vector4(1, 0, 0), Vector4(2, 0, 0)});
+
+    const BVH::IndexedMesh mesh = MeshIndexer::weld(tris);
+    EXPECT_EQ(mesh.triangles.size(), 2);
+    EXPECT_EQ(mesh.vertices.size(), 4);
+}
+
+TEST(TestIndexMesh, Tolerance)
+{
+    std::vector<BVH::Triangle> tris = Meshes::grid(2);
+    tris[1].vertices[1] = tris[1].vertices[1] + Vector4(1e-4f);
+
+    EXPECT_EQ(MeshIndexer::weld(tris).vertices.size(), 10);
+    EXPECT_EQ(MeshIndexer::weld(tris, 1e-2f).vertices.size(), 9);
+}
+
+TEST(TestIndexMesh, Cluster)
+{
+    const std::vector<std::array<float,3>> points = {
+        {0.1f, 0.1f, 0.1f}, {1.2f, 0.1f, 0.1f}, {-0.3f, 0.2f, 0.3f}, {0.8f, -0.2f, 0.4f}, {3.0f, 0.0f, 0.0f}};
+    std::vector<std::uint32_t> clusters;
+    EXPECT_EQ(MeshIndexer::cluster(points, 1.0f, clusters), 3);
+    EXPECT_EQ(clusters, (std::vector<std::uint32_t>{0, 1, 0, 1, 2}));
+    EXPECT_EQ(MeshIndexer::cluster(points, 4.0f, clusters), 2);
+}
+
+TEST(TestIndexMesh, IndexedTree)
+{
+    auto tris = Meshes::grid(16);
+    BVH::IndexedMesh mesh = MeshIndexer::weld(tris);
+    BVH::AABBTree soup_tree(tris, 0.001f);
+    BVH::IndexedAABBTree indexed_tree(mesh, 0.001f);
+
+    for (float x = 0.25f; x < 16.0f; x += 1.5f) {
+        const Vector4 origin(x, x / 2, 5.0f);
+        const Vector4 direction = Vector4(0.01f, 0.02f, -1.0f).normalized3();
+        float t1, t2;
+        Vector4 pt1, pt2, n1, n2;
+        std::uint32_t p1, p2;
+        ASSERT_TRUE(soup_tree.does_intersect_ray(origin, direction, &t1, &pt1, &n1, &p1));
+        ASSERT_TRUE(indexed_tree.does_intersect_ray(origin, direction, &t2, &pt2, &n2, &p2));
+        EXPECT_FLOAT_EQ(t1, t2);
+        EXPECT_FLOAT_EQ(pt1.x, pt2.x);
+        EXPECT_FLOAT_EQ(pt1.y, pt2.y);
+
+        // Both report the same triangle
+        const BVH::Triangle hit = mesh.triangle(mesh.triangles[p2]);
+        for (int v = 0; v < 3; ++v) {
+            EXPECT_FLOAT_EQ(tris[p1].vertices[v].x, hit.vertices[v].x);
+            EXPECT_FLOAT_EQ(tris[p1].vertices[v].y, hit.vertices[v].y);
+        }
+    }
+
+    EXPECT_EQ(MeshIndexer::expand(mesh).size(), tris.size());
+}
+
+TEST(TestIndexMesh, PackNormal)
+{
+    const std::uint32_t packed = MeshIndexer::packNormal(1.0f, -1.0f, 0.0f);
+    EXPECT_EQ(packed & 0x3FF, 511);
+    EXPECT_EQ((packed >> 10) & 0x3FF, 0x3FF - 510);
+    EXPECT_EQ((packed >> 20) & 0x3FF, 0);
+    EXPECT_EQ(packed >> 30, 0);
+}
+
+TEST(TestIndexMesh, Pack)
+{
+    // The flat grid shares all vertices, a fold keeps the sides apart
+    auto tris = Meshes::grid(4);
+    for (bool quantize : {false, true}) {
+        const auto packed = MeshIndexer::pack(tris, quantize);
+        EXPECT_EQ(packed.numVertices(), 5 * 5);
+        ASSERT_EQ(packed.indices.size(), 3 * tris.size());
+        EXPECT_EQ(packed.normals.size(), packed.numVertices());
+        EXPECT_EQ(packed.normals[0], MeshIndexer::packNormal(0.0f, 0.0f, 1.0f));
+        EXPECT_LT(packed.bytes(), tris.size() * 72 / 2);
+
+        for (std::size_t i = 0; i < tris.size(); ++i)
+            for (int j = 0; j < 3; ++j) {
+                const std::size_t id = packed.indices[3*i+j];
+                const Vector4& v = tris[i].vertices[j];
+                for (int a = 0; a < 3; ++a) {
+                    const float stored = quantize ? packed.quantized[4*id+a] : packed.positions[3*id+a];
+                    EXPECT_NEAR(packed.offset[a] + packed.scale[a] * stored, a == 0 ? v.x : a == 1 ? v.y : v.z,
+                                1e-4f);
+                }
+            }
+    }
+
+    std::vector<BVH::Triangle> fold = {{Vector4(0, 0, 0), Vector4(1, 0, 0), Vector4(0, 1, 0)},
+                                       {Vector4(0, 0, 0), Vector4(0, 0, 1), Vector4(1, 0, 0)}};
+    EXPECT_EQ(MeshIndexer::pack(fold, false).numVertices(), 6);
+
+    const auto indexed = MeshIndexer::pack(MeshIndexer::weld(tris), true);
+    EXPECT_EQ(indexed.numVertices(), 5 * 5);
+    EXPECT_TRUE(indexed.normals.empty());
+    EXPECT_EQ(indexed.indices.size(), 3 * tris.size());
+}
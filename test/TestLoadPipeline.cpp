@@ -0,0 +1,134 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include <gtest/gtest.h>
+
+#include "bvh.hpp"
+
+#include "LoadPipeline.hpp"
+#include "Meshes.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+bool hits(const LoadPipeline::Scene& scene, float x, float y)
+{
+    return scene.visit([x, y](const auto& tree)
+    {
+        float t;
+        Vector4 pt, normal;
+        return tree.does_intersect_ray(Vector4(x, y, 1.0f), Vector4(0.0f, 0.0f, -1.0f),
+                                       &t, &pt, &normal);
+    });
+}
+
+}
+
+TEST(TestLoadPipeline, SoupWithCoarseTree)
+{
+    LoadPipeline::Options options;
+    options.coarse_triangles = 100;
+    LoadPipeline pipeline([](const std::atomic<bool>&) { return LoadPipeline::Mesh{Meshes::grid(64), {}, {}}; }, options);
+
+    const auto scene = pipeline.wait();
+    ASSERT_TRUE(scene);
+    EXPECT_FALSE(scene->coarse);
+    EXPECT_EQ(pipeline.stage(), LoadPipeline::Stage::Done);
+    ASSERT_TRUE(scene->tree);
+    EXPECT_FALSE(scene->indexed_tree);
+    EXPECT_EQ(scene->tris.size(), 2 * 64 * 64);
+    EXPECT_TRUE(hits(*scene, 10.3f, 20.6f));
+    EXPECT_FALSE(hits(*scene, -1.0f, 20.6f));
+
+    std::vector<std::string> names;
+    for (const auto& timing : pipeline.timings())
+        names.push_back(timing.name);
+    EXPECT_NE(std::find(names.begin(), names.end(), "load"), names.end());
+    EXPECT_NE(std::find(names.begin(), names.end(), "coarse tree"), names.end());
+    EXPECT_NE(std::find(names.begin(), names.end(), "tree"), names.end());
+}
+
+TEST(TestLoadPipeline, Welded)
+{
+    LoadPipeline::Options options;
+    options.weld_tolerance = 0.0f;
+    options.coarse_triangles = 0;
+    LoadPipeline pipeline([](const std::atomic<bool>&) { return LoadPipeline::Mesh{Meshes::grid(8), {}, {}}; }, options);
+
+    const auto scene = pipeline.wait();
+    ASSERT_TRUE(scene->indexed_tree);
+    EXPECT_EQ(scene->mesh.vertices.size(), 81);
+    EXPECT_EQ(scene->mesh.triangles.size(), 128);
+    EXPECT_TRUE(hits(*scene, 3.3f, 4.6f));
+    EXPECT_EQ(pipeline.timings().size(), 3);
+}
+
+TEST(TestLoadPipeline, LevelsOfDetail)
+{
+    LoadPipeline::Options options;
+    options.coarse_triangles = 0;
+    options.lod_levels = 2;
+    LoadPipeline pipeline([](const std::atomic<bool>&) { return LoadPipeline::Mesh{Meshes::grid(64), {}, {}}; }, options);
+
+    const auto scene = pipeline.wait();
+    ASSERT_TRUE(scene->tree);
+    ASSERT_EQ(scene->lods.size(), 2);
+    ASSERT_EQ(scene->lod_trees.size(), 2);
+    EXPECT_LT(scene->lods[1].mesh.triangles.size(), scene->lods[0].mesh.triangles.size());
+    float t;
+    Vector4 pt, normal;
+    EXPECT_TRUE(scene->lod_trees[1]->does_intersect_ray(Vector4(10.3f, 20.6f, 1.0f), Vector4(0.0f, 0.0f, -1.0f),
+                                                       &t, &pt, &normal));
+    EXPECT_FLOAT_EQ(t, 1.0f);
+}
+
+TEST(TestLoadPipeline, LoaderFails)
+{
+    LoadPipeline pipeline([](const std::atomic<bool>&) -> LoadPipeline::Mesh { throw std::runtime_error("no such file"); });
+    EXPECT_THROW(pipeline.wait(), std::runtime_error);
+    EXPECT_EQ(pipeline.stage(), LoadPipeline::Stage::Failed);
+    EXPECT_FALSE(pipeline.latest());
+}
+
+TEST(TestLoadPipeline, NoTriangles)
+{
+    LoadPipeline empty([](const std::atomic<bool>&) { return LoadPipeline::Mesh{}; });
+    EXPECT_THROW(empty.wait(), std::runtime_error);
+    EXPECT_EQ(empty.stage(), LoadPipeline::Stage::Failed);
+
+    // Welding drops the only triangle, which is degenerate
+    LoadPipeline::Options options;
+    options.weld_tolerance = 0.0f;
+    options.coarse_triangles = 0;
+    LoadPipeline welded([](const std::atomic<bool>&)
+    {
+        const Vector4 p(1.0f, 2.0f, 3.0f);
+        return LoadPipeline::Mesh{{BVH::Triangle{{p, p, p}}}, {}, {}};
+    }, options);
+    EXPECT_THROW(welded.wait(), std::runtime_error);
+    EXPECT_EQ(welded.stage(), LoadPipeline::Stage::Failed);
+    EXPECT_FALSE(welded.latest());
+}
+
+TEST(TestLoadPipeline, Cancel)
+{
+    // The loader only returns once cancelled, then nothing is built
+    LoadPipeline pipeline([](const std::atomic<bool>& cancel)
+    {
+        while (!cancel)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return LoadPipeline::Mesh{Meshes::grid(64), {}, {}};
+    });
+    pipeline.cancel();
+    EXPECT_FALSE(pipeline.wait());
+    EXPECT_EQ(pipeline.stage(), LoadPipeline::Stage::Cancelled);
+}
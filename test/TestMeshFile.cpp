@@ -0,0 +1,107 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include <gtest/gtest.h>
+
+#include "bvh.hpp"
+
+#include "Meshes.hpp"
+#include "MeshFile.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+
+TEST(TestMeshFile, RoundTrip)
+{
+    // Enough triangles for several index blocks
+    const BVH::IndexedMesh mesh = Meshes::indexedSphere(100);
+    for (const int bits : {16, 21}) {
+        const std::string data = MeshFile::encode(mesh, {}, bits);
+        std::vector<std::array<float,3>> normals;
+        const BVH::IndexedMesh decoded = MeshFile::read(data, &normals, false);
+        EXPECT_TRUE(normals.empty());
+        ASSERT_EQ(decoded.vertices.size(), mesh.vertices.size());
+        EXPECT_EQ(decoded.triangles, mesh.triangles);
+
+        const float tolerance = 2.0f / ((1 << bits) - 1);
+        for (std::size_t i = 0; i < mesh.vertices.size(); ++i)
+            for (int c = 0; c < 3; ++c)
+                EXPECT_NEAR(decoded.vertices[i][c], mesh.vertices[i][c], tolerance);
+    }
+}
+
+TEST(TestMeshFile, Triangles)
+{
+    const BVH::IndexedMesh mesh = Meshes::indexedSphere(10);
+    std::vector<std::array<float,3>> normals;
+    for (const auto& tri : mesh.triangles) {
+        const Vector4 n = (mesh.vertex(tri[1]) - mesh.vertex(tri[0]))
+                              .cross3(mesh.vertex(tri[2]) - mesh.vertex(tri[0]));
+        // The poles have degenerate triangles
+        if (n.length3() > 0.0f)
+            normals.push_back({n.x / n.length3(), n.y / n.length3(), n.z / n.length3()});
+        else
+            normals.push_back({0.0f, 0.0f, -1.0f});
+    }
+
+    const auto [tris, decoded_normals] =
+        MeshFile::readTriangles(MeshFile::encode(mesh, normals), false);
+    ASSERT_EQ(tris.size(), mesh.triangles.size());
+    ASSERT_EQ(decoded_normals.size(), normals.size());
+    for (std::size_t i = 0; i < tris.size(); ++i)
+        for (int j = 0; j < 3; ++j) {
+            EXPECT_NEAR(tris[i].vertices[j].x, mesh.vertices[mesh.triangles[i][j]][0], 1e-4);
+            EXPECT_NEAR(decoded_normals[i][j], normals[i][j], 1e-3);
+        }
+}
+
+TEST(TestMeshFile, Corrupt)
+{
+    std::string data = MeshFile::encode(Meshes::indexedSphere(4));
+    EXPECT_THROW(MeshFile::read(data.substr(0, data.size() / 2), nullptr, false),
+                 std::runtime_error);
+    data[0] = 'X';
+    EXPECT_THROW(MeshFile::read(data, nullptr, false), std::runtime_error);
+}
+
+TEST(TestMeshFile, CorruptCounts)
+{
+    // Triangle counts the file cannot hold, which would wrap the block count
+    const std::string data = MeshFile::encode(Meshes::indexedSphere(4));
+    for (const std::uint64_t count : {std::numeric_limits<std::uint64_t>::max(), std::uint64_t(data.size())}) {
+        std::string corrupt = data;
+        std::memcpy(corrupt.data() + 32, &count, sizeof(count)); // after magic, 4 words and the vertex count
+        EXPECT_THROW(MeshFile::read(corrupt, nullptr, false), std::runtime_error);
+    }
+}
+
+TEST(TestMeshFile, LargeDeltas)
+{
+    // Jumps between 32-bit indices span 33 bits of zigzag
+    const std::int64_t max = std::numeric_limits<std::uint32_t>::max();
+    const std::int64_t deltas[] = {0, 1, -1, std::int64_t(1) << 31, -(std::int64_t(1) << 31), max, -max};
+    std::string data;
+    for (const auto delta : deltas)
+        MeshFile::putDelta(data, delta);
+    const char* pos = data.data();
+    const char* end = data.data() + data.size();
+    for (const auto delta : deltas)
+        EXPECT_EQ(MeshFile::getDelta(pos, end), delta);
+    EXPECT_EQ(pos, end);
+
+    // A varint cut short
+    data.pop_back();
+    pos = data.data();
+    end = data.data() + data.size();
+    for (std::size_t i = 0; i + 1 < std::size(deltas); ++i)
+        MeshFile::getDelta(pos, end);
+    EXPECT_THROW(MeshFile::getDelta(pos, end), std::runtime_error);
+}
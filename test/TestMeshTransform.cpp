@@ -0,0 +1,117 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include <gtest/gtest.h>
+
+#include "bvh.hpp"
+
+#include "MappedFile.hpp"
+#include "MeshTransform.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+using MeshTransform::Affine;
+
+namespace {
+
+std::vector<BVH::Triangle> boxTris()
+{
+    return {{Vector4(1, 2, 3), Vector4(5, 2, 3), Vector4(1, 6, 3)},
+            {Vector4(1, 2, 9), Vector4(5, 6, 9), Vector4(1, 6, 9)}};
+}
+
+}
+
+TEST(TestMeshTransform, Compose)
+{
+    const Affine a = Affine::scaling(2, 2, 2).then(Affine::translation(1, 0, 0))
+                                             .then(Affine::swap(1, 2));
+    const auto p = a.point({1, 2, 3});
+    EXPECT_FLOAT_EQ(p[0], 3);
+    EXPECT_FLOAT_EQ(p[1], 6);
+    EXPECT_FLOAT_EQ(p[2], 4);
+    EXPECT_FLOAT_EQ(a.determinant(), -8);
+
+    const auto n = a.normal({0, 1, 0});
+    EXPECT_FLOAT_EQ(n[0], 0);
+    EXPECT_FLOAT_EQ(n[1], 0);
+    EXPECT_FLOAT_EQ(n[2], 1);
+}
+
+TEST(TestMeshTransform, Normalize)
+{
+    auto tris = boxTris();
+    const auto stats = MeshTransform::measure(tris);
+    EXPECT_EQ(stats.num_vertices, 6);
+    EXPECT_DOUBLE_EQ(stats.mean[0], 14.0 / 6);
+    EXPECT_DOUBLE_EQ(stats.mean[2], 6.0);
+    EXPECT_FLOAT_EQ(stats.lower[1], 2);
+    EXPECT_FLOAT_EQ(stats.upper[2], 9);
+    EXPECT_FLOAT_EQ(stats.radius(), 3);
+
+    MeshTransform::apply(tris, MeshTransform::normalize(stats));
+    const auto result = MeshTransform::measure(tris);
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_NEAR(result.mean[i], 0.0, 1e-6);
+        EXPECT_LE(result.upper[i], 1.0f + 1e-6f);
+        EXPECT_GE(result.lower[i], -1.0f - 1e-6f);
+    }
+    EXPECT_FLOAT_EQ(result.upper[2], 1.0f);
+}
+
+TEST(TestMeshTransform, MirrorKeepsWinding)
+{
+    auto tris = boxTris();
+    const Vector4 before = (tris[0].vertices[1] - tris[0].vertices[0])
+                               .cross3(tris[0].vertices[2] - tris[0].vertices[0]);
+    MeshTransform::apply(tris, Affine::swap(1, 2));
+    const Vector4 after = (tris[0].vertices[1] - tris[0].vertices[0])
+                              .cross3(tris[0].vertices[2] - tris[0].vertices[0]);
+    // The +z facing triangle now faces +y
+    EXPECT_GT(before.z, 0);
+    EXPECT_GT(after.y, 0);
+}
+
+TEST(TestMeshTransform, BinarySTLInPlace)
+{
+    const auto path = std::filesystem::temp_directory_path() / "waldo-test-transform.stl";
+    {
+        std::ofstream file(path, std::ios::binary);
+        const char header[80] = {};
+        file.write(header, sizeof(header));
+        const std::uint32_t count = 2;
+        file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        for (const auto& tri : boxTris()) {
+            float v[12] = {0, 0, 1};
+            for (int i = 0; i < 3; ++i)
+                for (int j = 0; j < 3; ++j)
+                    v[3 + 3*i + j] = tri.vertices[i].arr[j];
+            file.write(reinterpret_cast<const char*>(v), sizeof(v));
+            file.write(header, 2);
+        }
+    }
+
+    {
+        MappedFile file = MappedFile::writable(path.string());
+        char* records = file.data() + 84;
+        const auto stats = MeshTransform::measure(records, 2);
+        EXPECT_FLOAT_EQ(stats.radius(), 3);
+        MeshTransform::apply(records, 2, MeshTransform::normalize(stats).then(Affine::swap(1, 2)));
+        file.sync();
+    }
+
+    MappedFile file(path.string());
+    const char* record = file.view().data() + 84;
+    float v[12];
+    std::memcpy(v, record, sizeof(v));
+    EXPECT_FLOAT_EQ(v[1], 1.0f); // Normal follows the swap
+    EXPECT_FLOAT_EQ(v[4], -1.0f); // z = 3 maps to -1, now in y
+    EXPECT_FLOAT_EQ(MeshTransform::measure(record, 2).upper[1], 1.0f);
+    std::filesystem::remove(path);
+}
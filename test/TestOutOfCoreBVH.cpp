@@ -0,0 +1,234 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include <gtest/gtest.h>
+
+#include "bvh.hpp"
+
+#include "Meshes.hpp"
+#include "OutOfCoreBVH.hpp"
+
+#include <fmt/format.h>
+
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+//! \brief Height field over an n x n grid.
+std::vector<BVH::Triangle> terrain(int n)
+{
+    return Meshes::heightField(n, [](int i, int j) { return std::sin(0.3f * i) * std::cos(0.2f * j); });
+}
+
+void writeBinarySTL(const std::filesystem::path& path, const std::vector<BVH::Triangle>& tris)
+{
+    std::ofstream file(path, std::ios::binary);
+    const char header[80] = {};
+    file.write(header, sizeof(header));
+    const std::uint32_t count = tris.size();
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    for (const auto& tri : tris) {
+        float v[12] = {};
+        for (int i = 0; i < 3; ++i)
+            for (int j = 0; j < 3; ++j)
+                v[3 + 3*i + j] = tri.vertices[i].arr[j];
+        file.write(reinterpret_cast<const char*>(v), sizeof(v));
+        file.write(header, 2);
+    }
+}
+
+void compare(const std::vector<BVH::Triangle>& tris, const OutOfCoreBVH::PagedTree& paged, int n)
+{
+    auto copy = tris;
+    BVH::AABBTree tree(copy, 0.001f);
+    BVH::TraversalStats stats;
+    for (float x = 0.3f; x < n; x += 0.7f)
+        for (float y = 0.2f; y < n; y += 1.9f) {
+            const Vector4 origin(x, y, 5.0f);
+            const Vector4 direction = Vector4(0.05f, -0.03f, -1.0f).normalized3();
+            float t1, t2;
+            Vector4 pt1, pt2, n1, n2;
+            const bool hit1 = tree.does_intersect_ray(origin, direction, &t1, &pt1, &n1);
+            std::uint32_t primitive = 0;
+            const bool hit2 = paged.does_intersect_ray(origin, direction, &t2, &pt2, &n2, &primitive);
+            ASSERT_EQ(hit1, hit2);
+            float t3;
+            Vector4 pt3, n3;
+            EXPECT_EQ(paged.does_intersect_ray(origin, direction, &t3, &pt3, &n3, nullptr, stats), hit2);
+            EXPECT_EQ(t3, t2);
+            if (hit1) {
+                EXPECT_FLOAT_EQ(t1, t2);
+                EXPECT_FLOAT_EQ(pt1.z, pt2.z);
+                EXPECT_LT(primitive, paged.num_triangles());
+                const BVH::Triangle hit = paged.triangle(primitive);
+                const Vector4 centroid = hit.calc_centroid();
+                EXPECT_NEAR(centroid.x, pt2.x, 1.0f);
+                EXPECT_NEAR(centroid.y, pt2.y, 1.0f);
+                // Occluded exactly when the closest hit is nearer than the ray length
+                EXPECT_TRUE(paged.is_occluded(origin, direction, t1 + 0.01f));
+                EXPECT_FALSE(paged.is_occluded(origin, direction, t1 - 0.01f));
+                EXPECT_TRUE(tree.is_occluded(origin, direction, t1 + 0.01f));
+                EXPECT_FALSE(tree.is_occluded(origin, direction, t1 - 0.01f));
+            } else {
+                EXPECT_FALSE(paged.is_occluded(origin, direction, 100.0f));
+            }
+        }
+    EXPECT_GT(stats.queries, 0);
+    EXPECT_GE(stats.boxes, stats.nodes);
+    EXPECT_GE(stats.triangles, stats.hits);
+}
+
+}
+
+TEST(TestOutOfCoreBVH, BinarySTLSmallBudget)
+{
+    constexpr int n = 100;
+    const auto tris = terrain(n);
+    const auto dir = std::filesystem::temp_directory_path();
+    const auto input = dir / "waldo-test-ooc.stl";
+    const auto output = dir / "waldo-test-ooc.wbvh";
+    writeBinarySTL(input, tris);
+
+    OutOfCoreBVH::BuildOptions options;
+    options.memory_budget = 1 << 16; // A few hundred triangles per subtree
+    OutOfCoreBVH::build(input.string(), output.string(), options);
+
+    const OutOfCoreBVH::PagedTree paged(output.string());
+    EXPECT_EQ(paged.num_triangles(), tris.size());
+    compare(tris, paged, n);
+
+    std::filesystem::remove(input);
+    std::filesystem::remove(output);
+}
+
+TEST(TestOutOfCoreBVH, TriFileScaled)
+{
+    constexpr int n = 20;
+    const auto tris = terrain(n);
+    const auto dir = std::filesystem::temp_directory_path();
+    const auto input = dir / "waldo-test-ooc.tri";
+    const auto output = dir / "waldo-test-ooc-tri.wbvh";
+    {
+        std::ofstream file(input);
+        for (const auto& tri : tris)
+            file << fmt::format("{} {} {} {} {} {} {} {} {}\n",
+                                tri.vertices[0].x / 2, tri.vertices[0].y / 2, tri.vertices[0].z / 2,
+                                tri.vertices[1].x / 2, tri.vertices[1].y / 2, tri.vertices[1].z / 2,
+                                tri.vertices[2].x / 2, tri.vertices[2].y / 2, tri.vertices[2].z / 2);
+    }
+
+    OutOfCoreBVH::BuildOptions options;
+    options.memory_budget = 1 << 14;
+    options.scale = 2.0f;
+    OutOfCoreBVH::build(input.string(), output.string(), options);
+
+    const OutOfCoreBVH::PagedTree paged(output.string());
+    EXPECT_EQ(paged.num_triangles(), tris.size());
+    compare(tris, paged, n);
+
+    std::filesystem::remove(input);
+    std::filesystem::remove(output);
+}
+
+TEST(TestOutOfCoreBVH, NotATreeFile)
+{
+    const auto path = std::filesystem::temp_directory_path() / "waldo-test-ooc-bad.wbvh";
+    {
+        std::ofstream file(path, std::ios::binary);
+        const std::string junk(128, 'x');
+        file << junk;
+    }
+    EXPECT_THROW(OutOfCoreBVH::PagedTree{path.string()}, std::runtime_error);
+    std::filesystem::remove(path);
+}
+
+TEST(TestOutOfCoreBVH, TooManyTriangles)
+{
+    const auto dir = std::filesystem::temp_directory_path();
+    const auto input = dir / "waldo-test-ooc-count.stl";
+    const auto output = dir / "waldo-test-ooc-count.wbvh";
+    writeBinarySTL(input, terrain(10));
+    OutOfCoreBVH::build(input.string(), output.string());
+
+    // Hits report 32-bit primitive indices, so larger trees are rejected
+    // rather than wrapping. The count follows magic, version and reserved.
+    {
+        std::fstream file(output, std::ios::binary | std::ios::in | std::ios::out);
+        const std::uint64_t count = (std::uint64_t(1) << 32) + 1;
+        file.seekp(16);
+        file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    }
+    EXPECT_THROW(OutOfCoreBVH::PagedTree{output.string()}, std::runtime_error);
+
+    std::filesystem::remove(input);
+    std::filesystem::remove(output);
+}
+
+TEST(TestOutOfCoreBVH, CorruptTree)
+{
+    const auto dir = std::filesystem::temp_directory_path();
+    const auto input = dir / "waldo-test-ooc-corrupt.stl";
+    const auto output = dir / "waldo-test-ooc-corrupt.wbvh";
+    writeBinarySTL(input, terrain(10));
+    OutOfCoreBVH::build(input.string(), output.string());
+
+    // Offsets of the subtree table and the top nodes, after magic, version,
+    // reserved, the triangle count and the subtree count
+    std::uint64_t subtree_offset = 0, top_offset = 0;
+    {
+        std::ifstream file(output, std::ios::binary);
+        file.seekg(32);
+        file.read(reinterpret_cast<char*>(&subtree_offset), sizeof(subtree_offset));
+        file.seekg(48);
+        file.read(reinterpret_cast<char*>(&top_offset), sizeof(top_offset));
+    }
+    OutOfCoreBVH::Subtree subtree;
+    {
+        std::ifstream file(output, std::ios::binary);
+        file.seekg(subtree_offset);
+        file.read(reinterpret_cast<char*>(&subtree), sizeof(subtree));
+    }
+
+    const auto patch = [&](std::uint64_t node, std::uint32_t offset, std::uint32_t count)
+    {
+        std::fstream file(output, std::ios::binary | std::ios::in | std::ios::out);
+        OutOfCoreBVH::FlatNode flat;
+        file.seekg(node);
+        file.read(reinterpret_cast<char*>(&flat), sizeof(flat));
+        const OutOfCoreBVH::FlatNode original = flat;
+        flat.offset = offset;
+        flat.count = count;
+        file.seekp(node);
+        file.write(reinterpret_cast<const char*>(&flat), sizeof(flat));
+        return original;
+    };
+    const auto restore = [&](std::uint64_t node, const OutOfCoreBVH::FlatNode& flat)
+    {
+        patch(node, flat.offset, flat.count);
+    };
+
+    // A top node pointing back at itself would recurse forever
+    auto original = patch(top_offset, 0, 0);
+    EXPECT_THROW(OutOfCoreBVH::PagedTree{output.string()}, std::runtime_error);
+    // A top leaf beyond the subtrees
+    patch(top_offset, 1000, 1);
+    EXPECT_THROW(OutOfCoreBVH::PagedTree{output.string()}, std::runtime_error);
+    restore(top_offset, original);
+
+    // A subtree leaf beyond its triangles
+    original = patch(subtree.node_offset, subtree.num_triangles - 1, 2);
+    EXPECT_THROW(OutOfCoreBVH::PagedTree{output.string()}, std::runtime_error);
+    restore(subtree.node_offset, original);
+    EXPECT_NO_THROW(OutOfCoreBVH::PagedTree{output.string()});
+
+    std::filesystem::remove(input);
+    std::filesystem::remove(output);
+}
@@ -0,0 +1,61 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include <gtest/gtest.h>
+
+#include "bvh.hpp"
+
+#include "Picking.hpp"
+
+#include <array>
+
+TEST(TestPicking, Unproject)
+{
+    // Inverse of an orthographic projection of [0, 10] x [0, 10] x [-20, -2]
+    std::array<float,16> inverse{};
+    inverse[0] = 5;
+    inverse[5] = 5;
+    inverse[10] = -9;
+    inverse[12] = 5;
+    inverse[13] = 5;
+    inverse[14] = -11;
+    inverse[15] = 1;
+
+    const Picking::Ray ray = Picking::unproject(inverse.data(), 0.5f, -0.5f);
+    EXPECT_FLOAT_EQ(ray.origin.x, 7.5f);
+    EXPECT_FLOAT_EQ(ray.origin.y, 2.5f);
+    EXPECT_FLOAT_EQ(ray.origin.z, -2.0f);
+    EXPECT_FLOAT_EQ(ray.direction.x, 0.0f);
+    EXPECT_FLOAT_EQ(ray.direction.y, 0.0f);
+    EXPECT_FLOAT_EQ(ray.direction.z, -1.0f);
+
+    float x, y;
+    Picking::windowToDevice(0, 0, 100, 50, &x, &y);
+    EXPECT_FLOAT_EQ(x, -0.99f);
+    EXPECT_FLOAT_EQ(y, 0.98f);
+}
+
+TEST(TestPicking, Pick)
+{
+    std::vector<BVH::Triangle> tris;
+    for (int i = 0; i < 100; ++i)
+        for (int j = 0; j < 100; ++j)
+            tris.push_back({Vector4(i, j, -5.0f), Vector4(i + 1, j, -5.0f), Vector4(i, j + 1, -5.0f)});
+    BVH::AABBTree tree(tris, 0.001f);
+
+    const auto hit = Picking::pick(tree, {Vector4(12.2f, 40.3f, 0.0f), Vector4(0.0f, 0.0f, -1.0f)});
+    ASSERT_TRUE(hit);
+    EXPECT_FLOAT_EQ(hit->t, 5.0f);
+    EXPECT_FLOAT_EQ(hit->point.x, 12.2f);
+    EXPECT_FLOAT_EQ(hit->point.y, 40.3f);
+    // The primitive indexes the triangles in the order of the tree
+    const BVH::Triangle& tri = tree.triangle(hit->primitive);
+    EXPECT_EQ(tri.vertices[0].x, 12.0f);
+    EXPECT_EQ(tri.vertices[0].y, 40.0f);
+
+    EXPECT_FALSE(Picking::pick(tree, {Vector4(12.8f, 40.8f, 0.0f), Vector4(0.0f, 0.0f, -1.0f)}));
+}
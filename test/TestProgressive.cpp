@@ -0,0 +1,51 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include <gtest/gtest.h>
+
+#include "Progressive.hpp"
+
+TEST(TestProgressive, Fresh)
+{
+    EXPECT_EQ(Progressive::firstPass(false), 0);
+    EXPECT_EQ(Progressive::plan(0, false).divisor, Progressive::PREVIEW_DIVISOR);
+    EXPECT_EQ(Progressive::plan(1, false).divisor, Progressive::PREVIEW_DIVISOR / 2);
+    for (int pass = 0; pass < 2; ++pass) {
+        EXPECT_TRUE(Progressive::plan(pass, false).preview());
+        EXPECT_FALSE(Progressive::plan(pass, false).reproject);
+    }
+    for (int pass = 2; pass < Progressive::PASSES; ++pass) {
+        const auto plan = Progressive::plan(pass, false);
+        EXPECT_EQ(plan.divisor, 1);
+        EXPECT_EQ(plan.sample, pass - 2);
+        EXPECT_GE(plan.jitter_x, 0.0f);
+        EXPECT_LT(plan.jitter_x, 1.0f);
+    }
+    EXPECT_EQ(Progressive::plan(2, false).jitter_x, 0.0f);
+    EXPECT_NE(Progressive::plan(3, false).jitter_x, 0.0f);
+}
+
+TEST(TestProgressive, Reprojected)
+{
+    // The reprojected pass is a full resolution preview
+    const int first = Progressive::firstPass(true);
+    const auto preview = Progressive::plan(first, true);
+    EXPECT_EQ(preview.divisor, 1);
+    EXPECT_TRUE(preview.reproject);
+    EXPECT_TRUE(preview.preview());
+
+    // and the samples are those of a fresh trace
+    for (int pass = first + 1; pass < Progressive::PASSES; ++pass) {
+        const auto plan = Progressive::plan(pass, true), fresh = Progressive::plan(pass, false);
+        EXPECT_FALSE(plan.reproject);
+        EXPECT_EQ(plan.divisor, fresh.divisor);
+        EXPECT_EQ(plan.sample, fresh.sample);
+        EXPECT_EQ(plan.jitter_x, fresh.jitter_x);
+        EXPECT_EQ(plan.jitter_y, fresh.jitter_y);
+    }
+    EXPECT_EQ(Progressive::plan(first + 1, true).sample, 0);
+}
@@ -0,0 +1,64 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include <gtest/gtest.h>
+
+#include "bvh.hpp"
+
+#include "ReadOBJ.hpp"
+
+#include <fmt/format.h>
+
+#include <stdexcept>
+
+TEST(TestReadOBJ, Faces)
+{
+    const std::string_view square = R"(# square
+o square
+v 0.0 0.0 0.0
+v 1.0 0.0 0.0
+v 1.0 1.0 0.0
+v 0.0 1.0 0.0
+vn 0.0 0.0 1.0
+vt 0.0 0.0
+f 1//1 2//1 3//1 4//1
+v 0.0 0.0 1.0
+f -1 1/1 -3/1/1
+)";
+
+    const BVH::IndexedMesh mesh = OBJReader::read(square, false);
+    ASSERT_EQ(mesh.vertices.size(), 5);
+    ASSERT_EQ(mesh.triangles.size(), 3);
+    EXPECT_EQ(mesh.vertices[2][1], 1.0f);
+    EXPECT_EQ(mesh.vertices[4][2], 1.0f);
+    EXPECT_EQ(mesh.triangles[0], (BVH::IndexedTriangle{0, 1, 2}));
+    EXPECT_EQ(mesh.triangles[1], (BVH::IndexedTriangle{0, 2, 3}));
+    EXPECT_EQ(mesh.triangles[2], (BVH::IndexedTriangle{4, 0, 2}));
+}
+
+TEST(TestReadOBJ, ManyFacesParallel)
+{
+    constexpr int num_quads = 40000;
+    std::string buffer;
+    for (int i = 0; i < num_quads; ++i)
+        buffer += fmt::format("v {} 0 0\nv {} 1 0\nv {} 1 1\nv {} 0 1\nf -4 -3 -2 -1\n",
+                              i, i, i, i);
+
+    const BVH::IndexedMesh mesh = OBJReader::read(buffer, false);
+    ASSERT_EQ(mesh.vertices.size(), 4 * num_quads);
+    ASSERT_EQ(mesh.triangles.size(), 2 * num_quads);
+    for (std::uint32_t i = 0; i < num_quads; ++i) {
+        EXPECT_EQ(mesh.vertices[4*i][0], float(i));
+        EXPECT_EQ(mesh.triangles[2*i+1], (BVH::IndexedTriangle{4*i, 4*i+2, 4*i+3}));
+    }
+}
+
+TEST(TestReadOBJ, Errors)
+{
+    EXPECT_THROW(OBJReader::read("v 0 0 0\nf 1 2 3\n", false), std::runtime_error);
+    EXPECT_THROW(OBJReader::read("v 0 0 zero\n", false), std::runtime_error);
+}
@@ -0,0 +1,113 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include <gtest/gtest.h>
+
+#include "bvh.hpp"
+
+#include "ReadPLY.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+template<class T>
+void append(std::string& buffer, T value)
+{
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    buffer.append(bytes, sizeof(T));
+}
+
+const float square[4][3] = {{0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0}};
+
+}
+
+TEST(TestReadPLY, Triangles)
+{
+    std::string buffer = "ply\n"
+                         "format binary_little_endian 1.0\n"
+                         "comment two triangles\n"
+                         "element vertex 4\n"
+                         "property float x\n"
+                         "property float y\n"
+                         "property float z\n"
+                         "property uchar red\n"
+                         "element face 2\n"
+                         "property list uchar int vertex_indices\n"
+                         "end_header\n";
+    for (const auto& v : square) {
+        for (float c : v)
+            append(buffer, c);
+        append<std::uint8_t>(buffer, 255);
+    }
+    append<std::uint8_t>(buffer, 3);
+    for (const std::int32_t i : {0, 1, 2})
+        append(buffer, i);
+    append<std::uint8_t>(buffer, 3);
+    for (const std::int32_t i : {0, 2, 3})
+        append(buffer, i);
+
+    const BVH::IndexedMesh mesh = PLYReader::read(buffer, false);
+    ASSERT_EQ(mesh.vertices.size(), 4);
+    ASSERT_EQ(mesh.triangles.size(), 2);
+    EXPECT_EQ(mesh.vertices[2][0], 1.0f);
+    EXPECT_EQ(mesh.vertices[2][1], 1.0f);
+    EXPECT_EQ(mesh.triangles[1], (BVH::IndexedTriangle{0, 2, 3}));
+}
+
+TEST(TestReadPLY, Polygons)
+{
+    std::string buffer = "ply\n"
+                         "format binary_little_endian 1.0\n"
+                         "element vertex 4\n"
+                         "property double x\n"
+                         "property double y\n"
+                         "property double z\n"
+                         "element face 1\n"
+                         "property list uchar uint vertex_index\n"
+                         "property uchar flags\n"
+                         "element edge 1\n"
+                         "property int vertex1\n"
+                         "property int vertex2\n"
+                         "end_header\n";
+    for (const auto& v : square)
+        for (float c : v)
+            append<double>(buffer, c);
+    append<std::uint8_t>(buffer, 4);
+    for (const std::uint32_t i : {0, 1, 2, 3})
+        append(buffer, i);
+    append<std::uint8_t>(buffer, 0);
+    append<std::int32_t>(buffer, 0);
+    append<std::int32_t>(buffer, 1);
+
+    const BVH::IndexedMesh mesh = PLYReader::read(buffer, false);
+    ASSERT_EQ(mesh.vertices.size(), 4);
+    ASSERT_EQ(mesh.triangles.size(), 2);
+    EXPECT_EQ(mesh.vertices[3][1], 1.0f);
+    EXPECT_EQ(mesh.triangles[0], (BVH::IndexedTriangle{0, 1, 2}));
+    EXPECT_EQ(mesh.triangles[1], (BVH::IndexedTriangle{0, 2, 3}));
+}
+
+TEST(TestReadPLY, Errors)
+{
+    EXPECT_THROW(PLYReader::read("ply\nformat ascii 1.0\nend_header\n", false),
+                 std::runtime_error);
+
+    std::string truncated = "ply\n"
+                            "format binary_little_endian 1.0\n"
+                            "element vertex 4\n"
+                            "property float x\n"
+                            "property float y\n"
+                            "property float z\n"
+                            "end_header\n";
+    append(truncated, 1.0f);
+    EXPECT_THROW(PLYReader::read(truncated, false), std::runtime_error);
+}
@@ -9,6 +9,11 @@
 
 #include "bvh.hpp"
 
+#include <fmt/format.h>
+
+#include <filesystem>
+#include <fstream>
+
 #include "ReadSTL.hpp"
 
 namespace {
@@ -60,3 +65,55 @@ TEST(TestReadSTL, TwoTriangles)
         std::cerr << "Caught exception " << e.what() << std::endl;
     }
 }
+
+TEST(TestReadSTL, ManyTrianglesParallel)
+{
+    // Large enough to be split into several chunks
+    constexpr int num_facets = 20000;
+    std::string buffer = "solid many\n";
+    for (int i = 0; i < num_facets; ++i)
+        buffer += fmt::format("facet normal 0 0 1\n"
+                              "  outer loop\n"
+                              "    vertex {} 0 0\n"
+                              "    vertex 0 {}.5 0\n"
+                              "    vertex 0 0 -{}e-1\n"
+                              "  endloop\n"
+                              "endfacet\n", i, i, i);
+    buffer += "endsolid many\n";
+
+    const auto [tris, normals] = STLReader::read(buffer, false);
+    ASSERT_EQ(tris.size(), num_facets);
+    ASSERT_EQ(normals.size(), num_facets);
+    for (int i = 0; i < num_facets; ++i) {
+        EXPECT_EQ(tris[i].vertices[0].x, float(i));
+        EXPECT_EQ(tris[i].vertices[1].y, i + 0.5f);
+        EXPECT_FLOAT_EQ(tris[i].vertices[2].z, -i / 10.0f);
+        EXPECT_EQ(normals[i][2], 1.0f);
+    }
+}
+
+TEST(TestReadSTL, ReadFile)
+{
+    const auto path = std::filesystem::temp_directory_path() / "waldo_two_triangles.stl";
+    std::ofstream(path) << two_triangles;
+
+    const auto [tris, normals] = STLReader::readASCII(path.string());
+    std::filesystem::remove(path);
+    ASSERT_EQ(tris.size(), 2);
+    EXPECT_EQ(tris[1].vertices[0].x, 0.5);
+    EXPECT_EQ(tris[1].vertices[2].y, 0.5);
+}
+
+TEST(TestReadSTL, Malformed)
+{
+    const std::string_view broken = R"(
+solid broken
+    facet normal 0.0 0.0 1.0
+        outer loop
+            vertex 0.0 0.5 zero
+        endloop
+    endfacet
+endsolid broken)";
+
+    EXPECT_THROW(STLReader::read(broken, false), std::runtime_error);
+}
@@ -0,0 +1,54 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include <gtest/gtest.h>
+
+#include "bvh.hpp"
+
+#include "ReadTri.hpp"
+
+#include <fmt/format.h>
+
+#include <stdexcept>
+
+TEST(TestReadTri, TwoTriangles)
+{
+    const std::string_view two_triangles =
+        "0.0 0.5 0.0 0.5 0.0 0.0 0.0 0.0 0.0\n"
+        "\n"
+        "0.5 0.5 0.0\t0.5 0.0 0.0 0.0 0.5 1e-1\r\n";
+
+    const auto tris = TriReader::read(two_triangles, false);
+    ASSERT_EQ(tris.size(), 2);
+    EXPECT_EQ(tris[0].vertices[0].y, 0.5);
+    EXPECT_EQ(tris[0].vertices[1].x, 0.5);
+    EXPECT_EQ(tris[1].vertices[0].x, 0.5);
+    EXPECT_EQ(tris[1].vertices[2].y, 0.5);
+    EXPECT_FLOAT_EQ(tris[1].vertices[2].z, 0.1);
+    EXPECT_EQ(tris[1].vertices[2].w, 0.0);
+}
+
+TEST(TestReadTri, ManyTrianglesParallel)
+{
+    constexpr int num_tris = 50000;
+    std::string buffer;
+    for (int i = 0; i < num_tris; ++i)
+        buffer += fmt::format("{} 0 0 0 {} 0 0 0 -{}\n", i, i, i);
+
+    const auto tris = TriReader::read(buffer, false);
+    ASSERT_EQ(tris.size(), num_tris);
+    for (int i = 0; i < num_tris; ++i) {
+        EXPECT_EQ(tris[i].vertices[0].x, float(i));
+        EXPECT_EQ(tris[i].vertices[1].y, float(i));
+        EXPECT_EQ(tris[i].vertices[2].z, -float(i));
+    }
+}
+
+TEST(TestReadTri, Malformed)
+{
+    EXPECT_THROW(TriReader::read("0 0 0 1 0 0 0 1\n", false), std::runtime_error);
+}
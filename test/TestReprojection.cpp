@@ -0,0 +1,172 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include <gtest/gtest.h>
+
+#include "Meshes.hpp"
+#include "Progressive.hpp"
+#include "Reprojection.hpp"
+
+#include "bvh.hpp"
+
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// Wavy ground over an n x n grid
+std::vector<BVH::Triangle> ground(int n)
+{
+    return Meshes::heightField(n, [](int i, int j) { return 0.5f * std::sin(0.7f * i) * std::cos(0.4f * j); });
+}
+
+// Looking down at the ground from eye towards the center of the grid
+Reprojection::View view(Vector4 eye, int size)
+{
+    Reprojection::View view;
+    view.eye = eye;
+    view.forward = (Vector4(16.0f, 16.0f, 0.0f) - eye).normalized3();
+    view.right = view.forward.cross3(Vector4(0.0f, 0.0f, 1.0f)).normalized3();
+    view.up = view.right.cross3(view.forward);
+    view.tan_half_fov = 0.5f;
+    view.width = view.height = size;
+    return view;
+}
+
+void trace(const BVH::AABBTree& tree, const Reprojection::View& view, Shading::GBuffer& gbuffer)
+{
+    gbuffer.resize(std::size_t(view.width) * view.height);
+    for (int y = 0; y < view.height; ++y)
+        for (int x = 0; x < view.width; ++x) {
+            const std::size_t i = x + std::size_t(y) * view.width;
+            float t;
+            Vector4 pt, normal;
+            if (!tree.does_intersect_ray(view.eye, view.direction(x, y).normalized3(), &t, &pt, &normal,
+                                         &gbuffer.primitive[i]))
+                t = std::numeric_limits<float>::infinity();
+            gbuffer.t[i] = t;
+        }
+}
+
+}
+
+TEST(TestReprojection, Project)
+{
+    auto v = view(Vector4(10.0f, 2.0f, 8.0f), 64);
+    v.jitter_x = 0.25f;
+    v.jitter_y = 0.75f;
+    for (int y = 0; y < 64; y += 7)
+        for (int x = 0; x < 64; x += 5) {
+            int px, py;
+            ASSERT_TRUE(v.project(v.eye + v.direction(x, y) * 3.0f, &px, &py));
+            EXPECT_EQ(px, x);
+            EXPECT_EQ(py, y);
+        }
+    int px, py;
+    EXPECT_FALSE(v.project(v.eye - v.forward, &px, &py));
+}
+
+TEST(TestReprojection, SmallMotion)
+{
+    auto tris = ground(32);
+    BVH::AABBTree tree(tris, 0.001f);
+    const auto fetch = [&](std::uint32_t primitive) { return tree.triangle(primitive); };
+
+    Reprojection::Cache cache;
+    Shading::GBuffer gbuffer;
+    std::vector<std::uint8_t> needs_trace;
+    EXPECT_EQ(cache.reproject(view(Vector4(10.0f, 2.0f, 8.0f), 64), gbuffer, needs_trace, fetch), 64 * 64);
+
+    const auto before = view(Vector4(10.0f, 2.0f, 8.0f), 64);
+    trace(tree, before, gbuffer);
+    cache.store(before, gbuffer);
+
+    const auto after = view(Vector4(10.3f, 2.2f, 7.9f), 64);
+    Shading::GBuffer reprojected, reference;
+    const std::size_t num_trace = cache.reproject(after, reprojected, needs_trace, fetch);
+    trace(tree, after, reference);
+
+    // Most pixels on the ground are reused, and those match a full trace
+    std::size_t num_hits = 0;
+    for (float t : reference.t)
+        num_hits += t < std::numeric_limits<float>::max();
+    EXPECT_LT(num_trace, 64 * 64 - num_hits + num_hits / 10);
+    for (std::size_t i = 0; i < reference.size(); ++i) {
+        if (needs_trace[i])
+            continue;
+        EXPECT_NEAR(reprojected.t[i], reference.t[i], 1e-3f * reference.t[i]);
+        EXPECT_EQ(reprojected.primitive[i], reference.primitive[i]);
+    }
+
+    cache.clear();
+    EXPECT_TRUE(cache.empty());
+}
+
+TEST(TestReprojection, RefineAfterMove)
+{
+    // A board floating above the ground covers ground hit before the move,
+    // which reprojection keeps since it only tests the cached triangle
+    auto tris = ground(32);
+    const Vector4 a(12.0f, 10.0f, 2.5f), b(20.0f, 10.0f, 2.5f), c(12.0f, 14.0f, 2.5f), d(20.0f, 14.0f, 2.5f);
+    tris.push_back({a, b, d});
+    tris.push_back({a, d, c});
+    BVH::AABBTree tree(tris, 0.001f);
+    const auto fetch = [&](std::uint32_t primitive) { return tree.triangle(primitive); };
+    const Vector4 before(10.0f, 2.0f, 8.0f), after(13.0f, 1.0f, 7.0f);
+
+    // Accumulated depth of the passes after a move, as in raytrace
+    const auto refine = [&](Reprojection::Cache* cache, Shading::GBuffer& preview)
+    {
+        const bool cached = cache && !cache->empty();
+        std::vector<float> sum(64 * 64), image(64 * 64);
+        for (int pass = Progressive::firstPass(cached); pass < Progressive::PASSES; ++pass) {
+            const auto plan = Progressive::plan(pass, cached);
+            if (plan.divisor > 1)
+                continue;
+            auto v = view(after, 64);
+            v.jitter_x = plan.jitter_x;
+            v.jitter_y = plan.jitter_y;
+            Shading::GBuffer gbuffer;
+            if (plan.reproject) {
+                std::vector<std::uint8_t> needs_trace;
+                cache->reproject(v, preview, needs_trace, fetch);
+                Shading::GBuffer traced;
+                trace(tree, v, traced);
+                for (std::size_t i = 0; i < preview.size(); ++i)
+                    if (needs_trace[i]) {
+                        preview.t[i] = traced.t[i];
+                        preview.primitive[i] = traced.primitive[i];
+                    }
+            }
+            if (plan.preview())
+                continue;
+            trace(tree, v, gbuffer);
+            for (std::size_t i = 0; i < sum.size(); ++i) {
+                const float depth = std::isinf(gbuffer.t[i]) ? 0.0f : gbuffer.t[i];
+                sum[i] = plan.sample == 0 ? depth : sum[i] + depth;
+                image[i] = sum[i] / (plan.sample + 1);
+            }
+        }
+        return image;
+    };
+
+    Reprojection::Cache cache;
+    Shading::GBuffer gbuffer, preview, unused;
+    trace(tree, view(before, 64), gbuffer);
+    cache.store(view(before, 64), gbuffer);
+    const auto moved = refine(&cache, preview);
+    const auto fresh = refine(nullptr, unused);
+
+    // The preview sees ground through some of the board, the refined image does not
+    Shading::GBuffer reference;
+    trace(tree, view(after, 64), reference);
+    std::size_t missed = 0;
+    for (std::size_t i = 0; i < reference.size(); ++i)
+        missed += preview.t[i] > 1.01f * reference.t[i];
+    EXPECT_GT(missed, 0);
+    EXPECT_EQ(moved, fresh);
+}
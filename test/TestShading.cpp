@@ -0,0 +1,204 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include <gtest/gtest.h>
+
+#include "Shading.hpp"
+
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// Two entries: a hit on a surface facing the camera at t = 2 and a miss
+Shading::GBuffer facingHitAndMiss()
+{
+    Shading::GBuffer gbuffer;
+    gbuffer.resize(2);
+    gbuffer.t = {2.0f, std::numeric_limits<float>::infinity()};
+    gbuffer.normal_x = {0.0f, 0.0f};
+    gbuffer.normal_y = {-1.0f, 0.0f};
+    gbuffer.normal_z = {0.0f, 0.0f};
+    gbuffer.primitive = {7, 0};
+    return gbuffer;
+}
+
+}
+
+TEST(TestShading, Methods)
+{
+    const auto gbuffer = facingHitAndMiss();
+    const float direction[3] = {0.0f, 1.0f, 0.0f};
+    const float step[3] = {0.0f, 0.0f, 0.0f};
+    Shading::Lighting lighting;
+    float r[2], g[2], b[2];
+
+    Shading::shade(Shading::Method::Depth, gbuffer, 0, 2, lighting, direction, step, r, g, b);
+    const float tn = std::atan(2.0f) / (M_PI / 2);
+    EXPECT_NEAR(r[0], tn * tn * 255, 1e-3);
+    EXPECT_EQ(g[0], r[0]);
+    EXPECT_EQ(r[1], 0.0f);
+
+    Shading::shade(Shading::Method::Normal, gbuffer, 0, 2, lighting, direction, step, r, g, b);
+    EXPECT_FLOAT_EQ(r[0], 128.0f);
+    EXPECT_FLOAT_EQ(g[0], 0.0f);
+    EXPECT_FLOAT_EQ(b[0], 128.0f);
+    EXPECT_EQ(b[1], 0.0f);
+
+    // Light straight behind the camera: full diffuse and specular
+    lighting.light[1] = -100.0f;
+    lighting.light[0] = lighting.light[2] = 0.0f;
+    Shading::shade(Shading::Method::Phong, gbuffer, 0, 2, lighting, direction, step, r, g, b);
+    EXPECT_FLOAT_EQ(r[0], 255.0f);
+    EXPECT_NEAR(b[0], 0.8f * 127 + 0.5f * 255, 1e-3);
+    EXPECT_EQ(r[1], 0.0f);
+
+    Shading::shade(Shading::Method::Primitive, gbuffer, 0, 2, lighting, direction, step, r, g, b);
+    EXPECT_GT(r[0] + g[0] + b[0], 0.0f);
+    EXPECT_EQ(r[1] + g[1] + b[1], 0.0f);
+}
+
+TEST(TestShading, Span)
+{
+    // A span is shaded as its entries one at a time
+    Shading::GBuffer gbuffer;
+    gbuffer.resize(17);
+    for (std::size_t i = 0; i < gbuffer.size(); ++i) {
+        gbuffer.t[i] = i % 3 == 0 ? std::numeric_limits<float>::infinity() : 1.0f + i;
+        gbuffer.normal_x[i] = std::sin(float(i));
+        gbuffer.normal_y[i] = -std::cos(float(i));
+        gbuffer.normal_z[i] = 0.0f;
+        gbuffer.primitive[i] = i;
+    }
+    const float direction[3] = {-0.5f, 1.0f, 0.1f};
+    const float step[3] = {0.0625f, 0.0f, 0.0f};
+    const Shading::Lighting lighting;
+
+    for (int index = 0; index < 4; ++index) {
+        const auto method = Shading::fromIndex(index);
+        float r[17], g[17], b[17];
+        Shading::shade(method, gbuffer, 0, 17, lighting, direction, step, r, g, b);
+        for (std::size_t i = 0; i < 17; ++i) {
+            const float single_direction[3] = {direction[0] + i * step[0], direction[1], direction[2]};
+            float r1, g1, b1;
+            Shading::shade(method, gbuffer, i, 1, lighting, single_direction, step, &r1, &g1, &b1);
+            EXPECT_NEAR(r[i], r1, 1e-3);
+            EXPECT_NEAR(g[i], g1, 1e-3);
+            EXPECT_NEAR(b[i], b1, 1e-3);
+        }
+    }
+    EXPECT_EQ(Shading::fromIndex(9), Shading::Method::Phong);
+}
+
+TEST(TestShading, CosineDirections)
+{
+    const float normals[3][3] = {{0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, -1.0f}, {0.6f, 0.0f, 0.8f}};
+    for (const auto& normal : normals) {
+        float x[16], y[16], z[16];
+        Shading::cosineDirections(normal, 4, 12345, x, y, z);
+        float mean_cos = 0.0f;
+        for (int k = 0; k < 16; ++k) {
+            EXPECT_NEAR(x[k] * x[k] + y[k] * y[k] + z[k] * z[k], 1.0f, 1e-5);
+            const float cos = x[k] * normal[0] + y[k] * normal[1] + z[k] * normal[2];
+            EXPECT_GE(cos, 0.0f);
+            mean_cos += cos / 16;
+        }
+        // Cosine weighted directions average 2/3 for cos theta
+        EXPECT_NEAR(mean_cos, 2.0f / 3.0f, 0.1f);
+    }
+}
+
+TEST(TestShading, Visibility)
+{
+    auto gbuffer = facingHitAndMiss();
+    gbuffer.visibility = {0.25f, 1.0f};
+    const float direction[3] = {0.0f, 1.0f, 0.0f};
+    const float step[3] = {0.0f, 0.0f, 0.0f};
+    Shading::Lighting lighting;
+    lighting.light[0] = lighting.light[2] = 0.0f;
+    float r[2], g[2], b[2];
+
+    EXPECT_TRUE(Shading::needsVisibility(Shading::fromIndex(4)));
+    EXPECT_FALSE(Shading::needsVisibility(Shading::Method::Phong));
+
+    Shading::shade(Shading::Method::AmbientOcclusion, gbuffer, 0, 2, lighting, direction, step, r, g, b);
+    EXPECT_FLOAT_EQ(r[0], 0.25f * 255);
+    EXPECT_EQ(r[1], 0.0f);
+
+    // Only the ambient term is left in full shadow
+    gbuffer.visibility[0] = 0.0f;
+    Shading::shade(Shading::Method::Shadow, gbuffer, 0, 2, lighting, direction, step, r, g, b);
+    EXPECT_FLOAT_EQ(r[0], 0.25f * 255);
+    EXPECT_FLOAT_EQ(g[0], 0.0f);
+}
+
+TEST(TestShading, Cost)
+{
+    // Misses are shaded too, they cost as much as hits
+    auto gbuffer = facingHitAndMiss();
+    gbuffer.cost = {0.0f, 1000.0f};
+    const float direction[3] = {0.0f, 1.0f, 0.0f};
+    const float step[3] = {0.0f, 0.0f, 0.0f};
+    Shading::Lighting lighting;
+    lighting.max_cost = 100.0f;
+    float r[2], g[2], b[2];
+
+    EXPECT_EQ(Shading::fromIndex(6), Shading::Method::Cost);
+    Shading::shade(Shading::Method::Cost, gbuffer, 0, 2, lighting, direction, step, r, g, b);
+    EXPECT_EQ(r[0], 0.0f);
+    EXPECT_GT(b[0], 0.0f);
+    EXPECT_FLOAT_EQ(r[1], 127.5f);
+    EXPECT_EQ(g[1], 0.0f);
+    EXPECT_EQ(b[1], 0.0f);
+
+    gbuffer.cost[0] = 50.0f;
+    Shading::shade(Shading::Method::Cost, gbuffer, 0, 1, lighting, direction, step, r, g, b);
+    EXPECT_FLOAT_EQ(g[0], 255.0f);
+}
+
+TEST(TestShading, Edges)
+{
+    // 4 x 3 plane of one triangle at t = 2 with a nearer triangle in the right
+    // column and a miss in the bottom left corner
+    const int width = 4, height = 3;
+    Shading::GBuffer gbuffer;
+    gbuffer.resize(width * height);
+    for (int i = 0; i < width * height; ++i) {
+        gbuffer.t[i] = 2.0f;
+        gbuffer.normal_x[i] = 0.0f;
+        gbuffer.normal_y[i] = -1.0f;
+        gbuffer.normal_z[i] = 0.0f;
+        gbuffer.primitive[i] = 1;
+    }
+    for (int y = 0; y < height; ++y) {
+        gbuffer.t[3 + y * width] = 1.0f;
+        gbuffer.primitive[3 + y * width] = 2;
+    }
+    gbuffer.t[2 * width] = std::numeric_limits<float>::infinity();
+
+    const std::uint8_t expected[height][width] = {{0, 0, 1, 1}, {1, 0, 1, 1}, {1, 1, 1, 1}};
+    std::uint8_t edges[width];
+    for (int y = 0; y < height; ++y) {
+        const std::size_t count = Shading::findEdges(gbuffer, width, height, y, {}, edges);
+        std::size_t expected_count = 0;
+        for (int x = 0; x < width; ++x) {
+            EXPECT_EQ(edges[x], expected[y][x]) << x << ", " << y;
+            expected_count += expected[y][x];
+        }
+        EXPECT_EQ(count, expected_count);
+    }
+
+    // A small change of depth or normal on the same triangle is not an edge
+    gbuffer.t[1] = 2.05f;
+    gbuffer.normal_x[1] = 0.1f;
+    Shading::findEdges(gbuffer, width, height, 0, {}, edges);
+    EXPECT_EQ(edges[0], 0);
+    Shading::EdgeThresholds strict;
+    strict.depth = 0.01f;
+    Shading::findEdges(gbuffer, width, height, 0, strict, edges);
+    EXPECT_EQ(edges[0], 1);
+}
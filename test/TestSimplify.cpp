@@ -0,0 +1,92 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include <gtest/gtest.h>
+
+#include "bvh.hpp"
+
+#include "IndexMesh.hpp"
+#include "Meshes.hpp"
+#include "Simplify.hpp"
+
+#include <cmath>
+#include <filesystem>
+#include <stdexcept>
+
+TEST(TestSimplify, Sphere)
+{
+    const BVH::IndexedMesh mesh = Meshes::indexedSphere(64);
+    const BVH::IndexedMesh coarse = Simplify::simplify(mesh, 0.2f);
+    EXPECT_LT(coarse.triangles.size(), mesh.triangles.size() / 10);
+    EXPECT_GT(coarse.triangles.size(), 100);
+
+    // The vertices stay close to the surface
+    for (const auto& v : coarse.vertices) {
+        const float r = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        EXPECT_NEAR(r, 1.0f, 0.05f);
+    }
+}
+
+TEST(TestSimplify, Levels)
+{
+    const BVH::IndexedMesh mesh = Meshes::indexedSphere(64);
+    const auto levels = Simplify::buildLevels(mesh, 4, 64);
+    ASSERT_GE(levels.size(), 2);
+    EXPECT_LE(levels.size(), 4);
+    std::size_t previous = mesh.triangles.size();
+    float error = 0.0f;
+    for (const auto& level : levels) {
+        EXPECT_LT(level.mesh.triangles.size(), previous);
+        EXPECT_GE(level.mesh.triangles.size(), 64);
+        EXPECT_GT(level.error, error);
+        previous = level.mesh.triangles.size();
+        error = level.error;
+    }
+
+    // Farther away selects coarser levels
+    EXPECT_EQ(Simplify::select(levels, 0.0f, 1000.0f), 0);
+    EXPECT_EQ(Simplify::select(levels, levels[0].error * 1000.0f, 1000.0f), 1);
+    EXPECT_EQ(Simplify::select(levels, 1e9f, 1000.0f), levels.size());
+
+    const float lower[3] = {-1, -1, -1}, upper[3] = {1, 1, 1};
+    const float inside[3] = {0.5f, 0, 0}, outside[3] = {4, 5, 1};
+    EXPECT_EQ(Simplify::boxDistance(inside, lower, upper), 0.0f);
+    EXPECT_FLOAT_EQ(Simplify::boxDistance(outside, lower, upper), 5.0f);
+}
+
+TEST(TestSimplify, EncodeDecode)
+{
+    const BVH::IndexedMesh mesh = Meshes::indexedSphere(32);
+    const auto levels = Simplify::buildLevels(mesh, 3, 32);
+    const std::uint64_t key = Simplify::fingerprint(mesh, 3, 32);
+    EXPECT_NE(key, Simplify::fingerprint(mesh, 4, 32));
+
+    const std::string data = Simplify::encode(levels, key);
+    const auto decoded = Simplify::decode(data, key);
+    ASSERT_EQ(decoded.size(), levels.size());
+    for (std::size_t i = 0; i < levels.size(); ++i) {
+        EXPECT_EQ(decoded[i].error, levels[i].error);
+        EXPECT_EQ(decoded[i].mesh.triangles, levels[i].mesh.triangles);
+        ASSERT_EQ(decoded[i].mesh.vertices.size(), levels[i].mesh.vertices.size());
+        for (std::size_t v = 0; v < levels[i].mesh.vertices.size(); ++v)
+            for (int a = 0; a < 3; ++a)
+                EXPECT_NEAR(decoded[i].mesh.vertices[v][a], levels[i].mesh.vertices[v][a], 1e-5f);
+    }
+
+    EXPECT_THROW(Simplify::decode(data, key + 1), std::runtime_error);
+    EXPECT_THROW(Simplify::decode(data.substr(0, data.size() / 2), key), std::runtime_error);
+}
+
+TEST(TestSimplify, UnwritableCache)
+{
+    // A directory cannot be opened as the cache file
+    const BVH::IndexedMesh mesh = Meshes::indexedSphere(16);
+    const auto path = std::filesystem::temp_directory_path();
+    const auto levels = Simplify::cachedLevels(path.string(), mesh, 3, 32);
+    EXPECT_EQ(levels.size(), Simplify::buildLevels(mesh, 3, 32).size());
+    EXPECT_TRUE(std::filesystem::is_directory(path));
+}
@@ -0,0 +1,61 @@
+/*
+ *  Copyright (C) 2024 SINTEF Digital
+ *
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include <gtest/gtest.h>
+
+#include "Tiles.hpp"
+
+#include <cstdlib>
+#include <set>
+#include <stdexcept>
+
+TEST(TestTiles, CoverImageOnce)
+{
+    for (auto order : {Tiles::Order::Scanline, Tiles::Order::Morton, Tiles::Order::Hilbert}) {
+        const int width = 100, height = 37;
+        const auto tiles = Tiles::split(width, height, 16, order);
+        EXPECT_EQ(tiles.size(), 7 * 3);
+
+        std::vector<int> covered(width * height, 0);
+        for (const auto& tile : tiles)
+            for (int y = tile.y0; y < tile.y1; ++y)
+                for (int x = tile.x0; x < tile.x1; ++x)
+                    ++covered[x + y * width];
+        for (int c : covered)
+            ASSERT_EQ(c, 1);
+    }
+}
+
+TEST(TestTiles, HilbertNeighbours)
+{
+    // Consecutive tiles on a square power of two grid share an edge
+    const auto tiles = Tiles::split(64, 64, 8, Tiles::Order::Hilbert);
+    ASSERT_EQ(tiles.size(), 64);
+    for (std::size_t i = 1; i < tiles.size(); ++i)
+        EXPECT_EQ(std::abs(tiles[i].x0 - tiles[i-1].x0) + std::abs(tiles[i].y0 - tiles[i-1].y0), 8);
+
+    std::set<std::uint64_t> indices;
+    for (std::uint32_t y = 0; y < 4; ++y)
+        for (std::uint32_t x = 0; x < 4; ++x)
+            indices.insert(Tiles::hilbertIndex(x, y, 2));
+    EXPECT_EQ(indices.size(), 16);
+    EXPECT_EQ(*indices.rbegin(), 15);
+}
+
+TEST(TestTiles, Order)
+{
+    EXPECT_EQ(Tiles::mortonIndex(3, 5), 0b100111);
+    const auto scan = Tiles::split(32, 32, 16, Tiles::Order::Scanline);
+    EXPECT_EQ(scan[1].x0, 16);
+    EXPECT_EQ(scan[1].y0, 0);
+    const auto morton = Tiles::split(32, 32, 16, Tiles::Order::Morton);
+    EXPECT_EQ(morton[2].x0, 0);
+    EXPECT_EQ(morton[2].y0, 16);
+
+    EXPECT_EQ(Tiles::parseOrder("hilbert"), Tiles::Order::Hilbert);
+    EXPECT_THROW(Tiles::parseOrder("spiral"), std::runtime_error);
+}